@@ -1,3 +1,4 @@
+if (WIN32)
 set(GLEW_LIBRARY_DIR "$ENV{GLEW_DIR}/lib/Release/x64")
 set(GLEW_BINARY_DIR  "$ENV{GLEW_DIR}/bin/Release/x64")
 set(GLEW_DLLS        "${GLEW_BINARY_DIR}/glew32.dll")
@@ -5,6 +6,14 @@ set(GLEW_DLLS        "${GLEW_BINARY_DIR}/glew32.dll")
 # exported
 set(GLEW_INCLUDE_DIRS "$ENV{GLEW_DIR}/include")
 set(GLEW_LIBRARIES    "${GLEW_LIBRARY_DIR}/glew32.lib")
+else()
+# GLEW_DIR, or the system one. Headless needs a GLEW built for EGL (GLEW_EGL).
+find_path(GLEW_INCLUDE_DIRS GL/glew.h HINTS "$ENV{GLEW_DIR}/include")
+find_library(GLEW_LIBRARIES GLEW HINTS "$ENV{GLEW_DIR}/lib")
+get_filename_component(GLEW_LIBRARY_DIR "${GLEW_LIBRARIES}" DIRECTORY)
+set(GLEW_BINARY_DIR  "${GLEW_LIBRARY_DIR}")
+set(GLEW_DLLS        "${GLEW_LIBRARIES}")
+endif()
 
 MESSAGE(STATUS ${GLEW_INCLUDE_DIRS})
 MESSAGE(STATUS ${GLEW_LIBRARY_DIR})
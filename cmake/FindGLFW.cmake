@@ -1,3 +1,4 @@
+if (WIN32)
 set(GLFW_LIBRARY_DIR "$ENV{GLFW_DIR}/lib")
 set(GLFW_BINARY_DIR  "$ENV{GLFW_DIR}/lib")
 set(GLFW_DLLS        "${GLFW_BINARY_DIR}/glfw3.dll")
@@ -5,6 +6,14 @@ set(GLFW_DLLS        "${GLFW_BINARY_DIR}/glfw3.dll")
 # exported
 set(GLFW_INCLUDE_DIRS "$ENV{GLFW_DIR}/include")
 set(GLFW_LIBRARIES    "${GLFW_LIBRARY_DIR}/glfw3dll.lib")
+else()
+# GLFW_DIR, or the system one.
+find_path(GLFW_INCLUDE_DIRS GLFW/glfw3.h HINTS "$ENV{GLFW_DIR}/include")
+find_library(GLFW_LIBRARIES NAMES glfw glfw3 HINTS "$ENV{GLFW_DIR}/lib")
+get_filename_component(GLFW_LIBRARY_DIR "${GLFW_LIBRARIES}" DIRECTORY)
+set(GLFW_BINARY_DIR  "${GLFW_LIBRARY_DIR}")
+set(GLFW_DLLS        "${GLFW_LIBRARIES}")
+endif()
 
 MESSAGE(STATUS ${GLFW_INCLUDE_DIRS})
 MESSAGE(STATUS ${GLFW_LIBRARY_DIR})
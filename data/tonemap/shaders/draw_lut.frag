@@ -2,6 +2,8 @@
 
 layout(binding = 1) uniform sampler3D lut_sampler;
 
+uniform int lut_size;
+
 in VS_OUT
 {
     vec3 tc;
@@ -11,11 +13,11 @@ layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    //int x = mod(int(fs_in.tc.z * 32.0), 32);
-    int scaled_z = int(fs_in.tc.z * 32.0);
-    int x = scaled_z - 32 * (scaled_z/32);
-    int y = int(fs_in.tc.y);
-    int z = int(fs_in.tc.z);
+    //int x = mod(int(fs_in.tc.z * lut_size), lut_size);
+    int scaled_z = int(fs_in.tc.z * float(lut_size));
+    int x = scaled_z - lut_size * (scaled_z/lut_size);
+    int y = min(int(fs_in.tc.y), lut_size - 1);
+    int z = min(int(fs_in.tc.z), lut_size - 1);
     ivec3 base_tc = ivec3(x,y,z);
     outColor = texelFetch(lut_sampler, base_tc, 0);
 }
@@ -2,6 +2,7 @@
 
 uniform int width;
 uniform int height;
+uniform int lut_size;
 
 out VS_OUT
 {
@@ -20,19 +21,24 @@ const vec2 pos_data[6] = vec2[]
 
 const vec3 tex_data[6] = vec3[] 
 (
-    vec3(0.0, 32.0,  0.0),
-    vec3(0.0, 32.0, 32.0),
-    vec3(0.0,  0.0,  0.0),
-    vec3(0.0,  0.0,  0.0),
-    vec3(0.0, 32.0, 32.0),
-    vec3(0.0,  0.0, 32.0)
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 1.0, 1.0),
+    vec3(0.0, 0.0, 0.0),
+    vec3(0.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 1.0),
+    vec3(0.0, 0.0, 1.0)
 );
 
 void main() 
 {
+    // all the slices side by side, 1 texel per pixel, shrunk if wider than the screen.
+    float n = float(lut_size);
+    float strip_width = min(n * n, float(width));
+    float strip_height = strip_width / n;
+
     vec2 pixel_size = vec2(2.0/float(width), 2.0/(float(height)));
-    vec2 scale = vec2(1024.0*pixel_size.x, -32.0*pixel_size.y);
-    vec2 offset = vec2(-1.0, -1.0+32.0*pixel_size.y);
+    vec2 scale = vec2(strip_width*pixel_size.x, -strip_height*pixel_size.y);
+    vec2 offset = vec2(-1.0, -1.0+strip_height*pixel_size.y);
     gl_Position = vec4( offset + scale * pos_data[ gl_VertexID ], 0.0, 1.0 );
-    vs_out.tc = tex_data[ gl_VertexID ];
+    vs_out.tc = n * tex_data[ gl_VertexID ];
 }
@@ -1,5 +1,7 @@
 #version 460 core
 
+// Compiled once per view by AppTest, which defines VIEW, one of these, before this.
+
 #define HORIZONTAL_SPLIT_4 0
 #define SPLIT_2_ACES       1
 #define LINEAR_ONLY        2
@@ -7,11 +9,21 @@
 #define ACES_ONLY          4
 #define FILMIC_UC2_ONLY    5
 
-uniform int view;
+layout(location = 0) uniform int lut_size;
+layout(location = 1) uniform int auto_exposure;
 
 layout(binding = 0) uniform sampler2D s;
 layout(binding = 1) uniform sampler3D lut_sampler;
 
+// written by average_luminance.comp
+layout(std430, binding = 1) readonly buffer exposure_buffer
+{
+    float adapted_luminance;
+    float exposure;
+    float average_luminance;
+    float padding;
+};
+
 in VS_OUT
 {
     vec2 tc;
@@ -107,84 +119,72 @@ vec3 lut(vec3 linear_hdr)
     float white_point = 4.0;
     // scale down and clamp input colors to fit the LUT texcoords.
     vec3 lut_tc = min((1.0/white_point)*linear_hdr, vec3(1));
-    
+
+    // [0..1] -> texel centers, the first and last texels hold 0 and white_point.
+    float n = float(lut_size);
+    lut_tc = (lut_tc * (n - 1.0) + 0.5) / n;
+
     return texture(lut_sampler, lut_tc).rgb;
 }
 
 
+vec3 exposed_hdr(vec2 tc)
+{
+    vec3 c = texture(s, tc).rgb;
+    return (auto_exposure != 0) ? exposure * c : c;
+}
+
 void main()
 {
-    vec3 linear_hdr = texture(s, fs_in.tc).rgb;
-    switch(view)
+    vec3 linear_hdr = exposed_hdr(fs_in.tc);
+
+#if VIEW == HORIZONTAL_SPLIT_4
+    if(fs_in.tc.x < 0.25)
     {
-        case HORIZONTAL_SPLIT_4: 
-        {
-            if(fs_in.tc.x < 0.25)
-            {
-                // CLAMP
-                vec3 c = clamp(linear_hdr, vec3(0), vec3(1));
-                outColor = vec4(c, 1);
-            }
-            else if(fs_in.tc.x < 0.5)
-            {
-                // Filmic LUT
-                outColor = vec4(lut(linear_hdr), 1);
-            }
-            else if(fs_in.tc.x < 0.75)
-            {
-                // ACES + GAMMA
-                vec3 c = ACESFitted(linear_hdr);
-                outColor = vec4(Linear_To_sRGB(c), 1);
-            }
-            else
-            {
-                // FILMIC + GAMMA
-                outColor = vec4(Filmic_1(linear_hdr), 1);
-            }
-        } break;
-
-        case SPLIT_2_ACES: 
-        {
-            if(fs_in.tc.x < 0.5)
-            {
-                // ACES correct
-                vec2 tc = vec2(1.0-fs_in.tc.x, fs_in.tc.y); // mirror
-                linear_hdr = texture(s, tc).rgb;
-                vec3 c = ACESFitted(linear_hdr);
-                outColor = vec4(Linear_To_sRGB(c), 1);
-            }
-            else
-            {
-                // ACES dans le mauvais sens.
-                vec3 c = ACESFitted(Linear_To_sRGB(linear_hdr));
-                outColor = vec4(c, 1);
-            }
-        } break;
-
-        case LINEAR_ONLY: 
-        {
-            vec3 c = clamp(linear_hdr, vec3(0), vec3(1));
-            outColor = vec4(c, 1);
-        } break;
-
-        case FILMIC_LUT_ONLY: 
-        {
-            outColor = vec4(lut(linear_hdr), 1);
-        } break;
-
-        case ACES_ONLY: 
-        {
-            vec3 c = ACESFitted(linear_hdr);
-            outColor = vec4(Linear_To_sRGB(c), 1);
-        } break;
-
-        case FILMIC_UC2_ONLY: 
-        {
-            outColor = vec4(Filmic_1(linear_hdr), 1);
-        } break;
+        // CLAMP
+        vec3 c = clamp(linear_hdr, vec3(0), vec3(1));
+        outColor = vec4(c, 1);
     }
-
-
-
-    
+    else if(fs_in.tc.x < 0.5)
+    {
+        // Filmic LUT
+        outColor = vec4(lut(linear_hdr), 1);
+    }
+    else if(fs_in.tc.x < 0.75)
+    {
+        // ACES + GAMMA
+        vec3 c = ACESFitted(linear_hdr);
+        outColor = vec4(Linear_To_sRGB(c), 1);
+    }
+    else
+    {
+        // FILMIC + GAMMA
+        outColor = vec4(Filmic_1(linear_hdr), 1);
+    }
+#elif VIEW == SPLIT_2_ACES
+    if(fs_in.tc.x < 0.5)
+    {
+        // ACES correct
+        vec2 tc = vec2(1.0-fs_in.tc.x, fs_in.tc.y); // mirror
+        linear_hdr = exposed_hdr(tc);
+        vec3 c = ACESFitted(linear_hdr);
+        outColor = vec4(Linear_To_sRGB(c), 1);
+    }
+    else
+    {
+        // ACES dans le mauvais sens.
+        vec3 c = ACESFitted(Linear_To_sRGB(linear_hdr));
+        outColor = vec4(c, 1);
+    }
+#elif VIEW == LINEAR_ONLY
+    vec3 c = clamp(linear_hdr, vec3(0), vec3(1));
+    outColor = vec4(c, 1);
+#elif VIEW == FILMIC_LUT_ONLY
+    outColor = vec4(lut(linear_hdr), 1);
+#elif VIEW == ACES_ONLY
+    vec3 c = ACESFitted(linear_hdr);
+    outColor = vec4(Linear_To_sRGB(c), 1);
+#elif VIEW == FILMIC_UC2_ONLY
+    outColor = vec4(Filmic_1(linear_hdr), 1);
+#endif
 }
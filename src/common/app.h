@@ -11,6 +11,17 @@ public:
     virtual void shutdown() = 0;
     virtual void run(float dt) = 0;
 
+    // lets an app end the main loop by itself, e.g. after a validation run.
+    virtual bool should_exit() const { return false; }
+    virtual int exit_code() const { return 0; }
+
+    // offscreen runs (--headless): nothing may be drawn in the default framebuffer, there is
+    // none. The frame is read back from output_texture() once the app is ready (e.g. its
+    // assets are loaded).
+    void set_headless(bool headless) { _headless = headless; }
+    virtual bool ready() const { return true; }
+    virtual unsigned int output_texture() const { return 0; }
+
     // callbacks
     virtual void onWindowSize(GLFWwindow* window, int w, int h) = 0;
     virtual void onFramebufferSize(GLFWwindow* window, int w, int h) = 0;
@@ -18,6 +29,10 @@ public:
     virtual void onMouseClick(GLFWwindow* window, int button, int action, int mods) = 0;
     virtual void onMouseMove(GLFWwindow* window, double mouse_x, double mouse_y) = 0;
     virtual void onMouseScroll(GLFWwindow* window, double xoffset, double yoffset) = 0;
+
+protected:
+
+    bool _headless = false;
 };
 
 #endif // _APP_2018_12_03_H_
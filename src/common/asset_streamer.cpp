@@ -0,0 +1,184 @@
+#include "asset_streamer.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace glutils
+{
+
+//
+// Batch
+//
+
+void AssetStreamer::Batch::step(step_func f)
+{
+    _steps.push_back(std::move(f));
+}
+
+void AssetStreamer::Batch::upload(GLuint dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, UploadRing::fill_func fill)
+{
+    upload([dst_buffer]() { return dst_buffer; }, dst_offset, nb_elements, element_size, std::move(fill));
+}
+
+void AssetStreamer::Batch::upload(buffer_func dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, UploadRing::fill_func fill)
+{
+    UploadRing *ring = _ring;
+    size_t next = 0;
+    step([=](size_t &budget) mutable
+    {
+        if (next == nb_elements)
+            return true;
+
+        // at least one element per frame, whatever the budget.
+        const size_t count = std::min(nb_elements - next, std::max<size_t>(budget / element_size, 1));
+        const size_t first = next;
+        ring->upload(dst_buffer(), dst_offset + first * element_size, count, element_size, [&fill, first](void *ptr, size_t f, size_t c)
+        {
+            fill(ptr, first + f, c);
+        });
+
+        next += count;
+        budget -= std::min(budget, count * element_size);
+        return next == nb_elements;
+    });
+}
+
+void AssetStreamer::Batch::upload_texture_level(GLuint texture, int level, int width, int height, GLenum format, GLenum type, size_t pixel_size, const void *pixels)
+{
+    const size_t row_size = (size_t)width * pixel_size;
+    int next_row = 0;
+    step([=](size_t &budget) mutable
+    {
+        if (next_row == height)
+            return true;
+
+        const int count = (int)std::min<size_t>(height - next_row, std::max<size_t>(budget / row_size, 1));
+
+        // rows of half floats, e.g., are not always 4 bytes aligned.
+        const bool unaligned = (row_size % 4) != 0;
+        if (unaligned)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage2D(texture, level, 0, next_row, width, count, format, type, (const char*)pixels + next_row * row_size);
+        if (unaligned)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        next_row += count;
+        budget -= std::min(budget, count * row_size);
+        return next_row == height;
+    });
+}
+
+void AssetStreamer::Batch::upload_texture(GLuint texture, int width, int height, GLenum format, GLenum type, size_t pixel_size, const void *pixels)
+{
+    upload_texture_level(texture, 0, width, height, format, type, pixel_size, pixels);
+    then([texture]()
+    {
+        glGenerateTextureMipmap(texture);
+    });
+}
+
+void AssetStreamer::Batch::then(std::function<void()> f)
+{
+    step([f](size_t &)
+    {
+        f();
+        return true;
+    });
+}
+
+//
+// AssetStreamer
+//
+
+AssetStreamer::~AssetStreamer()
+{
+    shutdown();
+}
+
+void AssetStreamer::init(UploadRing *ring, size_t frame_budget, utils::ThreadPool &pool)
+{
+    shutdown();
+
+    _ring = ring;
+    _pool = &pool;
+    _frame_budget = frame_budget;
+}
+
+void AssetStreamer::shutdown()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv_done.wait(lock, [this] { return _nb_jobs == 0; });
+        _loaded.clear();
+    }
+
+    _batches.clear();
+    _nb_loading = 0;
+    _bytes_last_frame = 0;
+}
+
+void AssetStreamer::load(const std::string &name, cpu_func cpu)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_nb_jobs;
+    }
+    ++_nb_loading;
+
+    _pool->submit([this, name, cpu]()
+    {
+        gpu_func gpu = cpu();
+        if (!gpu)
+        {
+            printf("FAILED to load \"%s\"\n", name.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _loaded.push_back({ name, std::move(gpu) });
+        --_nb_jobs;
+        _cv_done.notify_all();
+    });
+}
+
+void AssetStreamer::update()
+{
+    std::deque<loaded> loaded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loaded.swap(_loaded);
+    }
+
+    for (auto &l : loaded)
+    {
+        --_nb_loading;
+        if (!l.gpu)
+            continue;
+
+        Batch batch;
+        batch._ring = _ring;
+        l.gpu(batch);
+        if (!batch._steps.empty())
+        {
+            _batches.push_back(std::move(batch));
+        }
+    }
+
+    // oldest batches first, so the assets complete in order.
+    size_t budget = _frame_budget;
+    while (!_batches.empty() && budget > 0)
+    {
+        auto &steps = _batches.front()._steps;
+        while (!steps.empty() && budget > 0 && steps.front()(budget))
+        {
+            steps.pop_front();
+        }
+
+        if (!steps.empty())
+            break;
+
+        _batches.pop_front();
+    }
+    _bytes_last_frame = _frame_budget - budget;
+}
+
+} // namespace glutils
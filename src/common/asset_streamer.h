@@ -0,0 +1,118 @@
+#ifndef _ASSET_STREAMER_2026_10_17_H_
+#define _ASSET_STREAMER_2026_10_17_H_
+
+#include <GL/glew.h>
+#include "upload_ring.h"
+#include "thread_pool.h"
+
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stddef.h>
+
+namespace glutils
+{
+    //
+    // Background asset loading. The cpu side of an asset (file i/o, parsing, decoding)
+    // runs on the thread pool and returns its gpu side, which runs on the GL thread in
+    // update(). The gpu side only queues work in a Batch: uploads and steps that are spread
+    // over the next frames, at most frame_budget bytes per frame, so a large scene comes in
+    // progressively instead of stalling the first frame.
+    //
+    class AssetStreamer
+    {
+    public:
+
+        class Batch
+        {
+        public:
+
+            // Called once per frame until it returns true. `budget` is what is left for this
+            // frame: take what was uploaded from it, and return false when it is exhausted.
+            using step_func = std::function<bool(size_t &budget)>;
+            void step(step_func f);
+
+            // UploadRing::upload, cut in ranges of elements that fit in the frame budgets.
+            void upload(GLuint dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, UploadRing::fill_func fill);
+
+            // Same, for a buffer that can be reallocated meanwhile (a growing arena): its name
+            // is asked again at each step.
+            using buffer_func = std::function<GLuint()>;
+            void upload(buffer_func dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, UploadRing::fill_func fill);
+
+            // One level of a 2D texture, by bands of rows. `pixels` (tightly packed rows) must
+            // stay alive until a later then().
+            void upload_texture_level(GLuint texture, int level, int width, int height, GLenum format, GLenum type, size_t pixel_size, const void *pixels);
+
+            // Level 0, then the mip chain generated from it.
+            void upload_texture(GLuint texture, int width, int height, GLenum format, GLenum type, size_t pixel_size, const void *pixels);
+
+            // Once everything queued before is done.
+            void then(std::function<void()> f);
+
+        private:
+
+            friend class AssetStreamer;
+
+            UploadRing *_ring = nullptr;
+            std::deque<step_func> _steps;
+        };
+
+        using gpu_func = std::function<void(Batch &batch)>;
+        using cpu_func = std::function<gpu_func()>; // empty gpu_func: failed, nothing to do.
+
+        AssetStreamer() = default;
+        ~AssetStreamer();
+
+        AssetStreamer(const AssetStreamer &) = delete;
+        AssetStreamer &operator=(const AssetStreamer &) = delete;
+
+        void init(UploadRing *ring, size_t frame_budget = 16 * 1024 * 1024, utils::ThreadPool &pool = utils::thread_pool());
+
+        // Waits for the cpu jobs in flight, drops everything that is not on the gpu yet.
+        void shutdown();
+
+        // `name` is only for the log.
+        void load(const std::string &name, cpu_func cpu);
+
+        // GL thread, once per frame.
+        void update();
+
+        bool idle() const { return _nb_loading == 0 && _batches.empty(); }
+
+        size_t frame_budget() const { return _frame_budget; }
+        void set_frame_budget(size_t bytes) { _frame_budget = bytes; }
+
+        // stats
+        size_t nb_loading() const { return _nb_loading; }
+        size_t nb_uploading() const { return _batches.size(); }
+        size_t bytes_last_frame() const { return _bytes_last_frame; }
+
+    private:
+
+        struct loaded
+        {
+            std::string name;
+            gpu_func gpu;
+        };
+
+        UploadRing *_ring = nullptr;
+        utils::ThreadPool *_pool = nullptr;
+        size_t _frame_budget = 0;
+
+        // shared with the workers.
+        std::mutex _mutex;
+        std::condition_variable _cv_done;
+        std::deque<loaded> _loaded;
+        size_t _nb_jobs = 0; // cpu jobs not finished.
+
+        // GL thread only.
+        size_t _nb_loading = 0; // load() calls whose gpu side did not run yet.
+        std::deque<Batch> _batches;
+        size_t _bytes_last_frame = 0;
+    };
+}
+
+#endif // _ASSET_STREAMER_2026_10_17_H_
@@ -0,0 +1,127 @@
+#include "file_watcher.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace utils
+{
+
+FileWatcher::~FileWatcher()
+{
+    clear();
+}
+
+bool FileWatcher::add(const std::string &path)
+{
+    for (const auto &f : _files)
+    {
+        if (f.path == path)
+            return true;
+    }
+
+    file f;
+    f.path = path;
+    const size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    f.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    file_info(path, &f.size, &f.mtime);
+
+#ifdef __linux__
+    if (_fd < 0)
+    {
+        _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0)
+        {
+            printf("FAILED to start inotify (%d), %s is not watched\n", errno, path.c_str());
+            return false;
+        }
+    }
+
+    // the same watch for every file of a directory. Written in place, or renamed over.
+    f.watch = inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (f.watch < 0)
+    {
+        printf("FAILED to watch \"%s\" (%d)\n", directory.c_str(), errno);
+        return false;
+    }
+#endif
+
+    _files.push_back(f);
+    return true;
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+    auto add_changed = [&changed](const std::string &path)
+    {
+        if (std::find(changed.begin(), changed.end(), path) == changed.end())
+            changed.push_back(path);
+    };
+
+#ifdef __linux__
+    if (_fd < 0)
+        return changed;
+
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t length = read(_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break; // EAGAIN: nothing more for now.
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event *event = (const inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (!event->len)
+                continue;
+
+            for (const auto &f : _files)
+            {
+                if (f.watch == event->wd && f.name == event->name)
+                    add_changed(f.path);
+            }
+        }
+    }
+#else
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - _last_scan).count() < scan_interval)
+        return changed;
+    _last_scan = now;
+
+    for (auto &f : _files)
+    {
+        uint64_t size = 0, mtime = 0;
+        if (file_info(f.path, &size, &mtime) && (size != f.size || mtime != f.mtime))
+        {
+            f.size = size;
+            f.mtime = mtime;
+            add_changed(f.path);
+        }
+    }
+#endif
+
+    return changed;
+}
+
+void FileWatcher::clear()
+{
+#ifdef __linux__
+    if (_fd >= 0)
+    {
+        close(_fd); // and its watches.
+        _fd = -1;
+    }
+#endif
+    _files.clear();
+}
+
+} // namespace utils
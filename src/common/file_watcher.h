@@ -0,0 +1,56 @@
+#ifndef _FILE_WATCHER_2026_10_17_H_
+#define _FILE_WATCHER_2026_10_17_H_
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+
+namespace utils
+{
+    //
+    // Reports the files written since the last poll(). On Linux the directories of the files
+    // are watched with inotify: editors that save into a new file and rename it over the old
+    // one are seen too. Elsewhere poll() compares the sizes and dates, every scan_interval.
+    //
+    // poll() never blocks, it is meant to be called once per frame.
+    //
+    class FileWatcher
+    {
+    public:
+
+        static constexpr double scan_interval = 0.25; // seconds, without inotify.
+
+        FileWatcher() = default;
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+
+        // The file does not have to exist yet. Watching it twice does nothing.
+        bool add(const std::string &path);
+        size_t size() const { return _files.size(); }
+
+        // Paths as given to add(), each once however many times it was written.
+        std::vector<std::string> poll();
+
+        void clear();
+
+    private:
+
+        struct file
+        {
+            std::string path;
+            std::string name; // without the directory.
+            int watch = -1; // inotify watch of the directory.
+            uint64_t size = 0;
+            uint64_t mtime = 0;
+        };
+
+        std::vector<file> _files;
+        int _fd = -1; // inotify instance.
+        std::chrono::steady_clock::time_point _last_scan;
+    };
+}
+
+#endif // _FILE_WATCHER_2026_10_17_H_
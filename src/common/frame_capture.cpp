@@ -0,0 +1,309 @@
+#include "frame_capture.h"
+
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+
+namespace glutils
+{
+
+const int FrameCapture::nb_slots;
+const int FrameCapture::max_queued;
+
+FrameCapture::~FrameCapture()
+{
+    shutdown();
+}
+
+void FrameCapture::start(const std::string &prefix, Format format, utils::ThreadPool &pool)
+{
+    stop();
+
+    _prefix = prefix;
+    _format = format;
+    _pool = &pool;
+    _active = true;
+    _nb_captured = 0;
+    _nb_stalls = 0;
+    _last_ms = 0.0;
+    _max_ms = 0.0;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _nb_written = 0;
+}
+
+void FrameCapture::stop()
+{
+    finish();
+    _active = false;
+}
+
+void FrameCapture::shutdown()
+{
+    stop();
+
+    for (auto &s : _slots)
+    {
+        if (s.buffer)
+        {
+            glUnmapNamedBuffer(s.buffer);
+            glDeleteBuffers(1, &s.buffer);
+        }
+        s = slot();
+    }
+}
+
+int FrameCapture::nb_written() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _nb_written;
+}
+
+int FrameCapture::nb_queued() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _nb_jobs;
+}
+
+std::string FrameCapture::filename(int frame) const
+{
+    char number[16];
+    snprintf(number, sizeof(number), "%06d", frame);
+    return _prefix + number + (_format == Format::png ? ".png" : ".hdr");
+}
+
+FrameCapture::slot *FrameCapture::free_slot()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &s : _slots)
+    {
+        if (!s.fence && !s.copying)
+            return &s;
+    }
+    return nullptr;
+}
+
+void FrameCapture::capture(GLuint texture, int width, int height)
+{
+    if (!_active || !texture || width <= 0 || height <= 0)
+        return;
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    poll(false);
+
+    // every slot in flight, or being copied out by a worker.
+    bool stalled = false;
+    slot *s = free_slot();
+    while (!s)
+    {
+        stalled = true;
+        bool in_flight = false;
+        for (const auto &other : _slots)
+            in_flight = in_flight || other.fence;
+
+        if (in_flight)
+        {
+            poll(true);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]
+            {
+                for (const auto &other : _slots)
+                {
+                    if (!other.copying)
+                        return true;
+                }
+                return false;
+            });
+        }
+        s = free_slot();
+    }
+
+    // the copies out are fast, the encoding is not: bounds the frames waiting in memory.
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_nb_jobs >= max_queued)
+        {
+            stalled = true;
+            _cv.wait(lock, [this] { return _nb_jobs < max_queued; });
+        }
+    }
+    if (stalled)
+    {
+        ++_nb_stalls;
+    }
+
+    const bool png = _format == Format::png;
+    const size_t size = (size_t)width * height * (png ? 4 : 4 * sizeof(float));
+    if (s->size < size)
+    {
+        if (s->buffer)
+        {
+            glUnmapNamedBuffer(s->buffer);
+            glDeleteBuffers(1, &s->buffer);
+        }
+
+        // read by the workers while mapped, the fence makes the gpu writes visible.
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &s->buffer);
+        glNamedBufferStorage(s->buffer, size, nullptr, flags);
+        s->mapped = glMapNamedBufferRange(s->buffer, 0, size, flags);
+        s->size = size;
+        if (!s->mapped)
+        {
+            printf("FAILED to map a %.1f MB readback buffer, capture stopped\n", size / (1024.0 * 1024.0));
+            glDeleteBuffers(1, &s->buffer);
+            *s = slot();
+            stop();
+            return;
+        }
+    }
+
+    // rgba: the layout of the framebuffers, no conversion on the way.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s->buffer);
+    glGetTextureImage(texture, 0, GL_RGBA, png ? GL_UNSIGNED_BYTE : GL_FLOAT, (GLsizei)size, nullptr); // offset 0 in the pbo.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    s->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s->frame = _nb_captured++;
+    s->width = width;
+    s->height = height;
+
+    _last_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    _max_ms = std::max(_max_ms, _last_ms);
+}
+
+void FrameCapture::poll(bool wait)
+{
+    for (;;)
+    {
+        slot *oldest = nullptr;
+        for (auto &s : _slots)
+        {
+            if (s.fence && (!oldest || s.frame < oldest->frame))
+                oldest = &s;
+        }
+        if (!oldest)
+            return;
+
+        // the flush makes sure the fence gets to the gpu, else it could never signal.
+        GLenum status = glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0); // 1 s
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            if (!wait)
+                return;
+            continue;
+        }
+
+        glDeleteSync(oldest->fence);
+        oldest->fence = nullptr;
+        if (status == GL_WAIT_FAILED)
+        {
+            printf("FAILED to read back frame %d\n", oldest->frame);
+            continue;
+        }
+
+        hand_over(*oldest);
+        wait = false; // only for the oldest one.
+    }
+}
+
+void FrameCapture::hand_over(slot &s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        s.copying = true;
+        ++_nb_jobs;
+    }
+
+    slot *ps = &s;
+    const std::string file = filename(s.frame);
+    const bool png = _format == Format::png;
+    const int width = s.width;
+    const int height = s.height;
+    const void *mapped = s.mapped;
+
+    _pool->submit([this, ps, file, png, width, height, mapped]()
+    {
+        // GL rows are bottom up, the files top down.
+        std::vector<unsigned char> ldr;
+        std::vector<float> hdr;
+        if (png)
+        {
+            ldr.resize((size_t)width * height * 3);
+            for (int y = 0; y < height; ++y)
+            {
+                const unsigned char *in = (const unsigned char*)mapped + (size_t)(height - 1 - y) * width * 4;
+                unsigned char *out = ldr.data() + (size_t)y * width * 3;
+                for (int x = 0; x < width; ++x, in += 4, out += 3)
+                {
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                }
+            }
+        }
+        else
+        {
+            hdr.resize((size_t)width * height * 3);
+            for (int y = 0; y < height; ++y)
+            {
+                const float *in = (const float*)mapped + (size_t)(height - 1 - y) * width * 4;
+                float *out = hdr.data() + (size_t)y * width * 3;
+                for (int x = 0; x < width; ++x, in += 4, out += 3)
+                {
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                }
+            }
+        }
+
+        // the slot can take the next frame while this one is encoded.
+        // notified under the lock: once it is released, finish() may return and this be gone.
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ps->copying = false;
+            _cv.notify_all();
+        }
+
+        bool ok = png
+            ? stbi_write_png(file.c_str(), width, height, 3, ldr.data(), width * 3) != 0
+            : stbi_write_hdr(file.c_str(), width, height, 3, hdr.data()) != 0;
+        if (!ok)
+        {
+            printf("FAILED to write \"%s\"\n", file.c_str());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_nb_jobs;
+            if (ok)
+                ++_nb_written;
+            _cv.notify_all();
+        }
+    });
+}
+
+void FrameCapture::finish()
+{
+    for (;;)
+    {
+        bool in_flight = false;
+        for (const auto &s : _slots)
+            in_flight = in_flight || s.fence;
+        if (!in_flight)
+            break;
+
+        poll(true);
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] { return _nb_jobs == 0; });
+}
+
+} // namespace glutils
@@ -0,0 +1,105 @@
+#ifndef _FRAME_CAPTURE_2026_10_17_H_
+#define _FRAME_CAPTURE_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include "thread_pool.h"
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stddef.h>
+
+namespace glutils
+{
+    //
+    // Image sequence export. capture() queues the copy of a texture into one of nb_slots
+    // persistently mapped pixel pack buffers, followed by a fence, and returns. The slots whose
+    // fence has signaled are handed to the thread pool, which copies the pixels out (flipped,
+    // top row first), frees the slot and writes the file with stb_image_write: a PNG of the
+    // rgba8 readback, or a Radiance .hdr of the float one.
+    //
+    // The GL thread never maps nor reads the pixels. It only waits when the gpu is nb_slots
+    // frames behind, or when max_queued files are waiting to be written (nb_stalls()).
+    //
+    // GL thread only, except the stats.
+    //
+    class FrameCapture
+    {
+    public:
+
+        enum class Format
+        {
+            png, // 8 bits RGB.
+            hdr, // float RGB.
+        };
+
+        static const int nb_slots = 3;
+        static const int max_queued = 16; // frames copied out, not written yet.
+
+        FrameCapture() = default;
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture &) = delete;
+        FrameCapture &operator=(const FrameCapture &) = delete;
+
+        // Files are prefix + 6 digits frame number + ".png"/".hdr", numbered from 0.
+        void start(const std::string &prefix, Format format, utils::ThreadPool &pool = utils::thread_pool());
+        void stop(); // finish(), the buffers are kept for the next start().
+        bool active() const { return _active; }
+
+        // After the texture is rendered, once per frame.
+        void capture(GLuint texture, int width, int height);
+
+        // Waits for every readback, then for every file.
+        void finish();
+
+        void shutdown();
+
+        // stats
+        int nb_captured() const { return _nb_captured; }
+        int nb_stalls() const { return _nb_stalls; }
+        int nb_written() const;
+        int nb_queued() const;
+        double last_ms() const { return _last_ms; } // cpu time of the last capture().
+        double max_ms() const { return _max_ms; }
+
+    private:
+
+        struct slot
+        {
+            GLuint buffer = 0;
+            void *mapped = nullptr;
+            size_t size = 0;
+            GLsync fence = nullptr; // readback in flight.
+            int frame = 0;
+            int width = 0;
+            int height = 0;
+            bool copying = false; // by a worker, under _mutex.
+        };
+
+        // Hands the signaled slots over, in frame order. wait: blocks on the oldest one.
+        void poll(bool wait);
+        void hand_over(slot &s);
+        slot *free_slot();
+        std::string filename(int frame) const;
+
+        slot _slots[nb_slots];
+        utils::ThreadPool *_pool = nullptr;
+        std::string _prefix;
+        Format _format = Format::png;
+        bool _active = false;
+        int _nb_captured = 0;
+        int _nb_stalls = 0;
+        double _last_ms = 0.0;
+        double _max_ms = 0.0;
+
+        mutable std::mutex _mutex;
+        std::condition_variable _cv;
+        int _nb_jobs = 0; // handed over, not written yet.
+        int _nb_written = 0;
+    };
+}
+
+#endif // _FRAME_CAPTURE_2026_10_17_H_
@@ -1,10 +1,11 @@
 #include "gl_utils.h"
 
-#include "stb_image.h"
-
 #include <string>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
 namespace glutils
 {
@@ -43,10 +44,30 @@ void check_error()
     printf("gl error: %s\n", errorStr.c_str());
 }
 
+std::string glsl_for_context(const char *buffer, size_t size)
+{
+    std::string text(buffer, size);
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major * 10 + minor < 46)
+    {
+        const size_t version = text.find("#version 460");
+        if (version != std::string::npos)
+        {
+            text.replace(version, 12, "#version 450");
+        }
+    }
+    return text;
+}
+
 bool compile_shader(GLuint shader, const char* buffer, size_t bufferSize)
 {
-    GLint length = (GLint)bufferSize;
-    glShaderSource(shader, 1, &buffer, &length);
+    const std::string source = glsl_for_context(buffer, bufferSize);
+    const char *text = source.c_str();
+    GLint length = (GLint)source.size();
+    glShaderSource(shader, 1, &text, &length);
     glCompileShader(shader);
 
     int logSize;
@@ -56,7 +77,7 @@ bool compile_shader(GLuint shader, const char* buffer, size_t bufferSize)
     {
         std::vector<char> log(logSize);
         glGetShaderInfoLog(shader, logSize, &logSize, log.data());
-        std::cout << buffer << std::endl;
+        std::cout << text << std::endl;
         std::cout << "Compile: " << log.data() << std::endl;
     }
 
@@ -86,31 +107,202 @@ bool link_program(GLuint program, GLuint vertexShader, GLuint fragmentShader)
     return (status != GL_FALSE);
 }
 
+bool link_program(GLuint program, GLuint computeShader)
+{
+    glAttachShader(program, computeShader);
+    glLinkProgram(program);
+
+    int logSize;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+
+    if (logSize > 1)
+    {
+        std::vector<char> log(logSize);
+        glGetProgramInfoLog(program, logSize, &logSize, log.data());
+        std::cout << "Link: " << log.data() << std::endl;
+    }
+
+    int status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return (status != GL_FALSE);
+}
+
 //
 // TEXTURE
 //
 
-void load_image_hdr(GLuint *tex_id, const std::string &filename)
+HdrGLFormat hdr_gl_format(utils::HdrFormat format)
 {
-    stbi_set_flip_vertically_on_load(1);
+    switch (format)
+    {
+        case utils::HdrFormat::rgb9e5: return { GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV };
+        case utils::HdrFormat::r11g11b10f: return { GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV };
+        case utils::HdrFormat::rgb16f: return { GL_RGB16F, GL_RGB, GL_HALF_FLOAT };
+        default: return { GL_RGB32F, GL_RGB, GL_FLOAT };
+    }
+}
 
-    int image_width, image_height, image_components;
-    float *image_data = stbi_loadf(filename.c_str(), &image_width, &image_height, &image_components, 0);
+bool hdr_format_supported(utils::HdrFormat format)
+{
+    const GLenum internal_format = hdr_gl_format(format).internal_format;
 
-    GLenum internalFormat = GL_RGB32F;
-    GLenum format = GL_RGB;
-    GLenum type = GL_FLOAT;
+    GLint supported = GL_FALSE;
+    glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+    if (supported != GL_TRUE)
+        return false;
+
+    GLint filter = GL_NONE;
+    glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_FILTER, 1, &filter);
+    return filter == GL_FULL_SUPPORT;
+}
+
+void create_texture_hdr(GLuint *tex_id, utils::HdrFormat format, int width, int height, int nb_levels)
+{
+    int max_levels = 1;
+    while ((std::max(width, height) >> max_levels) > 0)
+        ++max_levels;
+    nb_levels = std::min(nb_levels, max_levels);
 
     glCreateTextures(GL_TEXTURE_2D, 1, tex_id);
-    glTextureStorage2D(*tex_id, 5, internalFormat, image_width, image_height); // 5 mip levels
-    glTextureSubImage2D(*tex_id, 0, 0, 0, image_width, image_height, format, type, image_data); // upload first mip level
-    glGenerateTextureMipmap(*tex_id);
+    glTextureStorage2D(*tex_id, nb_levels, hdr_gl_format(format).internal_format, width, height);
 
     // constrain sampler (or texture sampler?)
     glTextureParameteri(*tex_id, GL_TEXTURE_BASE_LEVEL, 0);
-    glTextureParameteri(*tex_id, GL_TEXTURE_MAX_LEVEL, 4);
+    glTextureParameteri(*tex_id, GL_TEXTURE_MAX_LEVEL, nb_levels - 1);
+}
+
+void load_image_hdr(GLuint *tex_id, const std::string &filename)
+{
+    utils::ImageHdr image;
+    if (!utils::decode_image_hdr(filename, &image))
+    {
+        // 1 black texel, still a complete texture.
+        image.width = image.height = 1;
+        image.pixels.assign(3, 0.0f);
+    }
+
+    GLenum format = GL_RGB;
+    GLenum type = GL_FLOAT;
+
+    create_texture_hdr(tex_id, utils::HdrFormat::rgb32f, image.width, image.height, 5); // 5 mip levels
+    glTextureSubImage2D(*tex_id, 0, 0, 0, image.width, image.height, format, type, image.pixels.data()); // upload first mip level
+    glGenerateTextureMipmap(*tex_id);
+}
+
+//
+// FRAMEBUFFER
+//
+
+struct color_format
+{
+    const char *name;
+    GLenum internal_format;
+    size_t size;
+};
+
+static const color_format color_formats[] = {
+    { "rgba8",      GL_RGBA8,           4 },
+    { "rgb10a2",    GL_RGB10_A2,        4 },
+    { "rgba16f",    GL_RGBA16F,         8 },
+    { "r11g11b10f", GL_R11F_G11F_B10F,  4 },
+    { "rgba32f",    GL_RGBA32F,        16 },
+};
+
+bool parse_color_format(const std::string &name, GLenum *internal_format)
+{
+    for (const auto &f : color_formats)
+    {
+        if (name == f.name)
+        {
+            *internal_format = f.internal_format;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *color_format_name(GLenum internal_format)
+{
+    for (const auto &f : color_formats)
+    {
+        if (f.internal_format == internal_format)
+            return f.name;
+    }
+    return "unknown";
+}
+
+size_t color_format_size(GLenum internal_format)
+{
+    for (const auto &f : color_formats)
+    {
+        if (f.internal_format == internal_format)
+            return f.size;
+    }
+    return 0;
+}
+
+bool color_format_renderable(GLenum internal_format)
+{
+    GLint renderable = GL_NONE;
+    glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_FRAMEBUFFER_RENDERABLE, 1, &renderable);
+    return renderable == GL_FULL_SUPPORT;
+}
+
+bool check_framebuffer(GLuint framebuffer, const char *name)
+{
+    GLenum status = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("FAILED framebuffer %s is not complete (0x%04x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+bool read_texture_rgba8(GLuint texture, int *width, int *height, std::vector<unsigned char> *pixels)
+{
+    if (!texture)
+        return false;
+
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, height);
+    const size_t size = (size_t)*width * *height * 4;
+    if (size == 0)
+        return false;
+
+    GLuint pbo;
+    glCreateBuffers(1, &pbo);
+    glNamedBufferStorage(pbo, size, nullptr, GL_MAP_READ_BIT);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLsizei)size, nullptr); // offset 0 in the pbo.
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 10000000000ull); // 10 s
+    glDeleteSync(fence);
+
+    bool ok = false;
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+    {
+        const void *ptr = glMapNamedBufferRange(pbo, 0, size, GL_MAP_READ_BIT);
+        if (ptr)
+        {
+            pixels->resize(size);
+            memcpy(pixels->data(), ptr, size);
+            glUnmapNamedBuffer(pbo);
+            ok = true;
+        }
+    }
+    if (!ok)
+    {
+        printf("FAILED to read back texture %u\n", texture);
+    }
 
-    stbi_image_free(image_data);
+    glDeleteBuffers(1, &pbo);
+    return ok;
 }
 
 } // namespace glutils
@@ -2,16 +2,56 @@
 #define _GL_UTILS_2018_12_04_H_
 
 #include <GL/glew.h>
+#include "hdr_texture.h"
+
 #include <string>
+#include <vector>
 
 namespace glutils
 {
     void check_error();
 
+    // The shaders say "#version 460 core" but need nothing past 4.5: on a 4.5 context (the
+    // headless fallback, llvmpipe in older Mesa) their #version line is lowered to 450.
+    std::string glsl_for_context(const char *buffer, size_t size);
+
     bool compile_shader(GLuint shader, const char* buffer, size_t bufferSize);
     bool link_program(GLuint program, GLuint vertexShader, GLuint fragmentShader);
+    bool link_program(GLuint program, GLuint computeShader);
+
+    // GL enums of an HDR texel format, for glTextureStorage2D and glTextureSubImage2D.
+    struct HdrGLFormat
+    {
+        GLenum internal_format;
+        GLenum format;
+        GLenum type;
+    };
+    HdrGLFormat hdr_gl_format(utils::HdrFormat format);
+
+    // Can be sampled with linear filtering. Some software GLs cannot, for the packed formats.
+    bool hdr_format_supported(utils::HdrFormat format);
+
+    // Storage only, the levels are left to the caller. nb_levels is capped to the full chain.
+    void create_texture_hdr(GLuint *tex_id, utils::HdrFormat format, int width, int height, int nb_levels);
 
     void load_image_hdr(GLuint *tex_id, const std::string &filename);
+
+    //
+    // FRAMEBUFFER
+    //
+
+    // Color attachment formats, by name: rgba8, rgb10a2, rgba16f, r11g11b10f, rgba32f.
+    bool parse_color_format(const std::string &name, GLenum *internal_format);
+    const char *color_format_name(GLenum internal_format);
+    size_t color_format_size(GLenum internal_format); // bytes per pixel.
+    bool color_format_renderable(GLenum internal_format);
+
+    // Prints the status if it is not complete.
+    bool check_framebuffer(GLuint framebuffer, const char *name);
+
+    // Level 0 of a texture, as RGBA8 rows from the bottom, through a pixel pack buffer.
+    // Waits for the gpu.
+    bool read_texture_rgba8(GLuint texture, int *width, int *height, std::vector<unsigned char> *pixels);
 }
 
 #endif // _GL_UTILS_2018_12_04_H_
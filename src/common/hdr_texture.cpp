@@ -0,0 +1,500 @@
+#include "hdr_texture.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+
+namespace utils
+{
+
+bool decode_image_hdr(const std::string &filename, ImageHdr *image)
+{
+    // the flip flag of stb_image is global: flip the rows here instead, so the loads can
+    // run on several threads.
+    int image_width, image_height, image_components;
+    float *image_data = stbi_loadf(filename.c_str(), &image_width, &image_height, &image_components, 3);
+    if (!image_data)
+    {
+        printf("FAILED to load image \"%s\": %s\n", filename.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    const size_t row_size = (size_t)image_width * 3;
+    image->width = image_width;
+    image->height = image_height;
+    image->pixels.resize(row_size * image_height);
+    for (int y = 0; y < image_height; ++y)
+    {
+        const float *src = image_data + (size_t)(image_height - 1 - y) * row_size;
+        std::copy(src, src + row_size, image->pixels.begin() + y * row_size);
+    }
+
+    stbi_image_free(image_data);
+    return true;
+}
+
+//
+// FORMATS
+//
+
+bool parse_hdr_format(const std::string &name, HdrFormat *format)
+{
+    if (name == "rgb32f")     { *format = HdrFormat::rgb32f;     return true; }
+    if (name == "rgb9e5")     { *format = HdrFormat::rgb9e5;     return true; }
+    if (name == "r11g11b10f") { *format = HdrFormat::r11g11b10f; return true; }
+    if (name == "rgb16f")     { *format = HdrFormat::rgb16f;     return true; }
+    return false;
+}
+
+const char *hdr_format_name(HdrFormat format)
+{
+    switch (format)
+    {
+        case HdrFormat::rgb32f: return "rgb32f";
+        case HdrFormat::rgb9e5: return "rgb9e5";
+        case HdrFormat::r11g11b10f: return "r11g11b10f";
+        case HdrFormat::rgb16f: return "rgb16f";
+    }
+    return "unknown";
+}
+
+size_t hdr_texel_size(HdrFormat format)
+{
+    switch (format)
+    {
+        case HdrFormat::rgb32f: return 3 * sizeof(float);
+        case HdrFormat::rgb16f: return 3 * sizeof(uint16_t);
+        default: return sizeof(uint32_t);
+    }
+}
+
+// EXT_texture_shared_exponent: 9 bits mantissas, 5 bits exponent with a bias of 15.
+static const int rgb9e5_mantissa_bits = 9;
+static const int rgb9e5_exponent_bias = 15;
+static const float rgb9e5_max = 65408.0f; // (2^9 - 1) / 2^9 * 2^16
+
+uint32_t pack_rgb9e5(const float *rgb)
+{
+    float c[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        // also sends NaN to 0.
+        c[i] = (rgb[i] > 0.0f) ? std::min(rgb[i], rgb9e5_max) : 0.0f;
+    }
+    const float max_c = std::max(c[0], std::max(c[1], c[2]));
+
+    // floor(log2(max_c)), exact with frexp.
+    int exponent = -rgb9e5_exponent_bias - 1;
+    if (max_c > 0.0f)
+    {
+        int e;
+        frexpf(max_c, &e);
+        exponent = std::max(exponent, e - 1);
+    }
+    int shared = exponent + 1 + rgb9e5_exponent_bias;
+
+    // the rounding of the largest channel can need one more bit.
+    if ((int)floorf(ldexpf(max_c, rgb9e5_mantissa_bits + rgb9e5_exponent_bias - shared) + 0.5f) == (1 << rgb9e5_mantissa_bits))
+    {
+        ++shared;
+    }
+
+    uint32_t v = (uint32_t)shared << 27;
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t m = (uint32_t)floorf(ldexpf(c[i], rgb9e5_mantissa_bits + rgb9e5_exponent_bias - shared) + 0.5f);
+        v |= std::min(m, (1u << rgb9e5_mantissa_bits) - 1) << (i * 9);
+    }
+    return v;
+}
+
+void unpack_rgb9e5(uint32_t v, float *rgb)
+{
+    const int shared = (int)(v >> 27);
+    for (int i = 0; i < 3; ++i)
+    {
+        rgb[i] = ldexpf((float)((v >> (i * 9)) & 0x1ff), shared - rgb9e5_exponent_bias - rgb9e5_mantissa_bits);
+    }
+}
+
+// unsigned float with a 5 bits exponent (bias 15) and `mantissa_bits` bits of mantissa.
+static uint32_t pack_small_float(float f, int mantissa_bits)
+{
+    const uint32_t max_value = (30u << mantissa_bits) | ((1u << mantissa_bits) - 1);
+    const float max_finite = ldexpf(2.0f - ldexpf(1.0f, -mantissa_bits), 15);
+    if (!(f > 0.0f))
+        return 0;
+    if (!(f <= max_finite))
+        return max_value; // +INF too: frexpf leaves its exponent unspecified.
+
+    int e;
+    float m = frexpf(f, &e); // f = m * 2^e, m in [0.5, 1)
+    int biased = e - 1 + 15;
+    if (biased <= 0)
+    {
+        // denormal. Rounding up to 2^mantissa_bits lands on the smallest normal, as it should.
+        return (uint32_t)(ldexpf(f, 14 + mantissa_bits) + 0.5f);
+    }
+
+    // a mantissa carry moves to the exponent, as it should.
+    uint32_t v = ((uint32_t)biased << mantissa_bits) + (uint32_t)(ldexpf(2.0f * m - 1.0f, mantissa_bits) + 0.5f);
+    return std::min(v, max_value);
+}
+
+static float unpack_small_float(uint32_t v, int mantissa_bits)
+{
+    const uint32_t exponent = v >> mantissa_bits;
+    const uint32_t mantissa = v & ((1u << mantissa_bits) - 1);
+    if (exponent == 0)
+    {
+        return ldexpf((float)mantissa, -14 - mantissa_bits);
+    }
+    return ldexpf(1.0f + ldexpf((float)mantissa, -mantissa_bits), (int)exponent - 15);
+}
+
+uint32_t pack_r11g11b10f(const float *rgb)
+{
+    return pack_small_float(rgb[0], 6) | (pack_small_float(rgb[1], 6) << 11) | (pack_small_float(rgb[2], 5) << 22);
+}
+
+void unpack_r11g11b10f(uint32_t v, float *rgb)
+{
+    rgb[0] = unpack_small_float(v & 0x7ff, 6);
+    rgb[1] = unpack_small_float((v >> 11) & 0x7ff, 6);
+    rgb[2] = unpack_small_float(v >> 22, 5);
+}
+
+// a positive half is a small float with 10 bits of mantissa.
+uint16_t float_to_half(float f)
+{
+    return (uint16_t)pack_small_float(f, 10);
+}
+
+float half_to_float(uint16_t h)
+{
+    return unpack_small_float(h & 0x7fff, 10);
+}
+
+static void encode_texels(const float *src, size_t count, HdrFormat format, unsigned char *dst)
+{
+    switch (format)
+    {
+        case HdrFormat::rgb32f:
+        {
+            memcpy(dst, src, count * 3 * sizeof(float));
+        } break;
+
+        case HdrFormat::rgb9e5:
+        {
+            uint32_t *texels = (uint32_t*)dst;
+            for (size_t i = 0; i < count; ++i)
+                texels[i] = pack_rgb9e5(src + 3 * i);
+        } break;
+
+        case HdrFormat::r11g11b10f:
+        {
+            uint32_t *texels = (uint32_t*)dst;
+            for (size_t i = 0; i < count; ++i)
+                texels[i] = pack_r11g11b10f(src + 3 * i);
+        } break;
+
+        case HdrFormat::rgb16f:
+        {
+            uint16_t *halves = (uint16_t*)dst;
+            for (size_t i = 0; i < 3 * count; ++i)
+                halves[i] = float_to_half(src[i]);
+        } break;
+    }
+}
+
+static void decode_texels(const unsigned char *src, size_t count, HdrFormat format, float *dst)
+{
+    switch (format)
+    {
+        case HdrFormat::rgb32f:
+        {
+            memcpy(dst, src, count * 3 * sizeof(float));
+        } break;
+
+        case HdrFormat::rgb9e5:
+        {
+            const uint32_t *texels = (const uint32_t*)src;
+            for (size_t i = 0; i < count; ++i)
+                unpack_rgb9e5(texels[i], dst + 3 * i);
+        } break;
+
+        case HdrFormat::r11g11b10f:
+        {
+            const uint32_t *texels = (const uint32_t*)src;
+            for (size_t i = 0; i < count; ++i)
+                unpack_r11g11b10f(texels[i], dst + 3 * i);
+        } break;
+
+        case HdrFormat::rgb16f:
+        {
+            const uint16_t *halves = (const uint16_t*)src;
+            for (size_t i = 0; i < 3 * count; ++i)
+                dst[i] = half_to_float(halves[i]);
+        } break;
+    }
+}
+
+//
+// MIP CHAIN
+//
+
+// rows per parallel_for chunk.
+static const size_t hdr_rows_grain = 16;
+
+void HdrMipChain::build(const ImageHdr &image, HdrFormat format, int max_levels, ThreadPool &pool)
+{
+    _file.close();
+    _payload = nullptr;
+    _format = format;
+    _levels.clear();
+
+    // level table first, for one payload allocation.
+    int width = image.width;
+    int height = image.height;
+    size_t offset = 0;
+    for (;;)
+    {
+        level l;
+        l.width = width;
+        l.height = height;
+        l.offset = offset;
+        l.size = (size_t)width * height * hdr_texel_size(format);
+        _levels.push_back(l);
+        offset += l.size;
+
+        if ((width == 1 && height == 1) || (max_levels > 0 && (int)_levels.size() == max_levels))
+            break;
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    _payload_size = offset;
+    _data.resize(_payload_size);
+
+    // 2x2 box filter of the float level above, odd last rows/columns are dropped.
+    std::vector<float> src;
+    std::vector<float> dst;
+    const std::vector<float> *current = &image.pixels;
+    for (size_t i = 0; i < _levels.size(); ++i)
+    {
+        const level &l = _levels[i];
+        if (i > 0)
+        {
+            const level &above = _levels[i - 1];
+            dst.resize((size_t)l.width * l.height * 3);
+            pool.parallel_for(l.height, hdr_rows_grain, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const size_t y0 = std::min<size_t>(2 * y, above.height - 1);
+                    const size_t y1 = std::min<size_t>(2 * y + 1, above.height - 1);
+                    for (int x = 0; x < l.width; ++x)
+                    {
+                        const size_t x0 = std::min<size_t>(2 * x, above.width - 1);
+                        const size_t x1 = std::min<size_t>(2 * x + 1, above.width - 1);
+                        const float *a = current->data() + 3 * (y0 * above.width + x0);
+                        const float *b = current->data() + 3 * (y0 * above.width + x1);
+                        const float *c = current->data() + 3 * (y1 * above.width + x0);
+                        const float *d = current->data() + 3 * (y1 * above.width + x1);
+                        float *out = dst.data() + 3 * (y * l.width + x);
+                        for (int k = 0; k < 3; ++k)
+                            out[k] = 0.25f * (a[k] + b[k] + c[k] + d[k]);
+                    }
+                }
+            });
+            src.swap(dst);
+            current = &src;
+        }
+
+        unsigned char *out = _data.data() + l.offset;
+        const size_t texel_size = hdr_texel_size(format);
+        pool.parallel_for(l.height, hdr_rows_grain, [&](size_t begin, size_t end)
+        {
+            const size_t first = begin * l.width;
+            encode_texels(current->data() + 3 * first, (end - begin) * l.width, format, out + first * texel_size);
+        });
+    }
+}
+
+void HdrMipChain::convert(HdrFormat format, HdrMipChain *out, ThreadPool &pool) const
+{
+    out->_file.close();
+    out->_payload = nullptr;
+    out->_format = format;
+    out->_levels = _levels;
+
+    size_t offset = 0;
+    for (auto &l : out->_levels)
+    {
+        l.offset = offset;
+        l.size = (size_t)l.width * l.height * hdr_texel_size(format);
+        offset += l.size;
+    }
+    out->_payload_size = offset;
+    out->_data.resize(offset);
+
+    for (size_t i = 0; i < _levels.size(); ++i)
+    {
+        const level &src = _levels[i];
+        const level &dst = out->_levels[i];
+        const unsigned char *in = payload() + src.offset;
+        unsigned char *result = out->_data.data() + dst.offset;
+        pool.parallel_for(src.height, hdr_rows_grain, [&](size_t begin, size_t end)
+        {
+            std::vector<float> row((size_t)src.width * 3);
+            for (size_t y = begin; y < end; ++y)
+            {
+                const size_t first = y * src.width;
+                decode_texels(in + first * hdr_texel_size(_format), src.width, _format, row.data());
+                encode_texels(row.data(), src.width, format, result + first * hdr_texel_size(format));
+            }
+        });
+    }
+}
+
+//
+// FILE
+//
+
+// bump when the layout or the encoding changes.
+static const uint32_t hdr_mips_version = 1;
+static const char hdr_mips_magic[8] = { 'G', 'L', 'X', 'P', 'H', 'D', 'R', '\0' };
+
+// the payload starts aligned, for the mapped reads.
+static const uint64_t hdr_mips_alignment = 16;
+
+struct hdr_mips_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint32_t nb_levels;
+    uint32_t reserved;
+    uint64_t payload_offset;
+    uint64_t payload_size;
+};
+
+struct hdr_mips_level
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+bool HdrMipChain::write(const std::string &filename) const
+{
+    hdr_mips_header header = {};
+    memcpy(header.magic, hdr_mips_magic, sizeof(header.magic));
+    header.version = hdr_mips_version;
+    header.format = (uint32_t)_format;
+    header.nb_levels = (uint32_t)_levels.size();
+    header.payload_offset = (sizeof(header) + _levels.size() * sizeof(hdr_mips_level) + hdr_mips_alignment - 1) & ~(hdr_mips_alignment - 1);
+    header.payload_size = _payload_size;
+
+    std::vector<hdr_mips_level> table(_levels.size());
+    for (size_t i = 0; i < _levels.size(); ++i)
+    {
+        table[i].width = (uint32_t)_levels[i].width;
+        table[i].height = (uint32_t)_levels[i].height;
+        table[i].offset = _levels[i].offset;
+        table[i].size = _levels[i].size;
+    }
+
+    // written aside then renamed, so an interrupted write never looks like a valid file.
+    const std::string tmp_path = filename + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            printf("FAILED to write: %s\n", tmp_path.c_str());
+            return false;
+        }
+
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.write((const char*)table.data(), table.size() * sizeof(hdr_mips_level));
+        ofs.seekp(header.payload_offset);
+        ofs.write((const char*)payload(), _payload_size);
+
+        if (!ofs.good())
+        {
+            ofs.close();
+            remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    remove(filename.c_str());
+    if (rename(tmp_path.c_str(), filename.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool HdrMipChain::read(const std::string &filename)
+{
+    _data.clear();
+    _levels.clear();
+    _payload = nullptr;
+    _payload_size = 0;
+
+    if (!_file.open(filename))
+        return false;
+
+    hdr_mips_header header;
+    bool valid = _file.size() >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, _file.data(), sizeof(header));
+        valid = memcmp(header.magic, hdr_mips_magic, sizeof(header.magic)) == 0
+            && header.version == hdr_mips_version
+            && header.format <= (uint32_t)HdrFormat::rgb16f
+            && header.nb_levels > 0
+            && sizeof(header) + header.nb_levels * sizeof(hdr_mips_level) <= header.payload_offset
+            && header.payload_offset + header.payload_size == _file.size();
+    }
+
+    if (valid)
+    {
+        _format = (HdrFormat)header.format;
+        const hdr_mips_level *table = (const hdr_mips_level*)(_file.data() + sizeof(header));
+        for (uint32_t i = 0; i < header.nb_levels && valid; ++i)
+        {
+            level l;
+            l.width = (int)table[i].width;
+            l.height = (int)table[i].height;
+            l.offset = (size_t)table[i].offset;
+            l.size = (size_t)table[i].size;
+            valid = l.width > 0 && l.height > 0
+                && l.size == (size_t)l.width * l.height * hdr_texel_size(_format)
+                && table[i].offset + table[i].size <= header.payload_size;
+            _levels.push_back(l);
+        }
+    }
+
+    if (!valid)
+    {
+        printf("FAILED to read HDR mips \"%s\": not a valid .hdrmips file\n", filename.c_str());
+        _file.close();
+        _levels.clear();
+        return false;
+    }
+
+    _payload = _file.data() + header.payload_offset;
+    _payload_size = (size_t)header.payload_size;
+    return true;
+}
+
+} // namespace utils
@@ -0,0 +1,102 @@
+#ifndef _HDR_TEXTURE_2026_10_17_H_
+#define _HDR_TEXTURE_2026_10_17_H_
+
+#include "utils.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace utils
+{
+    // RGB float image, first row at the bottom (GL order).
+    struct ImageHdr
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<float> pixels;
+    };
+
+    // Radiance .hdr (or anything stb_image reads as floats). Safe on any thread.
+    bool decode_image_hdr(const std::string &filename, ImageHdr *image);
+
+    //
+    // Texel formats of an HDR texture. rgb9e5 (shared exponent) and r11g11b10f (unsigned
+    // small floats) are 4 bytes per texel, 3x less than rgb32f, and are both core GL
+    // formats. rgb16f keeps more precision for 6 bytes. Negative values are clamped to 0,
+    // large ones to the format max.
+    //
+    enum class HdrFormat : uint32_t
+    {
+        rgb32f = 0,
+        rgb9e5 = 1,
+        r11g11b10f = 2,
+        rgb16f = 3,
+    };
+
+    bool parse_hdr_format(const std::string &name, HdrFormat *format);
+    const char *hdr_format_name(HdrFormat format);
+    size_t hdr_texel_size(HdrFormat format);
+
+    uint32_t pack_rgb9e5(const float *rgb);
+    void unpack_rgb9e5(uint32_t v, float *rgb);
+    uint32_t pack_r11g11b10f(const float *rgb);
+    void unpack_r11g11b10f(uint32_t v, float *rgb);
+    uint16_t float_to_half(float f); // clamped to [0, 65504]
+    float half_to_float(uint16_t h);
+
+    //
+    // Whole mip chain of an HDR texture, encoded on the cpu: one payload, levels in order.
+    //
+    // The mips are box filtered in floats from the previous level, then each level is
+    // encoded. A chain is written to a ".hdrmips" file (header, level table, payload), and
+    // read back through a memory mapping: the levels are uploaded from the mapped file.
+    //
+    class HdrMipChain
+    {
+    public:
+
+        struct level
+        {
+            int width;
+            int height;
+            size_t offset; // in the payload.
+            size_t size;
+        };
+
+        // max_levels == 0 -> down to 1x1.
+        void build(const ImageHdr &image, HdrFormat format, int max_levels = 0, ThreadPool &pool = thread_pool());
+
+        // Same chain in another format, e.g. rgb32f for a GL that cannot sample the packed ones.
+        void convert(HdrFormat format, HdrMipChain *out, ThreadPool &pool = thread_pool()) const;
+
+        bool write(const std::string &filename) const;
+        bool read(const std::string &filename);
+
+        bool empty() const { return _levels.empty(); }
+        HdrFormat format() const { return _format; }
+        int width() const { return _levels.empty() ? 0 : _levels[0].width; }
+        int height() const { return _levels.empty() ? 0 : _levels[0].height; }
+        int nb_levels() const { return (int)_levels.size(); }
+        const level &get_level(int i) const { return _levels[i]; }
+        const void *level_data(int i) const { return payload() + _levels[i].offset; }
+        size_t payload_size() const { return _payload_size; }
+
+    private:
+
+        const unsigned char *payload() const { return _file.size() ? (const unsigned char*)_payload : _data.data(); }
+
+        HdrFormat _format = HdrFormat::rgb32f;
+        std::vector<level> _levels;
+        size_t _payload_size = 0;
+
+        // built: owned. read: mapped.
+        std::vector<unsigned char> _data;
+        MappedFile _file;
+        const char *_payload = nullptr;
+    };
+}
+
+#endif // _HDR_TEXTURE_2026_10_17_H_
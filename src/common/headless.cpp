@@ -0,0 +1,272 @@
+#include <GL/glew.h>
+#include "headless.h"
+
+#include "app.h"
+#include "gl_utils.h"
+#include "profiler.h"
+#include "imgui.h"
+#include "stb_image_write.h"
+
+#ifdef GLXP_WITH_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+#ifdef GLXP_WITH_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace glutils
+{
+
+//
+// OffscreenContext
+//
+
+OffscreenContext::~OffscreenContext()
+{
+    shutdown();
+}
+
+bool OffscreenContext::init(const std::string &backend, int major, int minor)
+{
+    shutdown();
+
+    if (backend == "egl")
+    {
+#ifdef GLXP_WITH_EGL
+        // surfaceless: no X, no wayland, no gbm device.
+        EGLDisplay display = EGL_NO_DISPLAY;
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display)
+        {
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY)
+        {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        EGLint egl_major = 0, egl_minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &egl_major, &egl_minor))
+        {
+            printf("FAILED to initialize EGL (0x%04x)\n", eglGetError());
+            return false;
+        }
+        _display = display;
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            printf("FAILED EGL has no desktop OpenGL (0x%04x)\n", eglGetError());
+            shutdown();
+            return false;
+        }
+
+        const EGLint config_attribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint nb_configs = 0;
+        eglChooseConfig(display, config_attribs, &config, 1, &nb_configs);
+
+        // no config at all is fine for a surfaceless context (EGL_KHR_no_config_context).
+        const EGLint context_attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE };
+        EGLContext context = eglCreateContext(display, nb_configs > 0 ? config : (EGLConfig)nullptr, EGL_NO_CONTEXT, context_attribs);
+        if (context == EGL_NO_CONTEXT)
+        {
+            printf("FAILED to create an OpenGL %d.%d core context with EGL (0x%04x)\n", major, minor, eglGetError());
+            shutdown();
+            return false;
+        }
+        _context = context;
+
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            printf("FAILED to make the EGL context current (0x%04x)\n", eglGetError());
+            shutdown();
+            return false;
+        }
+        return true;
+#else
+        printf("FAILED headless backend \"egl\" is not built in (GLXP_WITH_EGL)\n");
+        return false;
+#endif
+    }
+
+    if (backend == "osmesa")
+    {
+#ifdef GLXP_WITH_OSMESA
+        const int attribs[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 0,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, major,
+            OSMESA_CONTEXT_MINOR_VERSION, minor,
+            0 };
+        OSMesaContext context = OSMesaCreateContextAttribs(attribs, nullptr);
+        if (!context)
+        {
+            printf("FAILED to create an OpenGL %d.%d core context with OSMesa\n", major, minor);
+            return false;
+        }
+        _context = context;
+        _osmesa = true;
+
+        _osmesa_buffer.resize(4);
+        if (!OSMesaMakeCurrent(context, _osmesa_buffer.data(), GL_UNSIGNED_BYTE, 1, 1))
+        {
+            printf("FAILED to make the OSMesa context current\n");
+            shutdown();
+            return false;
+        }
+        return true;
+#else
+        printf("FAILED headless backend \"osmesa\" is not built in (GLXP_WITH_OSMESA)\n");
+        return false;
+#endif
+    }
+
+    printf("FAILED unknown headless backend \"%s\" (egl or osmesa)\n", backend.c_str());
+    return false;
+}
+
+void OffscreenContext::shutdown()
+{
+#ifdef GLXP_WITH_OSMESA
+    if (_osmesa && _context)
+    {
+        OSMesaDestroyContext((OSMesaContext)_context);
+    }
+#endif
+#ifdef GLXP_WITH_EGL
+    if (!_osmesa && _display)
+    {
+        eglMakeCurrent((EGLDisplay)_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (_context)
+        {
+            eglDestroyContext((EGLDisplay)_display, (EGLContext)_context);
+        }
+        eglTerminate((EGLDisplay)_display);
+    }
+#endif
+    _display = nullptr;
+    _context = nullptr;
+    _osmesa = false;
+    _osmesa_buffer.clear();
+}
+
+//
+// run_headless
+//
+
+static bool write_png(const std::string &filename, int width, int height, const std::vector<unsigned char> &rgba)
+{
+    // GL rows start at the bottom.
+    const size_t row_size = (size_t)width * 4;
+    std::vector<unsigned char> flipped(rgba.size());
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(flipped.data() + y * row_size, rgba.data() + (height - 1 - y) * row_size, row_size);
+    }
+
+    if (!stbi_write_png(filename.c_str(), width, height, 4, flipped.data(), (int)row_size))
+    {
+        printf("FAILED to write \"%s\"\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+int run_headless(App *app, const HeadlessOptions &options)
+{
+    // the shaders only need 4.5 (see glsl_for_context), all llvmpipe gives in older Mesa.
+    OffscreenContext context;
+    if (!context.init(options.backend, 4, 6))
+    {
+        printf("Falling back to OpenGL 4.5\n");
+        if (!context.init(options.backend, 4, 5))
+            return EXIT_FAILURE;
+    }
+
+    // glewInit also wants a GLX/WGL display, glewContextInit only loads the GL entry points.
+    glewExperimental = GL_TRUE;
+    GLenum err = glewContextInit();
+    if (err != GLEW_OK)
+    {
+        printf("Error initializing GLEW: %s\n", (const char*)glewGetErrorString(err));
+        return EXIT_FAILURE;
+    }
+    printf("Headless %s: %s, %s\n", options.backend.c_str(), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+    // the apps build their GUI anyway, it is just never drawn.
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2((float)options.width, (float)options.height);
+    io.IniFilename = nullptr;
+    unsigned char *font_pixels;
+    int font_width, font_height;
+    io.Fonts->GetTexDataAsRGBA32(&font_pixels, &font_width, &font_height);
+
+    app->set_headless(true);
+    if (!app->init(options.width, options.height))
+    {
+        ImGui::DestroyContext();
+        return EXIT_FAILURE;
+    }
+    glutils::check_error();
+
+    auto last_time = std::chrono::steady_clock::now();
+    int nb_ready_frames = 0;
+    while (!app->should_exit() && (options.nb_frames < 0 || nb_ready_frames < options.nb_frames))
+    {
+        auto now = std::chrono::steady_clock::now();
+        float dt = std::chrono::duration<float>(now - last_time).count();
+        last_time = now;
+
+        io.DeltaTime = dt > 0.0f ? dt : 1.0f / 60.0f;
+        ImGui::NewFrame();
+
+        glutils::profiler().begin_frame();
+        app->run(dt);
+        glutils::profiler().end_frame();
+
+        ImGui::EndFrame();
+
+        if (app->ready())
+        {
+            ++nb_ready_frames;
+        }
+    }
+
+    int exit_code = app->exit_code();
+    if (!app->should_exit() && nb_ready_frames > 0 && !options.output.empty())
+    {
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels;
+        if (read_texture_rgba8(app->output_texture(), &width, &height, &pixels) && write_png(options.output, width, height, pixels))
+        {
+            printf("Frame written to %s (%dx%d)\n", options.output.c_str(), width, height);
+        }
+        else
+        {
+            exit_code = EXIT_FAILURE;
+        }
+    }
+
+    app->shutdown();
+    ImGui::DestroyContext();
+    context.shutdown();
+    return exit_code;
+}
+
+} // namespace glutils
@@ -0,0 +1,58 @@
+#ifndef _HEADLESS_2026_10_17_H_
+#define _HEADLESS_2026_10_17_H_
+
+#include <string>
+#include <vector>
+
+class App;
+
+namespace glutils
+{
+    //
+    // GL context without a window nor a display server: EGL on the surfaceless Mesa platform,
+    // or OSMesa. Each backend is compiled in with GLXP_WITH_EGL / GLXP_WITH_OSMESA (see the
+    // cmake options). There is no default framebuffer: everything is drawn in FBOs.
+    //
+    class OffscreenContext
+    {
+    public:
+
+        OffscreenContext() = default;
+        ~OffscreenContext();
+
+        OffscreenContext(const OffscreenContext &) = delete;
+        OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+        // backend: "egl" or "osmesa". Core profile, made current.
+        bool init(const std::string &backend, int major, int minor);
+        void shutdown();
+
+    private:
+
+        void *_display = nullptr; // EGLDisplay
+        void *_context = nullptr; // EGLContext or OSMesaContext
+        bool _osmesa = false;
+        std::vector<unsigned char> _osmesa_buffer; // OSMesa wants a color buffer, even unused.
+    };
+
+    struct HeadlessOptions
+    {
+        std::string backend = "egl";
+        int width = 1280;
+        int height = 720;
+        int nb_frames = 1; // once the app is ready, the last one is written. -1: until the app exits.
+        std::string output; // .png, empty: nothing written.
+    };
+
+    //
+    // Main loop of --headless: no window, no input, no GUI drawn (but built, the apps call
+    // ImGui). A GL 4.6 context, or 4.5 where the driver has nothing newer. Renders until the
+    // app is ready plus nb_frames, or until it exits by itself, then writes the app
+    // output_texture() to options.output, read back through a PBO.
+    //
+    // Returns the process exit code.
+    //
+    int run_headless(App *app, const HeadlessOptions &options);
+}
+
+#endif // _HEADLESS_2026_10_17_H_
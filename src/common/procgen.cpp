@@ -1,6 +1,8 @@
 #include "procgen.h"
+#include "thread_pool.h"
 
-#include <map>
+#include <utility>
+#include <stdint.h>
 #include <array>
 #include <fstream>
 #include <chrono>
@@ -42,19 +44,65 @@ namespace icosahedron
     };
 }
 
-using Lookup = std::map<std::pair<index_t, index_t>, index_t>;
+static const uint64_t empty_edge_key = ~0ull;
 
-index_t vertex_for_edge(
-    Lookup& lookup,
+// Edge -> mid vertex, open addressing on the packed (min, max) vertex pair.
+// Sized once per level from the known edge count, so it never grows.
+class EdgeLookup
+{
+public:
+
+    void reset(size_t nb_edges)
+    {
+        size_t capacity = 16;
+        while (capacity < nb_edges * 2) // load factor <= 0.5
+            capacity *= 2;
+
+        _mask = capacity - 1;
+        _keys.assign(capacity, empty_edge_key);
+        _values.resize(capacity);
+    }
+
+    // returns the slot of the key, and whether it was just inserted.
+    index_t *insert(index_t first, index_t second, bool *inserted)
+    {
+        if (first > second)
+            std::swap(first, second);
+
+        uint64_t key = ((uint64_t)first << 32) | second;
+        size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & _mask;
+        for (;;)
+        {
+            if (_keys[slot] == key)
+            {
+                *inserted = false;
+                return &_values[slot];
+            }
+            if (_keys[slot] == empty_edge_key)
+            {
+                _keys[slot] = key;
+                *inserted = true;
+                return &_values[slot];
+            }
+            slot = (slot + 1) & _mask;
+        }
+    }
+
+private:
+
+    std::vector<uint64_t> _keys;
+    std::vector<index_t> _values;
+    size_t _mask = 0;
+};
+
+static index_t vertex_for_edge(
+    EdgeLookup& lookup,
     VertexList& vertices, 
     index_t first, index_t second)
 {
-    Lookup::key_type key(first, second);
-    if (key.first > key.second)
-        std::swap(key.first, key.second);
-
-    auto inserted = lookup.insert({key, (index_t)vertices.size()});
-    if (inserted.second)
+    bool inserted;
+    index_t *mid = lookup.insert(first, second, &inserted);
+    if (inserted)
     {
         const glm::vec3& edge0 = vertices[first].p;
         const glm::vec3& edge1 = vertices[second].p;
@@ -62,20 +110,25 @@ index_t vertex_for_edge(
         v.p = glm::normalize(glm::vec3(edge0) + glm::vec3(edge1));
         v.n = v.p; // meme chose, normale = position model space
         v.uv = {0.0f, 0.0f}; // TODO: long-lat conversion of pos
+        *mid = (index_t)vertices.size();
         vertices.push_back(v);
     }
 
-    return inserted.first->second;
+    return *mid;
 }
 
-TriangleList subdivide(
+// Each triangle gives 4 in dst. Closed mesh: edges = 3/2 triangles.
+static void subdivide(
     VertexList& vertices,
-    TriangleList triangles)
+    const TriangleList& triangles,
+    TriangleList& result,
+    EdgeLookup& lookup)
 {
-    Lookup lookup;
-    TriangleList result;
+    lookup.reset(triangles.size() * 3 / 2);
+    result.resize(triangles.size() * 4);
 
-    for (auto&& each : triangles)
+    triangle_t *dst = result.data();
+    for (const auto& each : triangles)
     {
         std::array<index_t, 3> mid;
         for (int edge = 0; edge < 3; ++edge)
@@ -84,16 +137,24 @@ TriangleList subdivide(
                 each.vertex_index[edge], each.vertex_index[(edge + 1) % 3]);
         }
 
-        result.push_back({each.vertex_index[0], mid[0], mid[2]});
-        result.push_back({each.vertex_index[1], mid[1], mid[0]});
-        result.push_back({each.vertex_index[2], mid[2], mid[1]});
-        result.push_back({mid[0], mid[1], mid[2]});
+        *dst++ = {each.vertex_index[0], mid[0], mid[2]};
+        *dst++ = {each.vertex_index[1], mid[1], mid[0]};
+        *dst++ = {each.vertex_index[2], mid[2], mid[1]};
+        *dst++ = {mid[0], mid[1], mid[2]};
     }
+}
 
-    return result;
+MeshInfo uvsphere_info(unsigned int subdiv_lat, unsigned int subdiv_long, float radius)
+{
+    MeshInfo info;
+    info.nb_vertices = (size_t)(2 + subdiv_long) * (2 + subdiv_lat);
+    info.nb_indices = (size_t)(1 + subdiv_long) * (1 + subdiv_lat) * 2 * 3;
+    info.bbox_min = glm::vec3(-radius);
+    info.bbox_max = glm::vec3(radius);
+    return info;
 }
 
-IndexedMesh make_uvsphere(unsigned int subdiv_lat, unsigned int subdiv_long, float radius)
+void make_uvsphere(const VertexStreams &out, index_t *indices, unsigned int subdiv_lat, unsigned int subdiv_long, float radius)
 {
     /*
 
@@ -109,88 +170,152 @@ IndexedMesh make_uvsphere(unsigned int subdiv_lat, unsigned int subdiv_long, flo
     */
     const unsigned int nb_vertices_x = 2 + subdiv_long;
     const unsigned int nb_vertices_y = 2 + subdiv_lat;
-    const unsigned int nb_vertices = nb_vertices_x * nb_vertices_y;
-    VertexList vertices(nb_vertices);
     
     const unsigned int nb_quads_x = nb_vertices_x - 1;
     const unsigned int nb_quads_y = nb_vertices_y - 1;
-    const unsigned int nb_quads = nb_quads_x * nb_quads_y;
-    const unsigned int nb_triangles = nb_quads * 2;
-    const unsigned int nb_indices = nb_triangles * 3;
-    IndexList indices(nb_indices);
 
-    for (unsigned int v = 0; v < nb_vertices_y; ++v)
+    // rows are independent, a few rows per job.
+    utils::thread_pool().parallel_for(nb_vertices_y, 8, [&](size_t begin, size_t end)
     {
-        float fv = (float)v / (float)(nb_vertices_y - 1);
-        float v_angle = fv * glm::pi<float>();
-        for (unsigned int u = 0; u < nb_vertices_x; ++u)
+        for (unsigned int v = (unsigned int)begin; v < (unsigned int)end; ++v)
         {
-            float fu = (float)u / (float)(nb_vertices_x - 1);
-            float u_angle = fu * 2 * glm::pi<float>();
+            float fv = (float)v / (float)(nb_vertices_y - 1);
+            float v_angle = fv * glm::pi<float>();
+            for (unsigned int u = 0; u < nb_vertices_x; ++u)
+            {
+                float fu = (float)u / (float)(nb_vertices_x - 1);
+                float u_angle = fu * 2 * glm::pi<float>();
 
-            float x = radius * std::fabsf(std::sin(v_angle)) * std::cos(u_angle); // [0..radius..0] * [1..0..-1..0..1]
-            float y = radius * std::cos(v_angle); // [1..0..-1]
-            float z = radius * std::fabsf(std::sin(v_angle)) * -std::sin(u_angle); // [0..radius..0] * [0..-1..0..1..0];
+                float x = radius * std::fabsf(std::sin(v_angle)) * std::cos(u_angle); // [0..radius..0] * [1..0..-1..0..1]
+                float y = radius * std::cos(v_angle); // [1..0..-1]
+                float z = radius * std::fabsf(std::sin(v_angle)) * -std::sin(u_angle); // [0..radius..0] * [0..-1..0..1..0];
 
-            const unsigned int vertex_index = v * nb_vertices_x + u;
-            vertices[vertex_index].p = glm::vec3(x,y,z);
-            vertices[vertex_index].n = glm::normalize(glm::vec3(x, y, z));
-            vertices[vertex_index].uv = glm::vec2(fu,1.0f-fv);
+                const unsigned int vertex_index = v * nb_vertices_x + u;
+                out.write(vertex_index, glm::vec3(x, y, z), glm::normalize(glm::vec3(x, y, z)), glm::vec2(fu, 1.0f - fv));
+            }
         }
-    }
+    });
 
-    for (unsigned int qy = 0; qy < nb_quads_y; ++qy)
+    utils::thread_pool().parallel_for(nb_quads_y, 8, [&](size_t begin, size_t end)
     {
-        for (unsigned int qx = 0; qx < nb_quads_x; ++qx)
+        for (unsigned int qy = (unsigned int)begin; qy < (unsigned int)end; ++qy)
         {
-            const unsigned int base_idx = 2 * 3 * (qy * nb_quads_x + qx);
-            const unsigned int idx_x0y0 = qy * nb_vertices_x + qx;
-            const unsigned int idx_x1y0 = qy * nb_vertices_x + qx + 1;
-            const unsigned int idx_x0y1 = (qy+1) * nb_vertices_x + qx;
-            const unsigned int idx_x1y1 = (qy+1) * nb_vertices_x + qx + 1;
-            indices[base_idx + 0] = idx_x0y0;
-            indices[base_idx + 1] = idx_x1y0;
-            indices[base_idx + 2] = idx_x1y1;
-            indices[base_idx + 3] = idx_x0y0;
-            indices[base_idx + 4] = idx_x1y1;
-            indices[base_idx + 5] = idx_x0y1;
+            for (unsigned int qx = 0; qx < nb_quads_x; ++qx)
+            {
+                const size_t base_idx = (size_t)2 * 3 * (qy * nb_quads_x + qx);
+                const unsigned int idx_x0y0 = qy * nb_vertices_x + qx;
+                const unsigned int idx_x1y0 = qy * nb_vertices_x + qx + 1;
+                const unsigned int idx_x0y1 = (qy+1) * nb_vertices_x + qx;
+                const unsigned int idx_x1y1 = (qy+1) * nb_vertices_x + qx + 1;
+                indices[base_idx + 0] = idx_x0y0;
+                indices[base_idx + 1] = idx_x1y0;
+                indices[base_idx + 2] = idx_x1y1;
+                indices[base_idx + 3] = idx_x0y0;
+                indices[base_idx + 4] = idx_x1y1;
+                indices[base_idx + 5] = idx_x0y1;
+            }
         }
-    }
+    });
+}
+
+IndexedMesh make_uvsphere(unsigned int subdiv_lat, unsigned int subdiv_long, float radius)
+{
+    MeshInfo info = uvsphere_info(subdiv_lat, subdiv_long, radius);
+    VertexList vertices(info.nb_vertices);
+    IndexList indices(info.nb_indices);
+
+    make_uvsphere(vertex_streams(vertices), indices.data(), subdiv_lat, subdiv_long, radius);
 
     return{ vertices, indices };
 }
 
-IndexedMesh make_icosphere(int subdivisions, float radius)
+// Subdivided unit icosahedron. Needs the positions of the previous level, so it can't write to the output directly.
+static void build_icosphere(int subdivisions, VertexList &vertices, TriangleList &triangles)
 {
-    VertexList vertices = icosahedron::vertices;
-    TriangleList triangles = icosahedron::triangles;
-
+    // level n: 20*4^n triangles, 30*4^n edges, 10*4^n+2 vertices.
+    const size_t growth = (size_t)1 << (2 * subdivisions);
+    const size_t nb_triangles = icosahedron::triangles.size() * growth;
+    const size_t nb_vertices = 10 * growth + 2;
+
+    vertices.clear();
+    vertices.reserve(nb_vertices);
+    vertices.assign(icosahedron::vertices.begin(), icosahedron::vertices.end());
+
+    // ping-pong between 2 lists, both with the final capacity.
+    TriangleList next;
+    triangles.reserve(nb_triangles);
+    next.reserve(nb_triangles);
+    triangles.assign(icosahedron::triangles.begin(), icosahedron::triangles.end());
+
+    EdgeLookup lookup;
     for (int i = 0; i < subdivisions; ++i)
     {
-        triangles = subdivide(vertices, triangles);
+        subdivide(vertices, triangles, next, lookup);
+        std::swap(triangles, next);
     }
+}
 
 #ifndef PI
 #define PI 3.14159f
 #endif
-    for (auto & vertex : vertices)
+
+static void write_icosphere(const VertexStreams &out, index_t *indices, const VertexList &vertices, const TriangleList &triangles, float radius)
+{
+    utils::thread_pool().parallel_for(vertices.size(), 4096, [&](size_t begin, size_t end)
     {
-        glm::vec3 unit = glm::normalize(vertex.p);
-        float u = (std::atan2(unit.x, std::fabsf(unit.z)) + PI) / PI * 0.5f;
-        float v = (std::acos(unit.y) + PI) / PI - 1.0f;
-        vertex.p = radius*vertex.p;
-        vertex.uv = { u, v };
-    }
+        for (size_t i = begin; i < end; ++i)
+        {
+            const vertex_t &vertex = vertices[i];
+            glm::vec3 unit = glm::normalize(vertex.p);
+            float u = (std::atan2(unit.x, std::fabsf(unit.z)) + PI) / PI * 0.5f;
+            float v = (std::acos(unit.y) + PI) / PI - 1.0f;
+            out.write(i, radius*vertex.p, vertex.n, glm::vec2(u, v));
+        }
+    });
 
-    IndexList indices;
-    indices.reserve(triangles.size()*3);
-    for (auto t : triangles)
+    utils::thread_pool().parallel_for(triangles.size(), 4096, [&](size_t begin, size_t end)
     {
-        indices.push_back(t.vertex_index[0]);
-        indices.push_back(t.vertex_index[1]);
-        indices.push_back(t.vertex_index[2]);
-    }
-    return{vertices, indices};
+        index_t *dst = indices + begin * 3;
+        for (size_t i = begin; i < end; ++i)
+        {
+            *dst++ = triangles[i].vertex_index[0];
+            *dst++ = triangles[i].vertex_index[1];
+            *dst++ = triangles[i].vertex_index[2];
+        }
+    });
+}
+
+MeshInfo icosphere_info(int subdivisions, float radius)
+{
+    const size_t growth = (size_t)1 << (2 * subdivisions);
+
+    MeshInfo info;
+    info.nb_vertices = 10 * growth + 2;
+    info.nb_indices = icosahedron::triangles.size() * growth * 3;
+    info.bbox_min = glm::vec3(-radius); // slightly conservative at low levels
+    info.bbox_max = glm::vec3(radius);
+    return info;
+}
+
+void make_icosphere(const VertexStreams &out, index_t *indices, int subdivisions, float radius)
+{
+    VertexList vertices;
+    TriangleList triangles;
+    build_icosphere(subdivisions, vertices, triangles);
+    write_icosphere(out, indices, vertices, triangles, radius);
+}
+
+IndexedMesh make_icosphere(int subdivisions, float radius)
+{
+    VertexList vertices;
+    TriangleList triangles;
+    build_icosphere(subdivisions, vertices, triangles);
+
+    // in place: each vertex only reads itself.
+    IndexList indices(triangles.size() * 3);
+    write_icosphere(vertex_streams(vertices), indices.data(), vertices, triangles, radius);
+
+    return{std::move(vertices), std::move(indices)};
 }
 
 namespace flat_cube
@@ -240,27 +365,46 @@ namespace flat_cube
     };
 }
 
-IndexedMesh make_flat_cube(float width, float height, float depth)
+static void write_indices(index_t *indices, const TriangleList &triangles)
 {
-    VertexList vertices;
-    vertices.reserve(flat_cube::vertices.size());
-    for (auto v : flat_cube::vertices)
+    for (const auto &t : triangles)
     {
-        vertex_t scaled_v = v;
-        scaled_v.p *= glm::vec3(0.5f*width, 0.5f*height, 0.5f*depth);
-        vertices.push_back(scaled_v);
+        *indices++ = t.vertex_index[0];
+        *indices++ = t.vertex_index[1];
+        *indices++ = t.vertex_index[2];
     }
-    TriangleList triangles = flat_cube::triangles;
+}
 
-    IndexList indices;
-    indices.reserve(triangles.size() * 3);
-    for (auto t : triangles)
+MeshInfo flat_cube_info(float width, float height, float depth)
+{
+    MeshInfo info;
+    info.nb_vertices = flat_cube::vertices.size();
+    info.nb_indices = flat_cube::triangles.size() * 3;
+    info.bbox_max = glm::vec3(0.5f*width, 0.5f*height, 0.5f*depth);
+    info.bbox_min = -info.bbox_max;
+    return info;
+}
+
+void make_flat_cube(const VertexStreams &out, index_t *indices, float width, float height, float depth)
+{
+    const glm::vec3 scale(0.5f*width, 0.5f*height, 0.5f*depth);
+    for (size_t i = 0; i < flat_cube::vertices.size(); ++i)
     {
-        indices.push_back(t.vertex_index[0]);
-        indices.push_back(t.vertex_index[1]);
-        indices.push_back(t.vertex_index[2]);
+        const vertex_t &v = flat_cube::vertices[i];
+        out.write(i, v.p * scale, v.n, v.uv);
     }
 
+    write_indices(indices, flat_cube::triangles);
+}
+
+IndexedMesh make_flat_cube(float width, float height, float depth)
+{
+    MeshInfo info = flat_cube_info(width, height, depth);
+    VertexList vertices(info.nb_vertices);
+    IndexList indices(info.nb_indices);
+
+    make_flat_cube(vertex_streams(vertices), indices.data(), width, height, depth);
+
     return {vertices, indices};
 }
 
@@ -291,31 +435,51 @@ namespace hexagon
     //enum { X_POS, X_NEG, Y_POS, Y_NEG, Z_POS, Z_NEG };
 }
 
-IndexedMesh make_hexagon(float width, float height, glm::vec3 normal)
+MeshInfo hexagon_info(float width, float height)
 {
-    VertexList vertices;
-    vertices.reserve(hexagon::vertices.size());
-    for (auto v : hexagon::vertices)
-    {
-        vertex_t scaled_v = v;
-        scaled_v.p *= glm::vec3(0.5f*width, 0.5f*height, 1.0f);
-        scaled_v.n = normal;
-        vertices.push_back(scaled_v);
-    }
-    TriangleList triangles = hexagon::triangles;
+    MeshInfo info;
+    info.nb_vertices = hexagon::vertices.size();
+    info.nb_indices = hexagon::triangles.size() * 3;
+    info.bbox_max = glm::vec3(0.5f*width*COS_30, 0.5f*height, 0.0f);
+    info.bbox_min = -info.bbox_max;
+    return info;
+}
 
-    IndexList indices;
-    indices.reserve(triangles.size() * 3);
-    for (auto t : triangles)
+void make_hexagon(const VertexStreams &out, index_t *indices, float width, float height, glm::vec3 normal)
+{
+    const glm::vec3 scale(0.5f*width, 0.5f*height, 1.0f);
+    for (size_t i = 0; i < hexagon::vertices.size(); ++i)
     {
-        indices.push_back(t.vertex_index[0]);
-        indices.push_back(t.vertex_index[1]);
-        indices.push_back(t.vertex_index[2]);
+        const vertex_t &v = hexagon::vertices[i];
+        out.write(i, v.p * scale, normal, v.uv);
     }
 
+    write_indices(indices, hexagon::triangles);
+}
+
+IndexedMesh make_hexagon(float width, float height, glm::vec3 normal)
+{
+    MeshInfo info = hexagon_info(width, height);
+    VertexList vertices(info.nb_vertices);
+    IndexList indices(info.nb_indices);
+
+    make_hexagon(vertex_streams(vertices), indices.data(), width, height, normal);
+
     return{vertices, indices};
 }
 
+VertexStreams vertex_streams(VertexList &vertices)
+{
+    VertexStreams streams;
+    streams.position = &vertices.data()->p.x;
+    streams.normal = &vertices.data()->n.x;
+    streams.texcoord = &vertices.data()->uv.x;
+    streams.position_stride = sizeof(vertex_t);
+    streams.normal_stride = sizeof(vertex_t);
+    streams.texcoord_stride = sizeof(vertex_t);
+    return streams;
+}
+
 //
 // IMAGE GEN
 //
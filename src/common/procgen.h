@@ -28,6 +28,52 @@ IndexedMesh make_uvsphere(unsigned int subdiv_lat=5, unsigned int subdiv_long=10
 IndexedMesh make_flat_cube(float width = 1.0f, float height = 1.0f, float depth = 1.0f);
 IndexedMesh make_hexagon(float width, float height, glm::vec3 normal = glm::vec3(0, 0, 1));
 
+//
+// Same generators, writing straight into caller memory: one strided stream per attribute.
+// stride = element size for SoA arrays, stride = sizeof(vertex) for an interleaved buffer,
+// possibly a mapped GL buffer (write only, never read back). Null streams are skipped.
+//
+struct VertexStreams
+{
+    float *position = nullptr; // 3 floats
+    float *normal = nullptr;   // 3 floats
+    float *texcoord = nullptr; // 2 floats
+    size_t position_stride = 3 * sizeof(float);
+    size_t normal_stride = 3 * sizeof(float);
+    size_t texcoord_stride = 2 * sizeof(float);
+
+    void write(size_t i, const glm::vec3 &p, const glm::vec3 &n, const glm::vec2 &uv) const
+    {
+        if (position) { float *d = (float*)((char*)position + i * position_stride); d[0] = p.x; d[1] = p.y; d[2] = p.z; }
+        if (normal)   { float *d = (float*)((char*)normal + i * normal_stride);     d[0] = n.x; d[1] = n.y; d[2] = n.z; }
+        if (texcoord) { float *d = (float*)((char*)texcoord + i * texcoord_stride); d[0] = uv.x; d[1] = uv.y; }
+    }
+};
+
+// What a generator will write, to size (or map) the destination first.
+struct MeshInfo
+{
+    size_t nb_vertices = 0;
+    size_t nb_indices = 0;
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+};
+
+MeshInfo icosphere_info(int subdivisions, float radius = 1.0f);
+MeshInfo uvsphere_info(unsigned int subdiv_lat=5, unsigned int subdiv_long=10, float radius = 1.0f);
+MeshInfo flat_cube_info(float width = 1.0f, float height = 1.0f, float depth = 1.0f);
+MeshInfo hexagon_info(float width, float height);
+
+// indices receives info.nb_indices values, the streams info.nb_vertices vertices.
+// make_uvsphere splits its rows over the thread pool.
+void make_icosphere(const VertexStreams &out, index_t *indices, int subdivisions, float radius = 1.0f);
+void make_uvsphere(const VertexStreams &out, index_t *indices, unsigned int subdiv_lat=5, unsigned int subdiv_long=10, float radius = 1.0f);
+void make_flat_cube(const VertexStreams &out, index_t *indices, float width = 1.0f, float height = 1.0f, float depth = 1.0f);
+void make_hexagon(const VertexStreams &out, index_t *indices, float width, float height, glm::vec3 normal = glm::vec3(0, 0, 1));
+
+// streams over a VertexList, for the IndexedMesh versions.
+VertexStreams vertex_streams(VertexList &vertices);
+
 struct loaded_image
 {
     uint32_t width;
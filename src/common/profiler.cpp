@@ -0,0 +1,320 @@
+#include "profiler.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace glutils
+{
+
+const int Profiler::nb_buffers;
+const int Profiler::history_size;
+
+Profiler &profiler()
+{
+    static Profiler p;
+    return p;
+}
+
+void Profiler::shutdown()
+{
+    for (auto &f : _frames)
+    {
+        if (!f.queries.empty())
+        {
+            glDeleteQueries((GLsizei)f.queries.size(), f.queries.data());
+        }
+        f = frame();
+    }
+    _stack.clear();
+    _paths.clear();
+    _in_frame = false;
+    _trace.clear();
+    _capture_frames_left = 0;
+    _capture_pending = 0;
+    _recording = false;
+    _frame_times.clear();
+}
+
+double Profiler::now_us() const
+{
+    return std::chrono::duration<double, std::micro>(clock::now() - _epoch).count();
+}
+
+void Profiler::begin_frame()
+{
+    _current = (_current + 1) % nb_buffers;
+    frame &f = _frames[_current];
+
+    // nb_buffers frames ago, most likely done on the gpu by now.
+    if (f.pending)
+    {
+        resolve(f);
+    }
+
+    _in_frame = enabled;
+    if (!_in_frame)
+        return;
+
+    f.events.clear();
+    f.nb_queries = 0;
+    f.recorded = _recording;
+    if (_capture_frames_left > 0)
+    {
+        f.captured = true;
+        --_capture_frames_left;
+        ++_capture_pending;
+    }
+
+    // puts the gpu timestamps on the cpu timeline, for the traces.
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    f.gpu_to_cpu = now_us() - gpu_now / 1000.0;
+
+    push("frame");
+}
+
+void Profiler::end_frame()
+{
+    if (!_in_frame)
+        return;
+
+    while (!_stack.empty())
+    {
+        pop();
+    }
+    _frames[_current].pending = true;
+    _in_frame = false;
+}
+
+void Profiler::push(const char *name)
+{
+    if (!_in_frame)
+        return;
+
+    frame &f = _frames[_current];
+    if (f.nb_queries + 2 > (int)f.queries.size())
+    {
+        const size_t first = f.queries.size();
+        f.queries.resize(std::max<size_t>(first * 2, 32));
+        glCreateQueries(GL_TIMESTAMP, (GLsizei)(f.queries.size() - first), f.queries.data() + first);
+    }
+
+    std::string path = _paths.empty() ? name : _paths.back() + "/" + name;
+    const int depth = (int)_stack.size();
+
+    event e;
+    e.name = name;
+    e.depth = depth;
+    e.stat = find_stat(path, depth);
+    e.query = f.nb_queries;
+    f.nb_queries += 2;
+
+    glQueryCounter(f.queries[e.query], GL_TIMESTAMP);
+    e.cpu_begin = now_us();
+    e.cpu_end = e.cpu_begin;
+
+    _stack.push_back((int)f.events.size());
+    _paths.push_back(std::move(path));
+    f.events.push_back(e);
+}
+
+void Profiler::pop()
+{
+    if (!_in_frame || _stack.empty())
+        return;
+
+    frame &f = _frames[_current];
+    event &e = f.events[_stack.back()];
+    e.cpu_end = now_us();
+    glQueryCounter(f.queries[e.query + 1], GL_TIMESTAMP);
+
+    _stack.pop_back();
+    _paths.pop_back();
+}
+
+int Profiler::find_stat(const std::string &path, int depth)
+{
+    auto it = _stat_index.find(path);
+    if (it != _stat_index.end())
+        return it->second;
+
+    const int index = (int)_stats.size();
+    _stats.emplace_back();
+    _stats.back().name = path.substr(path.find_last_of('/') + 1);
+    _stats.back().depth = depth;
+    _stat_index[path] = index;
+    return index;
+}
+
+void Profiler::resolve(frame &f)
+{
+    _last_order.clear();
+    for (const auto &e : f.events)
+    {
+        GLuint64 gpu_begin = 0, gpu_end = 0;
+        glGetQueryObjectui64v(f.queries[e.query], GL_QUERY_RESULT, &gpu_begin);
+        glGetQueryObjectui64v(f.queries[e.query + 1], GL_QUERY_RESULT, &gpu_end);
+        const double gpu_us = gpu_end > gpu_begin ? (gpu_end - gpu_begin) / 1000.0 : 0.0;
+
+        stat &s = _stats[e.stat];
+        s.cpu_ms[s.next] = (float)((e.cpu_end - e.cpu_begin) / 1000.0);
+        s.gpu_ms[s.next] = (float)(gpu_us / 1000.0);
+        s.next = (s.next + 1) % history_size;
+        s.nb_samples = std::min(s.nb_samples + 1, history_size);
+        _last_order.push_back(e.stat);
+
+        if (f.recorded && e.depth == 0)
+        {
+            _frame_times.push_back({ (e.cpu_end - e.cpu_begin) / 1000.0, gpu_us / 1000.0 });
+        }
+
+        if (f.captured)
+        {
+            _trace.push_back({ e.name, 0, e.cpu_begin, e.cpu_end - e.cpu_begin });
+            _trace.push_back({ e.name, 1, gpu_begin / 1000.0 + f.gpu_to_cpu, gpu_us });
+        }
+    }
+    f.pending = false;
+
+    if (f.captured)
+    {
+        f.captured = false;
+        if (--_capture_pending == 0 && _capture_frames_left == 0)
+        {
+            write_trace();
+            _trace.clear();
+        }
+    }
+}
+
+void Profiler::flush()
+{
+    // oldest first.
+    for (int i = 1; i <= nb_buffers; ++i)
+    {
+        frame &f = _frames[(_current + i) % nb_buffers];
+        if (f.pending)
+        {
+            resolve(f);
+        }
+    }
+}
+
+void Profiler::capture_trace(int nb_frames, const std::string &filename)
+{
+    if (capturing() || nb_frames <= 0)
+        return;
+
+    _trace.clear();
+    _trace_filename = filename;
+    _capture_frames_left = nb_frames;
+}
+
+bool Profiler::write_trace() const
+{
+    FILE *file = fopen(_trace_filename.c_str(), "wb");
+    if (!file)
+    {
+        printf("FAILED to write the trace \"%s\"\n", _trace_filename.c_str());
+        return false;
+    }
+
+    // from the first event, the viewers do not like large timestamps.
+    double origin = 0.0;
+    if (!_trace.empty())
+    {
+        origin = _trace[0].begin;
+        for (const auto &t : _trace)
+            origin = std::min(origin, t.begin);
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (const auto &t : _trace)
+    {
+        // the names are identifiers, nothing to escape.
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            t.name, t.track == 0 ? "cpu" : "gpu", t.track + 1, t.begin - origin, t.duration);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Profiler: %zu events written to %s\n", _trace.size(), _trace_filename.c_str());
+    return true;
+}
+
+//
+// OVERLAY
+//
+
+static void summarize(const float *samples, int nb_samples, float *min, float *avg, float *p99)
+{
+    float sorted[Profiler::history_size];
+    std::copy(samples, samples + nb_samples, sorted);
+    std::sort(sorted, sorted + nb_samples);
+
+    float sum = 0.0f;
+    for (int i = 0; i < nb_samples; ++i)
+        sum += sorted[i];
+
+    *min = sorted[0];
+    *avg = sum / nb_samples;
+    *p99 = sorted[std::min(nb_samples - 1, (nb_samples * 99 + 99) / 100 - 1)];
+}
+
+void Profiler::draw_overlay()
+{
+    if (!ImGui::Begin("Profiler"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Enabled", &enabled);
+    ImGui::SameLine();
+    if (capturing())
+    {
+        ImGui::Text("capturing...");
+    }
+    else if (ImGui::Button("Save Chrome trace (60 frames)"))
+    {
+        capture_trace(60, "profile_trace.json");
+    }
+
+    ImGui::Text("last %d frames, ms", history_size);
+    ImGui::Columns(7, "profiler_columns");
+    const char *headers[] = { "scope", "gpu avg", "gpu min", "gpu p99", "cpu avg", "cpu min", "cpu p99" };
+    for (const char *h : headers)
+    {
+        ImGui::Text("%s", h);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+
+    for (int index : _last_order)
+    {
+        const stat &s = _stats[index];
+        if (s.nb_samples == 0)
+            continue;
+
+        float gpu_min, gpu_avg, gpu_p99, cpu_min, cpu_avg, cpu_p99;
+        summarize(s.gpu_ms, s.nb_samples, &gpu_min, &gpu_avg, &gpu_p99);
+        summarize(s.cpu_ms, s.nb_samples, &cpu_min, &cpu_avg, &cpu_p99);
+
+        ImGui::Text("%*s%s", s.depth * 2, "", s.name.c_str()); ImGui::NextColumn();
+        ImGui::Text("%.3f", gpu_avg); ImGui::NextColumn();
+        ImGui::Text("%.3f", gpu_min); ImGui::NextColumn();
+        ImGui::Text("%.3f", gpu_p99); ImGui::NextColumn();
+        ImGui::Text("%.3f", cpu_avg); ImGui::NextColumn();
+        ImGui::Text("%.3f", cpu_min); ImGui::NextColumn();
+        ImGui::Text("%.3f", cpu_p99); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
+
+} // namespace glutils
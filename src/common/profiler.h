@@ -0,0 +1,154 @@
+#ifndef _PROFILER_2026_10_17_H_
+#define _PROFILER_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace glutils
+{
+    //
+    // Frame profiler: nested scopes timed on the cpu (steady clock) and on the gpu
+    // (GL_TIMESTAMP queries). The queries of a frame are read nb_buffers frames later,
+    // just before they are reused, so reading them does not stall the pipeline.
+    //
+    // Each scope keeps its last history_size timings, shown with min/avg/p99 by
+    // draw_overlay(). A few frames can also be captured as a Chrome trace (chrome://tracing
+    // or ui.perfetto.dev), with one track for the cpu and one for the gpu.
+    //
+    // GL thread only.
+    //
+    class Profiler
+    {
+    public:
+
+        static const int nb_buffers = 2;
+        static const int history_size = 256;
+
+        Profiler() = default;
+        Profiler(const Profiler &) = delete;
+        Profiler &operator=(const Profiler &) = delete;
+
+        void shutdown();
+
+        void begin_frame(); // opens the "frame" scope.
+        void end_frame();
+
+        // `name` must outlive the frame, string literals are fine.
+        void push(const char *name);
+        void pop();
+
+        // ImGui window with a line per scope.
+        void draw_overlay();
+
+        // Captures the next nb_frames frames, and writes them to `filename` once resolved.
+        void capture_trace(int nb_frames, const std::string &filename);
+        bool capturing() const { return _capture_frames_left > 0 || _capture_pending > 0; }
+
+        // Durations of the "frame" scope of every frame begun while recording, once resolved.
+        struct frame_time
+        {
+            double cpu_ms;
+            double gpu_ms;
+        };
+        void record_frame_times(bool record) { _recording = record; }
+        const std::vector<frame_time> &frame_times() const { return _frame_times; }
+        void clear_frame_times() { _frame_times.clear(); }
+
+        // Resolves the frames still pending, waiting for the gpu.
+        void flush();
+
+        bool enabled = true;
+
+    private:
+
+        using clock = std::chrono::steady_clock;
+
+        struct event
+        {
+            const char *name;
+            int depth;
+            int stat; // index in _stats.
+            double cpu_begin; // us, from _epoch.
+            double cpu_end;
+            int query; // begin in queries[query], end in queries[query + 1].
+        };
+
+        struct frame
+        {
+            std::vector<event> events;
+            std::vector<GLuint> queries; // grows, never shrinks.
+            int nb_queries = 0;
+            double gpu_to_cpu = 0.0; // us, added to the gpu timestamps.
+            bool pending = false;
+            bool captured = false;
+            bool recorded = false;
+        };
+
+        struct stat
+        {
+            std::string name;
+            int depth = 0;
+            float cpu_ms[history_size] = {};
+            float gpu_ms[history_size] = {};
+            int nb_samples = 0;
+            int next = 0;
+        };
+
+        struct trace_event
+        {
+            const char *name;
+            int track; // 0: cpu, 1: gpu.
+            double begin; // us, from _epoch.
+            double duration;
+        };
+
+        double now_us() const;
+        void resolve(frame &f);
+        int find_stat(const std::string &path, int depth);
+        bool write_trace() const;
+
+        clock::time_point _epoch = clock::now();
+        frame _frames[nb_buffers];
+        int _current = 0;
+        bool _in_frame = false;
+        std::vector<int> _stack; // open events of the current frame.
+        std::vector<std::string> _paths; // of the open events, "frame/hdr/scene".
+
+        std::vector<stat> _stats;
+        std::map<std::string, int> _stat_index;
+        std::vector<int> _last_order; // stats of the last resolved frame, in order.
+
+        std::vector<trace_event> _trace;
+        std::string _trace_filename;
+        int _capture_frames_left = 0;
+        int _capture_pending = 0; // captured frames not resolved yet.
+
+        bool _recording = false;
+        std::vector<frame_time> _frame_times;
+    };
+
+    // The app's profiler, like utils::thread_pool().
+    Profiler &profiler();
+
+    // push() in the constructor, pop() in the destructor.
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const char *name, Profiler &p = profiler()) : _profiler(p) { _profiler.push(name); }
+        ~ProfileScope() { _profiler.pop(); }
+
+        ProfileScope(const ProfileScope &) = delete;
+        ProfileScope &operator=(const ProfileScope &) = delete;
+
+    private:
+        Profiler &_profiler;
+    };
+}
+
+#endif // _PROFILER_2026_10_17_H_
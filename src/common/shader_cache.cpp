@@ -0,0 +1,479 @@
+#include "shader_cache.h"
+#include "utils.h"
+#include "gl_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+namespace glutils
+{
+
+// bump when the file layout or the way the sources are put together changes.
+static const uint64_t shader_cache_version = 1;
+static const char program_binary_magic[8] = { 'G', 'L', 'X', 'P', 'P', 'R', 'O', 'G' };
+
+struct program_binary_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t binary_format; // of glGetProgramBinary.
+    uint64_t key;
+    uint64_t size; // of the binary, right after the header.
+};
+
+static void print_shader_log(GLuint shader, const std::string &filename)
+{
+    int log_size = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_size);
+    if (log_size > 1)
+    {
+        std::vector<char> log(log_size);
+        glGetShaderInfoLog(shader, log_size, &log_size, log.data());
+        printf("Compile %s: %s\n", filename.c_str(), log.data());
+    }
+}
+
+static void print_program_log(GLuint program)
+{
+    int log_size = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
+    if (log_size > 1)
+    {
+        std::vector<char> log(log_size);
+        glGetProgramInfoLog(program, log_size, &log_size, log.data());
+        printf("Link: %s\n", log.data());
+    }
+}
+
+ShaderCache::~ShaderCache()
+{
+    shutdown();
+}
+
+bool ShaderCache::init(const std::string &directory)
+{
+    _directory.clear();
+    _binary_formats.clear();
+
+    // same enums for both. 0xFFFFFFFF: as many compiler threads as the driver likes.
+    _parallel = false;
+    if (GLEW_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        _parallel = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        _parallel = true;
+    }
+
+    // a binary is only valid for the driver that made it.
+    _driver_hash = utils::hash_bytes(&shader_cache_version, sizeof(shader_cache_version));
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : names)
+    {
+        const char *str = (const char*)glGetString(name);
+        if (str)
+            _driver_hash = utils::hash_bytes(str, strlen(str) + 1, _driver_hash);
+    }
+
+    if (directory.empty())
+        return true;
+
+    GLint nb_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nb_formats);
+    if (nb_formats <= 0)
+    {
+        printf("No program binary format here, shader cache disabled\n");
+        return false;
+    }
+    _binary_formats.resize(nb_formats);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, _binary_formats.data());
+
+    if (!utils::make_directory(directory))
+    {
+        printf("FAILED to create the shader cache directory \"%s\", cache disabled\n", directory.c_str());
+        return false;
+    }
+
+    _directory = directory;
+    if (_directory.back() != '/' && _directory.back() != '\\')
+    {
+        _directory += '/';
+    }
+    return true;
+}
+
+bool ShaderCache::read_sources(const std::vector<stage> &stages, const std::string &defines, std::vector<source> *sources, uint64_t *key) const
+{
+    sources->clear();
+    *key = _driver_hash;
+    for (const auto &s : stages)
+    {
+        auto content = utils::read_file_content(s.filename);
+        if (content.empty())
+        {
+            printf("FAILED to read \"%s\"\n", s.filename.c_str());
+            return false;
+        }
+
+        // the defines go right after the #version line.
+        source src = { s.type, s.filename, glsl_for_context(content.data(), content.size()) };
+        const size_t version = src.text.find("#version");
+        const size_t eol = src.text.find('\n', version == std::string::npos ? 0 : version);
+        src.text.insert(eol == std::string::npos ? src.text.size() : eol + 1, defines);
+
+        *key = utils::hash_bytes(&src.type, sizeof(src.type), *key);
+        *key = utils::hash_bytes(src.text.data(), src.text.size(), *key);
+        sources->push_back(std::move(src));
+    }
+    return true;
+}
+
+int ShaderCache::request(const std::vector<stage> &stages, const std::string &defines)
+{
+    entry e;
+    if (!read_sources(stages, defines, &e.sources, &e.key))
+        return -1;
+    e.stages = stages;
+    e.defines = defines;
+
+    _entries.push_back(std::move(e));
+    return (int)_entries.size() - 1;
+}
+
+GLuint ShaderCache::program(int id) const
+{
+    if (id < 0 || id >= (int)_entries.size())
+        return 0;
+    return _entries[id].program;
+}
+
+std::vector<std::string> ShaderCache::files() const
+{
+    std::vector<std::string> names;
+    for (const auto &e : _entries)
+    {
+        for (const auto &s : e.stages)
+        {
+            if (std::find(names.begin(), names.end(), s.filename) == names.end())
+                names.push_back(s.filename);
+        }
+    }
+    return names;
+}
+
+std::string ShaderCache::entry_path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.glprog", (unsigned long long)key);
+    return _directory + name;
+}
+
+GLuint ShaderCache::load_binary(uint64_t key) const
+{
+    utils::MappedFile file;
+    if (!file.open(entry_path(key)))
+        return 0;
+
+    program_binary_header header;
+    if (file.size() < sizeof(header))
+        return 0;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, program_binary_magic, sizeof(header.magic)) != 0
+        || header.version != shader_cache_version
+        || header.key != key
+        || header.size != file.size() - sizeof(header)
+        || std::find(_binary_formats.begin(), _binary_formats.end(), (GLint)header.binary_format) == _binary_formats.end())
+        return 0;
+
+    // the driver may still refuse it, e.g. after an update that kept the version string.
+    GLuint prog_id = glCreateProgram();
+    glProgramBinary(prog_id, header.binary_format, file.data() + sizeof(header), (GLsizei)header.size);
+    GLint status = GL_FALSE;
+    glGetProgramiv(prog_id, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        glDeleteProgram(prog_id);
+        return 0;
+    }
+    return prog_id;
+}
+
+void ShaderCache::write_binary(GLuint program, uint64_t key) const
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    program_binary_header header = {};
+    memcpy(header.magic, program_binary_magic, sizeof(header.magic));
+    header.version = shader_cache_version;
+    header.binary_format = format;
+    header.key = key;
+    header.size = (uint64_t)length;
+
+    // written aside then renamed, so an interrupted write never looks like a valid file.
+    const std::string path = entry_path(key);
+    const std::string tmp_path = path + ".tmp";
+    bool ok;
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.write(binary.data(), length);
+        ok = ofs.good();
+    }
+
+    remove(path.c_str());
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        printf("Shader cache: could NOT write %s\n", path.c_str());
+    }
+}
+
+ShaderCache::job ShaderCache::issue(int id, std::vector<source> sources, uint64_t key) const
+{
+    job j;
+    j.id = id;
+    j.key = key;
+    j.sources = std::move(sources);
+    j.program = glCreateProgram();
+    for (const auto &s : j.sources)
+    {
+        GLuint shader_id = glCreateShader(s.type);
+        const char *text = s.text.data();
+        const GLint length = (GLint)s.text.size();
+        glShaderSource(shader_id, 1, &text, &length);
+        glCompileShader(shader_id);
+        glAttachShader(j.program, shader_id);
+        j.shaders.push_back(shader_id);
+    }
+    if (enabled())
+    {
+        glProgramParameteri(j.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(j.program);
+    return j;
+}
+
+bool ShaderCache::ready(const job &j) const
+{
+    if (!_parallel)
+        return true; // the status queries wait.
+
+    GLint done = GL_FALSE;
+    glGetProgramiv(j.program, GL_COMPLETION_STATUS_KHR, &done); // same value for ARB.
+    return done != GL_FALSE;
+}
+
+bool ShaderCache::finish(job &j)
+{
+    GLint status = GL_FALSE;
+    glGetProgramiv(j.program, GL_LINK_STATUS, &status);
+    if (status != GL_FALSE)
+    {
+        if (enabled())
+        {
+            write_binary(j.program, j.key);
+        }
+    }
+    else
+    {
+        // the compile logs say more than the link one.
+        for (size_t i = 0; i < j.sources.size(); ++i)
+        {
+            print_shader_log(j.shaders[i], j.sources[i].filename);
+        }
+        print_program_log(j.program);
+        std::string names;
+        for (const auto &src : j.sources)
+        {
+            names += (names.empty() ? "" : " + ") + src.filename;
+        }
+        printf("FAILED to build %s\n", names.c_str());
+        ++_nb_failed;
+    }
+
+    for (GLuint shader_id : j.shaders)
+    {
+        glDetachShader(j.program, shader_id);
+        glDeleteShader(shader_id);
+    }
+    j.shaders.clear();
+    j.sources.clear();
+
+    if (status == GL_FALSE)
+    {
+        glDeleteProgram(j.program);
+        j.program = 0;
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::discard(job &j) const
+{
+    for (GLuint shader_id : j.shaders)
+    {
+        glDeleteShader(shader_id);
+    }
+    glDeleteProgram(j.program);
+    j = job();
+}
+
+bool ShaderCache::build()
+{
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // the cached binaries first, the rest is compiled.
+    std::vector<job> jobs;
+    for (int id = 0; id < (int)_entries.size(); ++id)
+    {
+        entry &e = _entries[id];
+        if (e.built)
+            continue;
+
+        e.built = true;
+        e.program = enabled() ? load_binary(e.key) : 0;
+        if (e.program)
+        {
+            ++_nb_loaded;
+            e.sources.clear();
+            continue;
+        }
+
+        // every compile and link is issued before the first status query: a query waits for
+        // its own program only, the others keep building meanwhile.
+        jobs.push_back(issue(id, std::move(e.sources), e.key));
+        e.sources.clear();
+    }
+
+    bool ok = true;
+    for (auto &j : jobs)
+    {
+        if (finish(j))
+        {
+            ++_nb_compiled;
+        }
+        else
+        {
+            ok = false;
+        }
+        _entries[j.id].program = j.program;
+    }
+
+    _build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    return ok;
+}
+
+int ShaderCache::reload(const std::vector<std::string> &changed_files)
+{
+    int nb_reloads = 0;
+    for (int id = 0; id < (int)_entries.size(); ++id)
+    {
+        entry &e = _entries[id];
+        bool edited = false;
+        for (const auto &s : e.stages)
+        {
+            edited = edited || std::find(changed_files.begin(), changed_files.end(), s.filename) != changed_files.end();
+        }
+        if (!e.built || !edited)
+            continue;
+
+        // unreadable: still being written, the end of the write comes as another change.
+        std::vector<source> sources;
+        uint64_t key;
+        if (!read_sources(e.stages, e.defines, &sources, &key))
+            continue;
+
+        // an older edit still compiling is replaced, or kept if saved again as is. First: an
+        // edit reverted before its compile is done must not be swapped in later.
+        auto pending = std::find_if(_reloads.begin(), _reloads.end(), [id](const job &j) { return j.id == id; });
+        if (pending != _reloads.end())
+        {
+            if (pending->key == key)
+                continue;
+            discard(*pending);
+            _reloads.erase(pending);
+        }
+
+        if (key == e.key && e.program)
+            continue; // saved without a change, or reverted.
+
+        // back to a version built before: no compile.
+        GLuint prog_id = enabled() ? load_binary(key) : 0;
+        if (prog_id)
+        {
+            glDeleteProgram(e.program);
+            e.program = prog_id;
+            e.key = key;
+            _swapped.push_back(id);
+        }
+        else
+        {
+            _reloads.push_back(issue(id, std::move(sources), key));
+        }
+        ++nb_reloads;
+    }
+    return nb_reloads;
+}
+
+std::vector<int> ShaderCache::poll_reloads()
+{
+    std::vector<int> swapped;
+    swapped.swap(_swapped);
+
+    for (auto it = _reloads.begin(); it != _reloads.end(); )
+    {
+        if (!ready(*it))
+        {
+            ++it;
+            continue;
+        }
+
+        entry &e = _entries[it->id];
+        if (finish(*it))
+        {
+            glDeleteProgram(e.program);
+            e.program = it->program;
+            e.key = it->key;
+            swapped.push_back(it->id);
+        }
+        else
+        {
+            printf("Keeping the previous program\n");
+        }
+        it = _reloads.erase(it);
+    }
+
+    _nb_reloaded += (int)swapped.size();
+    return swapped;
+}
+
+void ShaderCache::shutdown()
+{
+    for (auto &j : _reloads)
+    {
+        discard(j);
+    }
+    _reloads.clear();
+    _swapped.clear();
+
+    for (auto &e : _entries)
+    {
+        glDeleteProgram(e.program);
+    }
+    _entries.clear();
+}
+
+} // namespace glutils
@@ -0,0 +1,136 @@
+#ifndef _SHADER_CACHE_2026_10_17_H_
+#define _SHADER_CACHE_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace glutils
+{
+    //
+    // Programs built from GLSL files and a set of #defines (a permutation), with their linked
+    // binaries kept in a directory (glGetProgramBinary). An entry is a .glprog file named after
+    // the hash of the sources, the defines and the GL vendor, renderer and version: editing a
+    // shader or updating the driver makes a new one. A binary the driver rejects is rebuilt.
+    //
+    // request() only reads the sources. build() loads the cached binaries, then issues every
+    // missing compile and link before it asks for any status, so the driver builds them side
+    // by side: on its own threads with GL_KHR_parallel_shader_compile (or the ARB one).
+    //
+    // reload() rebuilds the programs of edited files while the old ones keep being used, and
+    // poll_reloads() swaps in those that are done. With the parallel compile extension the
+    // frame never waits for the compiler. A program that fails keeps the previous one.
+    //
+    // GL thread only. The programs belong to the cache: look them up by id after a reload.
+    //
+    class ShaderCache
+    {
+    public:
+
+        struct stage
+        {
+            GLenum type; // GL_VERTEX_SHADER...
+            std::string filename;
+        };
+
+        ShaderCache() = default;
+        ~ShaderCache();
+
+        ShaderCache(const ShaderCache &) = delete;
+        ShaderCache &operator=(const ShaderCache &) = delete;
+
+        // Needs the context. Empty directory: no binaries, every program is compiled.
+        bool init(const std::string &directory);
+        bool enabled() const { return !_directory.empty(); }
+        bool parallel() const { return _parallel; }
+
+        // defines: lines inserted right after the #version line of each stage, e.g.
+        // "#define VIEW 2\n". Returns the id for program(), -1 if a source cannot be read.
+        int request(const std::vector<stage> &stages, const std::string &defines = std::string());
+
+        // Builds every pending request. False if one failed, its program() is 0.
+        bool build();
+
+        // 0 until built, or if it failed.
+        GLuint program(int id) const;
+        int nb_programs() const { return (int)_entries.size(); }
+
+        // Every source file of the requests, once.
+        std::vector<std::string> files() const;
+
+        // Starts rebuilding the programs that use these files, as named in request().
+        // Returns how many.
+        int reload(const std::vector<std::string> &changed_files);
+
+        // The ids of the programs swapped since the last call. Does not wait.
+        std::vector<int> poll_reloads();
+        bool reloading() const { return !_reloads.empty(); }
+
+        // Deletes every program.
+        void shutdown();
+
+        // stats
+        int nb_loaded() const { return _nb_loaded; } // from the binaries.
+        int nb_compiled() const { return _nb_compiled; }
+        int nb_failed() const { return _nb_failed; }
+        int nb_reloaded() const { return _nb_reloaded; }
+        double build_ms() const { return _build_ms; } // all the build() calls.
+
+    private:
+
+        struct source
+        {
+            GLenum type;
+            std::string filename;
+            std::string text; // with the defines.
+        };
+
+        struct entry
+        {
+            std::vector<stage> stages;
+            std::string defines;
+            std::vector<source> sources; // until built.
+            uint64_t key = 0;
+            GLuint program = 0;
+            bool built = false;
+        };
+
+        // a compile and link in flight.
+        struct job
+        {
+            int id = -1; // entry
+            uint64_t key = 0;
+            GLuint program = 0;
+            std::vector<source> sources;
+            std::vector<GLuint> shaders;
+        };
+
+        bool read_sources(const std::vector<stage> &stages, const std::string &defines, std::vector<source> *sources, uint64_t *key) const;
+        job issue(int id, std::vector<source> sources, uint64_t key) const;
+        bool ready(const job &j) const;
+        bool finish(job &j); // false: failed, the program is deleted.
+        void discard(job &j) const;
+
+        std::string entry_path(uint64_t key) const;
+        GLuint load_binary(uint64_t key) const;
+        void write_binary(GLuint program, uint64_t key) const;
+
+        std::string _directory;
+        std::vector<GLint> _binary_formats;
+        uint64_t _driver_hash = 0;
+        bool _parallel = false;
+        std::vector<entry> _entries;
+        std::vector<job> _reloads;
+        std::vector<int> _swapped; // by reload(), from the binaries.
+        int _nb_loaded = 0;
+        int _nb_compiled = 0;
+        int _nb_failed = 0;
+        int _nb_reloaded = 0;
+        double _build_ms = 0.0;
+    };
+}
+
+#endif // _SHADER_CACHE_2026_10_17_H_
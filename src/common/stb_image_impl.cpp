@@ -1,4 +1,6 @@
+#ifdef _MSC_VER
 #define STBI_MSC_SECURE_CRT
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
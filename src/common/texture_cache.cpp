@@ -0,0 +1,85 @@
+#include "texture_cache.h"
+
+#include <stdio.h>
+
+namespace utils
+{
+
+// bump when the decode, the filtering or the encoding changes: old entries are not read anymore.
+static const uint64_t texture_cache_version = 1;
+
+bool TextureCache::init(const std::string &directory)
+{
+    _directory.clear();
+    if (directory.empty())
+        return true;
+
+    if (!make_directory(directory))
+    {
+        printf("FAILED to create the texture cache directory \"%s\", cache disabled\n", directory.c_str());
+        return false;
+    }
+
+    _directory = directory;
+    if (_directory.back() != '/' && _directory.back() != '\\')
+    {
+        _directory += '/';
+    }
+    return true;
+}
+
+std::string TextureCache::entry_path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.hdrmips", (unsigned long long)key);
+    return _directory + name;
+}
+
+bool TextureCache::load_hdr(const std::string &source_path, HdrFormat format, int max_levels, HdrMipChain *chain, ThreadPool &pool)
+{
+    std::string path;
+    if (enabled())
+    {
+        // the content, not the name or the date: hashing is much cheaper than decoding.
+        MappedFile source;
+        if (!source.open(source_path))
+        {
+            printf("FAILED to open \"%s\"\n", source_path.c_str());
+            return false;
+        }
+
+        const uint32_t params[2] = { (uint32_t)format, (uint32_t)max_levels };
+        uint64_t key = hash_bytes(&texture_cache_version, sizeof(texture_cache_version));
+        key = hash_bytes(params, sizeof(params), key);
+        key = hash_bytes(source.data(), source.size(), key);
+        path = entry_path(key);
+
+        uint64_t size, mtime;
+        if (file_info(path, &size, &mtime) && chain->read(path))
+        {
+            uint64_t saved = 0;
+            for (int i = 0; i < chain->nb_levels(); ++i)
+            {
+                saved += (uint64_t)chain->get_level(i).width * chain->get_level(i).height * hdr_texel_size(HdrFormat::rgb32f);
+            }
+            ++_nb_hits;
+            _bytes_saved += saved;
+            return true;
+        }
+        ++_nb_misses;
+    }
+
+    ImageHdr image;
+    if (!decode_image_hdr(source_path, &image))
+        return false;
+
+    chain->build(image, format, max_levels, pool);
+
+    if (!path.empty() && !chain->write(path))
+    {
+        printf("Texture cache: could NOT write %s\n", path.c_str());
+    }
+    return true;
+}
+
+} // namespace utils
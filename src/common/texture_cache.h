@@ -0,0 +1,49 @@
+#ifndef _TEXTURE_CACHE_2026_10_17_H_
+#define _TEXTURE_CACHE_2026_10_17_H_
+
+#include "hdr_texture.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace utils
+{
+    //
+    // Directory of preconverted HDR textures. An entry is the mip chain of a source image
+    // in one format, as a .hdrmips file named after the hash of the source content, the
+    // format and the number of levels. A hit maps the file: no decode, no mips, no encoding.
+    // Copying or touching the source keeps its entry, editing it makes a new one.
+    //
+    // Thread safe, the loads can run on several workers.
+    //
+    class TextureCache
+    {
+    public:
+
+        // empty directory: disabled, every load decodes its source.
+        bool init(const std::string &directory);
+        bool enabled() const { return !_directory.empty(); }
+
+        // From the cache, or decoded, mipped, encoded and then added to it.
+        bool load_hdr(const std::string &source_path, HdrFormat format, int max_levels, HdrMipChain *chain, ThreadPool &pool = thread_pool());
+
+        std::string entry_path(uint64_t key) const;
+
+        // stats
+        size_t nb_hits() const { return _nb_hits; }
+        size_t nb_misses() const { return _nb_misses; }
+        uint64_t bytes_saved() const { return _bytes_saved; } // float texels of the hits, not decoded nor filtered.
+
+    private:
+
+        std::string _directory;
+        std::atomic<size_t> _nb_hits{ 0 };
+        std::atomic<size_t> _nb_misses{ 0 };
+        std::atomic<uint64_t> _bytes_saved{ 0 };
+    };
+}
+
+#endif // _TEXTURE_CACHE_2026_10_17_H_
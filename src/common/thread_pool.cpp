@@ -0,0 +1,147 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace utils
+{
+
+ThreadPool::ThreadPool(unsigned int nb_threads)
+{
+    if (nb_threads == 0)
+    {
+        unsigned int hw = std::thread::hardware_concurrency();
+        nb_threads = (hw > 1) ? hw - 1 : 1;
+    }
+
+    _threads.reserve(nb_threads);
+    for (unsigned int i = 0; i < nb_threads; ++i)
+    {
+        _threads.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv_jobs.notify_all();
+
+    for (auto &t : _threads)
+    {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _cv_jobs.notify_one();
+}
+
+void ThreadPool::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv_idle.wait(lock, [this] { return _jobs.empty() && _nb_running == 0; });
+}
+
+void ThreadPool::worker_loop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv_jobs.wait(lock, [this] { return _stop || !_jobs.empty(); });
+            if (_stop && _jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+            ++_nb_running;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_nb_running;
+            if (_jobs.empty() && _nb_running == 0)
+            {
+                _cv_idle.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &f)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    const size_t nb_chunks = (count + grain - 1) / grain;
+    if (nb_chunks == 1 || _threads.empty())
+    {
+        f(0, count);
+        return;
+    }
+
+    // Helpers may start after the last chunk is done (or after we returned), so the counters
+    // are shared. Such late helpers find no chunk left and never touch f.
+    struct shared_state
+    {
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<size_t> done_chunks{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<shared_state>();
+    const auto *func = &f;
+
+    auto work = [state, func, count, grain, nb_chunks]()
+    {
+        size_t chunk;
+        while ((chunk = state->next_chunk.fetch_add(1)) < nb_chunks)
+        {
+            size_t begin = chunk * grain;
+            size_t end = std::min(begin + grain, count);
+            (*func)(begin, end);
+
+            if (state->done_chunks.fetch_add(1) + 1 == nb_chunks)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cv.notify_all();
+            }
+        }
+    };
+
+    // the calling thread takes its share too, so it never just sits there
+    size_t nb_helpers = std::min<size_t>(_threads.size(), nb_chunks - 1);
+    for (size_t i = 0; i < nb_helpers; ++i)
+    {
+        submit(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&state, nb_chunks] { return state->done_chunks.load() == nb_chunks; });
+}
+
+ThreadPool &thread_pool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+} // namespace utils
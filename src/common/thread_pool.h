@@ -0,0 +1,53 @@
+#ifndef _THREAD_POOL_2026_10_17_H_
+#define _THREAD_POOL_2026_10_17_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace utils
+{
+    class ThreadPool
+    {
+    public:
+
+        // nb_threads == 0 -> one worker per hardware thread, minus the calling thread.
+        explicit ThreadPool(unsigned int nb_threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        unsigned int size() const { return (unsigned int)_threads.size(); }
+
+        // fire and forget.
+        void submit(std::function<void()> job);
+
+        // Calls f(begin, end) on chunks of `grain` items covering [0, count), on the workers
+        // AND on the calling thread. Returns when every chunk is done. Can be called from a worker.
+        void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &f);
+
+        // blocks until the queue is empty and no job is running.
+        void wait_idle();
+
+    private:
+
+        void worker_loop();
+
+        std::vector<std::thread> _threads;
+        std::deque<std::function<void()>> _jobs;
+        std::mutex _mutex;
+        std::condition_variable _cv_jobs;
+        std::condition_variable _cv_idle;
+        unsigned int _nb_running = 0;
+        bool _stop = false;
+    };
+
+    // process wide pool, created on first use.
+    ThreadPool &thread_pool();
+}
+
+#endif // _THREAD_POOL_2026_10_17_H_
@@ -0,0 +1,134 @@
+#include "upload_ring.h"
+
+#include <algorithm>
+
+namespace glutils
+{
+
+// enough for any vertex or index type.
+static const size_t ring_alignment = 16;
+
+static size_t align_up(size_t v)
+{
+    return (v + ring_alignment - 1) & ~(ring_alignment - 1);
+}
+
+UploadRing::~UploadRing()
+{
+    shutdown();
+}
+
+bool UploadRing::init(size_t capacity, size_t chunk_size)
+{
+    shutdown();
+
+    _capacity = capacity;
+    _chunk_size = std::min(chunk_size, capacity / 2);
+    _head = 0;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &_buffer);
+    glNamedBufferStorage(_buffer, _capacity, nullptr, flags);
+    _mapped = (char*)glMapNamedBufferRange(_buffer, 0, _capacity, flags);
+
+    return _mapped != nullptr;
+}
+
+void UploadRing::shutdown()
+{
+    if (!_buffer)
+    {
+        return;
+    }
+
+    finish();
+
+    glUnmapNamedBuffer(_buffer);
+    glDeleteBuffers(1, &_buffer);
+    _buffer = 0;
+    _mapped = nullptr;
+}
+
+void UploadRing::wait_oldest()
+{
+    pending_copy &oldest = _pending.front();
+    if (glClientWaitSync(oldest.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        ++_nb_waits;
+        while (glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+    }
+    glDeleteSync(oldest.fence);
+    _pending.pop_front();
+}
+
+void UploadRing::finish()
+{
+    while (!_pending.empty())
+    {
+        wait_oldest();
+    }
+}
+
+// Returns the offset of `size` free bytes. The (aligned) head never catches up with
+// the oldest pending copy, so head == tail always means "empty".
+size_t UploadRing::reserve(size_t size)
+{
+    for (;;)
+    {
+        if (_pending.empty())
+        {
+            if (_head + size > _capacity)
+            {
+                _head = 0;
+            }
+            return _head;
+        }
+
+        size_t tail = _pending.front().begin;
+        if (_head >= tail)
+        {
+            // free: [head, capacity) and [0, tail)
+            if (_head + size <= _capacity)
+            {
+                return _head;
+            }
+            if (align_up(size) < tail)
+            {
+                _head = 0;
+                return _head;
+            }
+        }
+        else if (align_up(_head + size) < tail)
+        {
+            return _head;
+        }
+
+        wait_oldest();
+    }
+}
+
+void UploadRing::upload(GLuint dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, const fill_func &fill)
+{
+    const size_t elements_per_chunk = std::max<size_t>(_chunk_size / element_size, 1);
+
+    for (size_t first = 0; first < nb_elements; first += elements_per_chunk)
+    {
+        size_t count = std::min(elements_per_chunk, nb_elements - first);
+        size_t size = count * element_size;
+
+        size_t begin = reserve(size);
+        fill(_mapped + begin, first, count);
+
+        // coherent mapping: the writes are visible to the copy without a flush.
+        glCopyNamedBufferSubData(_buffer, dst_buffer, begin, dst_offset + first * element_size, size);
+
+        size_t end = begin + size;
+        _pending.push_back({ begin, end, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+        _head = align_up(end);
+        _bytes_uploaded += size;
+    }
+}
+
+} // namespace glutils
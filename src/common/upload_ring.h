@@ -0,0 +1,67 @@
+#ifndef _UPLOAD_RING_2026_10_17_H_
+#define _UPLOAD_RING_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <stddef.h>
+#include <functional>
+
+namespace glutils
+{
+    //
+    // Staging ring for static data: one persistently mapped, coherent buffer that loaders
+    // write into directly, then copied on the gpu into the final (non mappable) buffers.
+    // Each copy is fenced, and the ring only waits when it wraps onto a copy still in flight.
+    //
+    class UploadRing
+    {
+    public:
+
+        UploadRing() = default;
+        ~UploadRing();
+
+        UploadRing(const UploadRing &) = delete;
+        UploadRing &operator=(const UploadRing &) = delete;
+
+        bool init(size_t capacity = 64 * 1024 * 1024, size_t chunk_size = 8 * 1024 * 1024);
+        void shutdown();
+
+        // Fills `nb_elements` elements of `element_size` bytes at dst_offset in dst_buffer.
+        // fill(ptr, first, count) writes elements [first, first+count) at ptr, which is
+        // write-only mapped memory. It is called in order, by chunks of at most chunk_size bytes.
+        using fill_func = std::function<void(void *ptr, size_t first, size_t count)>;
+        void upload(GLuint dst_buffer, size_t dst_offset, size_t nb_elements, size_t element_size, const fill_func &fill);
+
+        // waits for every pending copy.
+        void finish();
+
+        // stats
+        size_t bytes_uploaded() const { return _bytes_uploaded; }
+        size_t nb_waits() const { return _nb_waits; }
+
+    private:
+
+        size_t reserve(size_t size);
+        void wait_oldest();
+
+        struct pending_copy
+        {
+            size_t begin;
+            size_t end;
+            GLsync fence;
+        };
+
+        GLuint _buffer = 0;
+        char *_mapped = nullptr;
+        size_t _capacity = 0;
+        size_t _chunk_size = 0;
+        size_t _head = 0;
+        std::deque<pending_copy> _pending;
+
+        size_t _bytes_uploaded = 0;
+        size_t _nb_waits = 0;
+    };
+}
+
+#endif // _UPLOAD_RING_2026_10_17_H_
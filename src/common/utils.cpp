@@ -1,5 +1,19 @@
 #include "utils.h"
 #include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 namespace utils
 {
@@ -27,4 +41,137 @@ std::vector<char> read_file_content(const std::string &file_path)
     }
 }
 
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool file_info(const std::string &file_path, uint64_t *size, uint64_t *mtime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(file_path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0)
+        return false;
+#endif
+    *size = (uint64_t)st.st_size;
+    *mtime = (uint64_t)st.st_mtime;
+    return true;
+}
+
+bool make_directory(const std::string &path)
+{
+#ifdef _WIN32
+    int ret = _mkdir(path.c_str());
+#else
+    int ret = mkdir(path.c_str(), 0755);
+#endif
+    return ret == 0 || errno == EEXIST;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &file_path)
+{
+    close();
+
+    HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    _data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!_data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _file = file;
+    _mapping = mapping;
+    _size = (size_t)file_size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+        CloseHandle((HANDLE)_mapping);
+        CloseHandle((HANDLE)_file);
+    }
+    _data = nullptr;
+    _mapping = _file = nullptr;
+    _size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &file_path)
+{
+    close();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference.
+    if (data == MAP_FAILED)
+        return false;
+
+    _data = (const char*)data;
+    _size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data)
+    {
+        munmap((void*)_data, _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
+
 } // namespace utils
@@ -3,10 +3,50 @@
 
 #include <vector>
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
 
 namespace utils
 {
     std::vector<char> read_file_content(const std::string &file_path);
+
+    // 64 bits FNV-1a. Chain calls by passing the previous hash as seed.
+    uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+    // size in bytes and last modification time (seconds). False if the file does not exist.
+    bool file_info(const std::string &file_path, uint64_t *size, uint64_t *mtime);
+
+    // One level, true if it exists already.
+    bool make_directory(const std::string &path);
+
+    //
+    // Read-only memory mapping of a whole file.
+    //
+    class MappedFile
+    {
+    public:
+
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const std::string &file_path);
+        void close();
+
+        const char *data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+
+        const char *_data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        void *_file = nullptr;
+        void *_mapping = nullptr;
+#endif
+    };
 }
 
 #endif // _UTILS_2018_12_04_H_
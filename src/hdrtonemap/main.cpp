@@ -0,0 +1,560 @@
+#include "thread_pool.h"
+#include "glm_usage.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include "tonemap_operators.h"
+#include "hdr_texture.h"
+#include "grading_preset.h"
+
+#include "FilmicCurve/FilmicColorGrading.h"
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define CXXOPTS_NO_RTTI
+#include "cxxopts.hpp"
+
+//
+// hdrtonemap - cpu only tonemapping of Radiance .hdr images, for machines without a GPU.
+//
+// ex: hdrtonemap -i venice_sunset_2k.hdr -o venice.png -t filmic --toe-strength 0.5
+//
+// Also packs environment maps for the tonemap app: a .hdrmips output is the mip chain of
+// the image, encoded in --format, no tonemapping.
+//
+// ex: hdrtonemap -i venice_sunset_2k.hdr -o venice_sunset_2k.hdrmips --format rgb9e5
+//
+// Batch grading: with -p, every grading preset (saved by the tonemap app, F7) is applied to
+// every input, -o is the output directory, one "<image>_<preset>.<ext>" per pair.
+//
+// ex: hdrtonemap -i a.hdr,b.hdr -p warm.json,cold.json -o graded --ext jpg
+//
+
+enum class tonemap_operator { filmic, aces, uc2, linear };
+
+static bool parse_operator(const std::string &name, tonemap_operator *op)
+{
+    if (name == "filmic") { *op = tonemap_operator::filmic; return true; }
+    if (name == "aces")   { *op = tonemap_operator::aces;   return true; }
+    if (name == "uc2")    { *op = tonemap_operator::uc2;    return true; }
+    if (name == "linear") { *op = tonemap_operator::linear; return true; }
+    return false;
+}
+
+static std::string file_extension(const std::string &filename)
+{
+    auto dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return std::string();
+    }
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)::tolower(c); });
+    return ext;
+}
+
+// without the directory and the extension.
+static std::string file_stem(const std::string &filename)
+{
+    const size_t slash = filename.find_last_of("/\\");
+    std::string stem = slash == std::string::npos ? filename : filename.substr(slash + 1);
+    return stem.substr(0, stem.find_last_of('.'));
+}
+
+// repeated options and comma separated values alike, each item once.
+static std::vector<std::string> split_list(const std::vector<std::string> &values)
+{
+    std::vector<std::string> items;
+    for (const auto &v : values)
+    {
+        size_t begin = 0;
+        while (begin <= v.size())
+        {
+            size_t end = std::min(v.find(',', begin), v.size());
+            std::string item = v.substr(begin, end - begin);
+            if (!item.empty() && std::find(items.begin(), items.end(), item) == items.end())
+                items.push_back(item);
+            begin = end + 1;
+        }
+    }
+    return items;
+}
+
+static bool is_output_format(const std::string &ext)
+{
+    return ext == "png" || ext == "jpg" || ext == "bmp" || ext == "tga" || ext == "hdr";
+}
+
+static unsigned char to_unorm8(float v)
+{
+    v = std::min(std::max(v, 0.0f), 1.0f);
+    return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+// ext "hdr" writes the floats, the others the bytes.
+static bool write_image(const std::string &filename, const std::string &ext, int w, int h, const std::vector<unsigned char> &ldr, const std::vector<float> &floats)
+{
+    int ok = 0;
+    if (ext == "hdr") ok = stbi_write_hdr(filename.c_str(), w, h, 3, floats.data());
+    if (ext == "png") ok = stbi_write_png(filename.c_str(), w, h, 3, ldr.data(), w * 3);
+    if (ext == "jpg") ok = stbi_write_jpg(filename.c_str(), w, h, 3, ldr.data(), 95);
+    if (ext == "bmp") ok = stbi_write_bmp(filename.c_str(), w, h, 3, ldr.data());
+    if (ext == "tga") ok = stbi_write_tga(filename.c_str(), w, h, 3, ldr.data());
+    if (!ok)
+    {
+        printf("FAILED to write \"%s\"\n", filename.c_str());
+    }
+    return ok != 0;
+}
+
+// Environment map for the tonemap app: mips encoded once here instead of at each launch.
+static bool pack_mips(const std::string &in_filename, const std::string &out_filename, const std::string &format_name, int nb_levels, int nb_threads)
+{
+    utils::HdrFormat format;
+    if (!utils::parse_hdr_format(format_name, &format))
+    {
+        printf("Unknown format \"%s\"\n", format_name.c_str());
+        return false;
+    }
+
+    utils::ImageHdr image;
+    if (!utils::decode_image_hdr(in_filename, &image))
+    {
+        return false;
+    }
+
+    utils::ThreadPool pool(nb_threads > 0 ? (unsigned int)nb_threads : 0);
+    auto start = std::chrono::steady_clock::now();
+    utils::HdrMipChain chain;
+    chain.build(image, format, nb_levels, pool);
+    double encode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!chain.write(out_filename))
+    {
+        printf("FAILED to write \"%s\"\n", out_filename.c_str());
+        return false;
+    }
+
+    const size_t float_size = image.pixels.size() * sizeof(float);
+    printf("%s: %dx%d, %d levels of %s, %.1f MB (level 0 as rgb32f: %.1f MB), encoded in %.2f ms\n",
+        out_filename.c_str(), chain.width(), chain.height(), chain.nb_levels(), utils::hdr_format_name(format),
+        chain.payload_size() / (1024.0 * 1024.0), float_size / (1024.0 * 1024.0), encode_time * 1000.0);
+    return true;
+}
+
+//
+// Every preset on every image. The presets are baked once, up front, and the tables are
+// shared by all the jobs of a preset: with many presets, rebuilding them per image would
+// cost more than grading. A job is an (image, preset) pair, images first: an image is
+// decoded by its first job, shared by the others, and freed by the last one, so only the
+// images in flight are in memory. Each job grades and writes its own output, the encoding
+// runs in parallel too.
+//
+static bool grade_batch(const std::vector<std::string> &inputs, const std::vector<std::string> &preset_filenames, const std::string &out_dir, const std::string &ext, bool write_params, int nb_threads, int verbose)
+{
+    using bench_clock = std::chrono::steady_clock;
+    auto seconds_since = [](bench_clock::time_point start)
+    {
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    };
+
+    if (!is_output_format(ext))
+    {
+        printf("Unsupported output format \".%s\"\n", ext.c_str());
+        return false;
+    }
+    if (!utils::make_directory(out_dir))
+    {
+        printf("FAILED to create the output directory \"%s\"\n", out_dir.c_str());
+        return false;
+    }
+
+    const size_t nb_presets = preset_filenames.size();
+    std::vector<GradingPreset> presets(nb_presets);
+    for (size_t p = 0; p < nb_presets; ++p)
+    {
+        if (!presets[p].load(preset_filenames[p]))
+            return false;
+    }
+
+    utils::ThreadPool pool(nb_threads > 0 ? (unsigned int)nb_threads : 0);
+
+    //
+    // BAKE - once per preset
+    //
+    auto bake_start = bench_clock::now();
+    std::vector<FilmicColorGrading::BakedParams> baked(nb_presets);
+    pool.parallel_for(nb_presets, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t p = begin; p < end; ++p)
+        {
+            presets[p].bake(&baked[p]);
+        }
+    });
+    double bake_time = seconds_since(bake_start);
+
+    if (write_params)
+    {
+        for (size_t p = 0; p < nb_presets; ++p)
+        {
+            if (!presets[p].save(out_dir + "/" + file_stem(preset_filenames[p]) + "_params.json", true))
+                return false;
+        }
+    }
+
+    //
+    // GRADE - (image, preset) jobs
+    //
+    struct image
+    {
+        std::mutex mutex;
+        bool loaded = false;
+        float *data = nullptr; // null once loaded: failed, or freed.
+        int w = 0;
+        int h = 0;
+        std::atomic<size_t> nb_jobs_left;
+    };
+    std::vector<image> images(inputs.size());
+    for (auto &i : images)
+    {
+        i.nb_jobs_left = nb_presets;
+    }
+
+    const bool float_output = (ext == "hdr");
+    std::atomic<int> nb_failed(0);
+    std::atomic<uint64_t> nb_pixels(0);
+
+    auto grade_start = bench_clock::now();
+    stbi_set_flip_vertically_on_load(0);
+    pool.parallel_for(inputs.size() * nb_presets, 1, [&](size_t begin, size_t end)
+    {
+        std::vector<float> row;
+        std::vector<float> out_float;
+        std::vector<unsigned char> out_ldr;
+        for (size_t job = begin; job < end; ++job)
+        {
+            const size_t i = job / nb_presets;
+            const size_t p = job % nb_presets;
+            image &img = images[i];
+
+            float *data = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(img.mutex);
+                if (!img.loaded)
+                {
+                    int comp;
+                    img.data = stbi_loadf(inputs[i].c_str(), &img.w, &img.h, &comp, 3); // always rgb
+                    img.loaded = true;
+                    if (!img.data)
+                    {
+                        printf("FAILED to load \"%s\": %s\n", inputs[i].c_str(), stbi_failure_reason());
+                    }
+                }
+                data = img.data;
+            }
+
+            if (data)
+            {
+                const int w = img.w;
+                const int h = img.h;
+                row.resize(size_t(w) * 3);
+                out_float.resize(float_output ? size_t(w) * h * 3 : 0);
+                out_ldr.resize(float_output ? 0 : size_t(w) * h * 3);
+                for (int y = 0; y < h; ++y)
+                {
+                    const size_t offset = 3 * size_t(y) * w;
+                    float *dst = float_output ? out_float.data() + offset : row.data();
+                    baked[p].EvalColorBatch(data + offset, dst, w);
+                    if (!float_output)
+                    {
+                        for (int x = 0; x < 3 * w; ++x)
+                        {
+                            out_ldr[offset + x] = to_unorm8(row[x]);
+                        }
+                    }
+                }
+
+                const std::string out_filename = out_dir + "/" + file_stem(inputs[i]) + "_" + file_stem(preset_filenames[p]) + "." + ext;
+                if (write_image(out_filename, ext, w, h, out_ldr, out_float))
+                {
+                    nb_pixels += uint64_t(w) * h;
+                    if (verbose)
+                        printf("  %s\n", out_filename.c_str());
+                }
+                else
+                {
+                    ++nb_failed;
+                }
+            }
+            else
+            {
+                ++nb_failed;
+            }
+
+            if (--img.nb_jobs_left == 0)
+            {
+                stbi_image_free(img.data); // every job of the image is done with it.
+                img.data = nullptr;
+            }
+        }
+    });
+    double grade_time = seconds_since(grade_start);
+
+    //
+    // REPORT
+    //
+    const size_t nb_jobs = inputs.size() * nb_presets;
+    printf("%zu images x %zu presets: %zu written, %d failed, %u threads + main\n",
+        inputs.size(), nb_presets, nb_jobs - nb_failed, nb_failed.load(), pool.size());
+    printf("  bake    %8.2f ms  (%zu curves of %d)\n", bake_time * 1000.0, nb_presets, nb_presets ? baked[0].m_curveSize : 0);
+    printf("  grade   %8.2f ms  %8.1f MPix/s, load and write included\n", grade_time * 1000.0, nb_pixels / 1e6 / grade_time);
+
+    return nb_failed == 0;
+}
+
+int main(int argc, char **argv)
+{
+    //
+    // COMMAND LINE
+    //
+    cxxopts::Options options("hdrtonemap", "cpu tonemapping of .hdr images");
+    options.add_options()
+        ("i,input", "Input .hdr filename, several for a batch (repeated or comma separated)", cxxopts::value<std::vector<std::string>>())
+        ("o,output", "Output filename (.png .jpg .bmp .tga, .hdr to keep floats, or .hdrmips), batch: directory", cxxopts::value<std::string>())
+        ("p,preset", "Batch: grading presets (JSON), each applied to every input", cxxopts::value<std::vector<std::string>>())
+        ("ext", "Batch: output format, png jpg bmp tga or hdr", cxxopts::value<std::string>()->default_value("png"))
+        ("write-params", "Batch: also writes <preset>_params.json, with the raw and baked params", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("t,tonemap", "Operator: filmic, aces, uc2, linear", cxxopts::value<std::string>()->default_value("filmic"))
+        ("e,exposure", "Exposure bias, in stops", cxxopts::value<float>()->default_value("0"))
+        ("aces-gamma", "Gamma applied after ACES", cxxopts::value<float>()->default_value("2.2"))
+        ("toe-strength", "Filmic toe strength", cxxopts::value<float>()->default_value("0"))
+        ("toe-length", "Filmic toe length", cxxopts::value<float>()->default_value("0.5"))
+        ("shoulder-strength", "Filmic shoulder strength", cxxopts::value<float>()->default_value("0"))
+        ("shoulder-length", "Filmic shoulder length", cxxopts::value<float>()->default_value("0.5"))
+        ("shoulder-angle", "Filmic shoulder angle", cxxopts::value<float>()->default_value("0"))
+        ("filmic-gamma", "Gamma convolved into the filmic curve", cxxopts::value<float>()->default_value("0.4545"))
+        ("j,threads", "Worker threads, 0 = all cores", cxxopts::value<int>()->default_value("0"))
+        ("tile", "Tile size in pixels", cxxopts::value<int>()->default_value("64"))
+        ("format", ".hdrmips texels: rgb9e5, r11g11b10f, rgb16f or rgb32f", cxxopts::value<std::string>()->default_value("rgb9e5"))
+        ("levels", ".hdrmips mip levels, 0 = down to 1x1", cxxopts::value<int>()->default_value("0"))
+        ("v,verbose", "Prints text", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ;
+
+    options.parse(argc, argv);
+
+    struct
+    {
+        std::vector<std::string> inputs;
+        std::vector<std::string> presets;
+        std::string ext;
+        int write_params;
+        std::string in_filename;
+        std::string out_filename;
+        std::string op_name;
+        tonemap_operator op;
+        float exposure;
+        float aces_gamma;
+        int nb_threads;
+        int tile_size;
+        int verbose;
+        std::string format_name;
+        int nb_levels;
+        FilmicColorGrading::UserParams grading;
+    } o;
+
+    // parse
+    o.inputs = split_list(options["i"].as<std::vector<std::string>>());
+    o.presets = split_list(options["p"].as<std::vector<std::string>>());
+    o.ext = options["ext"].as<std::string>();
+    o.write_params = options["write-params"].as<int>();
+    o.in_filename = o.inputs.size() == 1 ? o.inputs[0] : std::string();
+    o.out_filename = options["o"].as<std::string>();
+    o.op_name = options["t"].as<std::string>();
+    o.exposure = options["e"].as<float>();
+    o.aces_gamma = options["aces-gamma"].as<float>();
+    o.nb_threads = options["j"].as<int>();
+    o.tile_size = std::max(8, options["tile"].as<int>());
+    o.verbose = options["v"].as<int>();
+    o.format_name = options["format"].as<std::string>();
+    o.nb_levels = std::max(0, options["levels"].as<int>());
+    o.grading.m_exposureBias = o.exposure;
+    o.grading.m_filmicToeStrength = options["toe-strength"].as<float>();
+    o.grading.m_filmicToeLength = options["toe-length"].as<float>();
+    o.grading.m_filmicShoulderStrength = options["shoulder-strength"].as<float>();
+    o.grading.m_filmicShoulderLength = options["shoulder-length"].as<float>();
+    o.grading.m_filmicShoulderAngle = options["shoulder-angle"].as<float>();
+    o.grading.m_filmicGamma = options["filmic-gamma"].as<float>();
+
+    if (!o.presets.empty() && !o.inputs.empty() && !o.out_filename.empty())
+    {
+        return grade_batch(o.inputs, o.presets, o.out_filename, o.ext, o.write_params != 0, o.nb_threads, o.verbose) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (o.in_filename.empty() || o.out_filename.empty())
+    {
+        std::cout << options.help() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!parse_operator(o.op_name, &o.op))
+    {
+        printf("Unknown operator \"%s\"\n", o.op_name.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const std::string out_ext = file_extension(o.out_filename);
+    if (out_ext == "hdrmips")
+    {
+        return pack_mips(o.in_filename, o.out_filename, o.format_name, o.nb_levels, o.nb_threads) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const bool float_output = (out_ext == "hdr");
+    if (!is_output_format(out_ext))
+    {
+        printf("Unsupported output format \".%s\"\n", out_ext.c_str());
+        return EXIT_FAILURE;
+    }
+
+    using bench_clock = std::chrono::steady_clock;
+    auto seconds_since = [](bench_clock::time_point start)
+    {
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    };
+
+    //
+    // LOAD
+    //
+    auto load_start = bench_clock::now();
+    stbi_set_flip_vertically_on_load(0);
+    int w, h, comp;
+    float *image_data = stbi_loadf(o.in_filename.c_str(), &w, &h, &comp, 3); // always rgb
+    if (!image_data)
+    {
+        printf("FAILED to load \"%s\": %s\n", o.in_filename.c_str(), stbi_failure_reason());
+        return EXIT_FAILURE;
+    }
+    double load_time = seconds_since(load_start);
+
+    //
+    // TONEMAP - tiles spread over the pool
+    //
+    FilmicColorGrading::BakedParams baked;
+    if (o.op == tonemap_operator::filmic)
+    {
+        FilmicColorGrading::RawParams raw;
+        FilmicColorGrading::EvalParams eval;
+        FilmicColorGrading::RawFromUserParams(raw, o.grading);
+        FilmicColorGrading::EvalFromRawParams(eval, raw);
+        FilmicColorGrading::BakeFromEvalParams(baked, eval, 1024, FilmicColorGrading::kTableSpacing_Quadratic);
+    }
+    const float exposure_scale = exp2f(o.exposure); // filmic has it baked already
+
+    std::vector<float> out_float(float_output ? size_t(w) * h * 3 : 0);
+    std::vector<unsigned char> out_ldr(float_output ? 0 : size_t(w) * h * 3);
+
+    utils::ThreadPool pool(o.nb_threads > 0 ? (unsigned int)o.nb_threads : 0);
+
+    const int tile = o.tile_size;
+    const int nb_tiles_x = (w + tile - 1) / tile;
+    const int nb_tiles_y = (h + tile - 1) / tile;
+
+    auto tonemap_start = bench_clock::now();
+    pool.parallel_for(size_t(nb_tiles_x) * nb_tiles_y, 1, [&](size_t begin, size_t end)
+    {
+        std::vector<float> row(size_t(tile) * 3);
+        for (size_t t = begin; t < end; ++t)
+        {
+            const int x0 = int(t % nb_tiles_x) * tile;
+            const int y0 = int(t / nb_tiles_x) * tile;
+            const int tile_w = std::min(tile, w - x0);
+            const int tile_h = std::min(tile, h - y0);
+
+            for (int y = y0; y < y0 + tile_h; ++y)
+            {
+                const size_t offset = 3 * (size_t(y) * w + x0);
+                const float *src = image_data + offset;
+
+                switch (o.op)
+                {
+                    case tonemap_operator::filmic:
+                    {
+                        baked.EvalColorBatch(src, row.data(), tile_w);
+                    } break;
+
+                    case tonemap_operator::aces:
+                    {
+                        for (int x = 0; x < tile_w; ++x)
+                        {
+                            glm::vec3 c = exposure_scale * glm::vec3(src[3 * x + 0], src[3 * x + 1], src[3 * x + 2]);
+                            c = tonemap::linear_to_gamma(tonemap::aces_fitted(c), o.aces_gamma);
+                            row[3 * x + 0] = c.x;
+                            row[3 * x + 1] = c.y;
+                            row[3 * x + 2] = c.z;
+                        }
+                    } break;
+
+                    case tonemap_operator::uc2:
+                    {
+                        for (int x = 0; x < 3 * tile_w; ++x)
+                        {
+                            row[x] = tonemap::filmic_uc2(exposure_scale * src[x]);
+                        }
+                    } break;
+
+                    case tonemap_operator::linear:
+                    {
+                        for (int x = 0; x < 3 * tile_w; ++x)
+                        {
+                            row[x] = exposure_scale * src[x];
+                        }
+                    } break;
+                }
+
+                if (float_output)
+                {
+                    std::copy(row.begin(), row.begin() + 3 * tile_w, out_float.begin() + offset);
+                }
+                else
+                {
+                    for (int x = 0; x < 3 * tile_w; ++x)
+                    {
+                        out_ldr[offset + x] = to_unorm8(row[x]);
+                    }
+                }
+            }
+        }
+    });
+    double tonemap_time = seconds_since(tonemap_start);
+
+    stbi_image_free(image_data);
+
+    //
+    // WRITE
+    //
+    auto write_start = bench_clock::now();
+    if (!write_image(o.out_filename, out_ext, w, h, out_ldr, out_float))
+    {
+        return EXIT_FAILURE;
+    }
+    double write_time = seconds_since(write_start);
+
+    //
+    // REPORT
+    //
+    const double mpix = double(w) * h / 1e6;
+    printf("%s: %dx%d, %s, %u threads + main, %d tiles of %d px\n",
+        o.in_filename.c_str(), w, h, o.op_name.c_str(), pool.size(), nb_tiles_x * nb_tiles_y, tile);
+    printf("  tonemap %8.2f ms  %8.1f MPix/s\n", tonemap_time * 1000.0, mpix / tonemap_time);
+    if (o.verbose)
+    {
+        printf("  load    %8.2f ms\n", load_time * 1000.0);
+        printf("  write   %8.2f ms\n", write_time * 1000.0);
+    }
+
+    return EXIT_SUCCESS;
+}
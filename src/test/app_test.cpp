@@ -632,6 +632,9 @@ AppTest::AppTest(void * options)
         int dontrender;
         int verbose;
         int extraverbose;
+        std::string headless;
+        int headless_frames;
+        std::string output;
     };
     
     options_t o = *(options_t*)options;
@@ -843,6 +846,7 @@ void AppTest::run(float dt)
     //
     // fullscreen pass - copy the LDR framebuffer to the screen (could use a blit)
     //
+    if (!_headless)
     {
         glBindSampler(0, _nearest_sampler); // bind the sampler to the texture unit 0
         glBindTextureUnit(0, _fbtex_ldr_color); // bind the texture object to the texture unit 0
@@ -19,6 +19,7 @@ public:
     bool init(int framebuffer_width, int framebuffer_height) override;
     void shutdown() override;
     void run(float dt) override;
+    unsigned int output_texture() const override { return _fbtex_ldr_color; }
 
     void onWindowSize(GLFWwindow* window, int w, int h) override;
     void onFramebufferSize(GLFWwindow* window, int w, int h) override;
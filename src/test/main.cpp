@@ -2,6 +2,7 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "gl_utils.h"
+#include "headless.h"
 #include "app_test.h"
 
 #include <chrono>
@@ -168,6 +169,9 @@ int main(int argc, char **argv)
         ("x,exit", "Exit without rendering", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
         ("v,verbose", "Prints text", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
         ("V,extra-verbose", "Prints extra text", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("headless", "Renders without a window, through egl or osmesa", cxxopts::value<std::string>()->implicit_value("egl"))
+        ("frames", "Frames rendered by --headless", cxxopts::value<int>()->default_value("1"))
+        ("o,output", "PNG written by --headless, from the last frame", cxxopts::value<std::string>())
         ;
 
     options.parse(argc, argv);
@@ -180,6 +184,9 @@ int main(int argc, char **argv)
         int dontrender;
         int verbose;
         int extraverbose;
+        std::string headless;
+        int headless_frames;
+        std::string output;
     } o;
 
     // parse
@@ -189,6 +196,9 @@ int main(int argc, char **argv)
     o.dontrender = options["x"].as<int>();
     o.verbose = options["v"].as<int>();
     o.extraverbose = options["extra-verbose"].as<int>();
+    o.headless = options["headless"].as<std::string>();
+    o.headless_frames = options["frames"].as<int>();
+    o.output = options["o"].as<std::string>();
 
     if (o.verbose)
     {
@@ -211,6 +221,24 @@ int main(int argc, char **argv)
 
     App *app = new AppTest((void*)&o);
 
+    //
+    // HEADLESS - no window, no display needed
+    //
+
+    if (!o.headless.empty())
+    {
+        glutils::HeadlessOptions headless;
+        headless.backend = o.headless;
+        headless.width = o.width;
+        headless.height = o.height;
+        headless.nb_frames = o.dontrender ? 0 : o.headless_frames;
+        headless.output = o.output;
+
+        int exit_code = glutils::run_headless(app, headless);
+        delete app;
+        return exit_code;
+    }
+
     //
     // GLFW
     //
@@ -346,6 +374,7 @@ int main(int argc, char **argv)
     // Cleanup
     //
 
+    app->shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
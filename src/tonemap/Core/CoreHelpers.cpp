@@ -1,9 +1,16 @@
 #include "CoreHelpers.h"
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <signal.h>
+#include <time.h>
+#endif
 
+#ifdef _MSC_VER
 #pragma optimize("",off)
+#endif
 
 void ALWAYS_ASSERT_RAW(bool cond, const char fileName[], const int lineNum, const char funcName[], const char expression[])
 {
@@ -13,7 +20,11 @@ void ALWAYS_ASSERT_RAW(bool cond, const char fileName[], const int lineNum, cons
 		printf("File: %s\n", fileName);
 		printf("Line: %d\n", lineNum);
 		printf("Func: %s\n", funcName);
+#ifdef _WIN32
 		DebugBreak();
+#else
+		raise(SIGTRAP);
+#endif
 	}
 }
 
@@ -55,10 +66,11 @@ std::string GetNextLineFromFile(FILE * fin, bool & isEof)
 
 std::string LocalTimeAsString()
 {
+	char buf[2048];
+#ifdef _WIN32
 	SYSTEMTIME currTime;
 	GetLocalTime(&currTime);
 
-	char buf[2048];
 	sprintf(buf,"%04d_%02d_%02d__%02d_%02d_%02d",
 		(int)currTime.wYear,
 		(int)currTime.wMonth,
@@ -66,6 +78,19 @@ std::string LocalTimeAsString()
 		(int)currTime.wHour,
 		(int)currTime.wMinute,
 		(int)currTime.wSecond);
+#else
+	time_t now = time(nullptr);
+	struct tm currTime;
+	localtime_r(&now, &currTime);
+
+	sprintf(buf,"%04d_%02d_%02d__%02d_%02d_%02d",
+		currTime.tm_year + 1900,
+		currTime.tm_mon + 1,
+		currTime.tm_mday,
+		currTime.tm_hour,
+		currTime.tm_min,
+		currTime.tm_sec);
+#endif
 
 	return buf;
 }
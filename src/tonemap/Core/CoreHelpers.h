@@ -1,8 +1,16 @@
 #ifndef _CORE_HELPERS_H_
 #define _CORE_HELPERS_H_
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <chrono>
+// C++ AMP qualifier, msvc only.
+#define restrict(x)
+#endif
 #include <stdio.h>
+#include <stdint.h>
+#include <math.h>
 #include <vector>
 #include <string>
 
@@ -84,8 +92,9 @@ inline std::string FourDigitString(int i)
 }
 
 
-inline unsigned __int64 GetQualityTimeMicroSec()
+inline uint64_t GetQualityTimeMicroSec()
 {
+#ifdef _WIN32
 	LARGE_INTEGER freq;
 	LARGE_INTEGER currTime;
 	BOOL bRet;
@@ -96,8 +105,11 @@ inline unsigned __int64 GetQualityTimeMicroSec()
 	ASSERT_ALWAYS(bRet);
 
 	double numSec = ((double)currTime.QuadPart)/((double)freq.QuadPart);
-	unsigned __int64 microSec = (unsigned __int64)(numSec * 1000000.0);
+	uint64_t microSec = (uint64_t)(numSec * 1000000.0);
 	return microSec;
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
 
 }
 
@@ -117,7 +129,7 @@ inline A AlignSize(A x, B size)
 	*/
 }
 
-inline unsigned __int64 AlignSize64(unsigned __int64 x, unsigned __int64 size)
+inline uint64_t AlignSize64(uint64_t x, uint64_t size)
 {
 	return (((x+size)-1)/size)*size;
 }
@@ -1,5 +1,7 @@
 #include "ShUtil.h"
 
+#include <string.h>
+
 //#include "LinearAlgebraUtil.h"
 
 const static float s_c0 = 0.28209479177f; // 1 / (2 * sqrt(pi))
@@ -236,7 +236,29 @@ void FilmicColorGrading::EvalFromRawParams(EvalParams & dstParams, const RawPara
 	dstParams.m_gainAdjust = rawParams.m_gainAdjust;
 }
 
+// So what is the maximum value to bake into the curve? It's filmic W with inverse contrast applied
+static float CalcMaxTableValue(const FilmicColorGrading::EvalParams & srcParams)
+{
+	return EvalLogContrastFuncRev(srcParams.m_filmicCurve.m_W,srcParams.m_contrastEpsilon,srcParams.m_contrastLogMidpoint,srcParams.m_contrastStrength);
+}
+
 void FilmicColorGrading::BakeFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams, const int curveSize, const eTableSpacing spacing)
+{
+	dstCurve.Reset();
+	BakeTablesFromEvalParams(dstCurve,srcParams,curveSize,spacing);
+	BakeScalarsFromEvalParams(dstCurve,srcParams);
+}
+
+void FilmicColorGrading::BakeScalarsFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams)
+{
+	float maxTableValue = CalcMaxTableValue(srcParams);
+
+	dstCurve.m_saturation = srcParams.m_saturation;
+	dstCurve.m_linColorFilterExposure = srcParams.m_linColorFilterExposure * (1.0f / maxTableValue);
+	dstCurve.m_luminanceWeights = srcParams.m_luminanceWeights;
+}
+
+void FilmicColorGrading::BakeTablesFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams, const int curveSize, const eTableSpacing spacing)
 {
 
 	// in the curve, we are baking the following steps:
@@ -244,17 +266,11 @@ void FilmicColorGrading::BakeFromEvalParams(BakedParams & dstCurve, const EvalPa
 	// v = EvalFilmicCurve(v);
 	// v = EvalLiftGammaGain(v);
 
-	// So what is the maximum value to bake into the curve? It's filmic W with inverse contrast applied
-	float maxTableValue = EvalLogContrastFuncRev(srcParams.m_filmicCurve.m_W,srcParams.m_contrastEpsilon,srcParams.m_contrastLogMidpoint,srcParams.m_contrastStrength);
+	float maxTableValue = CalcMaxTableValue(srcParams);
 
-	dstCurve.Reset();
 	dstCurve.m_curveSize = curveSize;
 	dstCurve.m_spacing = spacing;
 
-	dstCurve.m_saturation = srcParams.m_saturation;
-	dstCurve.m_linColorFilterExposure = srcParams.m_linColorFilterExposure * (1.0f / maxTableValue);
-	dstCurve.m_luminanceWeights = srcParams.m_luminanceWeights;
-
 	dstCurve.m_curveB.resize(curveSize);
 	dstCurve.m_curveG.resize(curveSize);
 	dstCurve.m_curveR.resize(curveSize);
@@ -204,6 +204,15 @@ public:
 		kTableSpacing_Num
 	};
 
+	// instruction set used by BakedParams::EvalColorBatch
+	enum eBatchIsa
+	{
+		kBatchIsa_Scalar,
+		kBatchIsa_Sse2,
+		kBatchIsa_Avx2,
+		kBatchIsa_Num
+	};
+
 	struct BakedParams
 	{
 		BakedParams()
@@ -230,6 +239,10 @@ public:
 		static float SampleTable(const std::vector < float > & curve, float x);
 		Vec3 EvalColor(const Vec3 x) const;
 
+		// Same as EvalColor over many pixels, bit-exact with the scalar path. Runs on AVX2 or SSE2 if the cpu has it.
+		void EvalColorBatch(const float * rgbIn, float * rgbOut, size_t count) const; // interleaved rgb, in place is fine
+		void EvalColorBatchSoA(const float * rIn, const float * gIn, const float * bIn, float * rOut, float * gOut, float * bOut, size_t count) const;
+
 		// params
 		Vec3 m_linColorFilterExposure;
 		Vec3 m_luminanceWeights;
@@ -255,6 +268,15 @@ public:
 	static void EvalFromRawParams(EvalParams & dstParams, const RawParams & rawParams);
 	static void BakeFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams, const int curveSize, const eTableSpacing spacing);
 
+	// the two halves of BakeFromEvalParams. Exposure, color filter and saturation only touch the scalars,
+	// so an editor can skip the tables when only those change. The scalars depend on the tables' max value though.
+	static void BakeScalarsFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams);
+	static void BakeTablesFromEvalParams(BakedParams & dstCurve, const EvalParams & srcParams, const int curveSize, const eTableSpacing spacing);
+
 	static float ApplyLiftInvGammaGain(const float lift, const float invGamma, const float gain, float v);
+
+	// best instruction set supported by this cpu, capped by SetMaxBatchIsa (handy to compare kernels)
+	static eBatchIsa GetBatchIsa();
+	static void SetMaxBatchIsa(eBatchIsa isa);
 };
 
@@ -0,0 +1,387 @@
+#include "FilmicColorGrading.h"
+
+// Batch version of BakedParams::EvalColor. Each lane runs the exact same float operations in the same order as the
+// scalar code: no fma, correctly rounded sqrt, truncating float to int like the scalar cast. So the output matches
+// EvalColor bit for bit, whatever the kernel.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FILMIC_BATCH_X86 1
+#else
+#define FILMIC_BATCH_X86 0
+#endif
+
+#if FILMIC_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FILMIC_TARGET_AVX2
+#else
+#define FILMIC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static FilmicColorGrading::eBatchIsa DetectBatchIsa()
+{
+#if FILMIC_BATCH_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info,0);
+	int maxLeaf = info[0];
+
+	__cpuid(info,1);
+	bool hasSse2 = (info[3] & (1 << 26)) != 0;
+	bool hasAvx = (info[2] & (1 << 28)) != 0;
+	bool hasOsXsave = (info[2] & (1 << 27)) != 0;
+
+	bool hasAvx2 = false;
+	if (maxLeaf >= 7 && hasAvx && hasOsXsave && (_xgetbv(0) & 6) == 6) // the os must save the ymm registers too
+	{
+		__cpuidex(info,7,0);
+		hasAvx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool hasSse2 = __builtin_cpu_supports("sse2") != 0;
+	bool hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+	if (hasAvx2)
+		return FilmicColorGrading::kBatchIsa_Avx2;
+	if (hasSse2)
+		return FilmicColorGrading::kBatchIsa_Sse2;
+#endif
+	return FilmicColorGrading::kBatchIsa_Scalar;
+}
+
+static const FilmicColorGrading::eBatchIsa s_cpuBatchIsa = DetectBatchIsa();
+static FilmicColorGrading::eBatchIsa s_maxBatchIsa = FilmicColorGrading::kBatchIsa_Avx2;
+
+FilmicColorGrading::eBatchIsa FilmicColorGrading::GetBatchIsa()
+{
+	return s_cpuBatchIsa < s_maxBatchIsa ? s_cpuBatchIsa : s_maxBatchIsa;
+}
+
+void FilmicColorGrading::SetMaxBatchIsa(eBatchIsa isa)
+{
+	s_maxBatchIsa = isa;
+}
+
+#if FILMIC_BATCH_X86
+
+// everything a kernel needs, pulled out of BakedParams once per batch
+struct BatchConstants
+{
+	float m_filter[3];
+	float m_weights[3];
+	float m_saturation;
+	FilmicColorGrading::eTableSpacing m_spacing;
+
+	const float * m_curve[3];
+	int m_size[3];
+};
+
+static BatchConstants MakeBatchConstants(const FilmicColorGrading::BakedParams & params)
+{
+	BatchConstants c;
+	for (int i = 0; i < 3; i++)
+	{
+		c.m_filter[i] = params.m_linColorFilterExposure.m_data[i];
+		c.m_weights[i] = params.m_luminanceWeights.m_data[i];
+	}
+	c.m_saturation = params.m_saturation;
+	c.m_spacing = params.m_spacing;
+
+	c.m_curve[0] = params.m_curveR.data();
+	c.m_curve[1] = params.m_curveG.data();
+	c.m_curve[2] = params.m_curveB.data();
+	c.m_size[0] = (int)params.m_curveR.size();
+	c.m_size[1] = (int)params.m_curveG.size();
+	c.m_size[2] = (int)params.m_curveB.size();
+	return c;
+}
+
+//
+// SSE2, 4 pixels at a time
+//
+
+// SSE2 has no min/max for 32 bit ints
+static inline __m128i MaxEpi32Sse2(__m128i a, __m128i b)
+{
+	__m128i mask = _mm_cmpgt_epi32(a,b);
+	return _mm_or_si128(_mm_and_si128(mask,a),_mm_andnot_si128(mask,b));
+}
+
+static inline __m128i MinEpi32Sse2(__m128i a, __m128i b)
+{
+	__m128i mask = _mm_cmplt_epi32(a,b);
+	return _mm_or_si128(_mm_and_si128(mask,a),_mm_andnot_si128(mask,b));
+}
+
+static inline __m128 ApplySpacingInvSse2(__m128 v, FilmicColorGrading::eTableSpacing spacing)
+{
+	if (spacing == FilmicColorGrading::kTableSpacing_Linear)
+		return v;
+	if (spacing == FilmicColorGrading::kTableSpacing_Quadratic)
+		return _mm_sqrt_ps(v);
+	if (spacing == FilmicColorGrading::kTableSpacing_Quartic)
+		return _mm_sqrt_ps(_mm_sqrt_ps(v));
+
+	return _mm_setzero_ps();
+}
+
+static inline __m128 SampleTableSse2(const float * curve, int size, __m128 normX)
+{
+	__m128 x = _mm_add_ps(_mm_mul_ps(normX,_mm_set1_ps(float(size-1))),_mm_set1_ps(.5f));
+	__m128 xHalf = _mm_sub_ps(x,_mm_set1_ps(.5f));
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i last = _mm_set1_epi32(size-1);
+
+	__m128i baseIndex = MaxEpi32Sse2(zero,_mm_cvttps_epi32(xHalf));
+	__m128 t = _mm_sub_ps(xHalf,_mm_cvtepi32_ps(baseIndex));
+
+	__m128i x0 = MaxEpi32Sse2(zero,MinEpi32Sse2(baseIndex,last));
+	__m128i x1 = MaxEpi32Sse2(zero,MinEpi32Sse2(_mm_add_epi32(baseIndex,_mm_set1_epi32(1)),last));
+
+	// no gather before AVX2
+	alignas(16) int i0[4];
+	alignas(16) int i1[4];
+	_mm_store_si128((__m128i *)i0,x0);
+	_mm_store_si128((__m128i *)i1,x1);
+
+	__m128 v0 = _mm_setr_ps(curve[i0[0]],curve[i0[1]],curve[i0[2]],curve[i0[3]]);
+	__m128 v1 = _mm_setr_ps(curve[i1[0]],curve[i1[1]],curve[i1[2]],curve[i1[3]]);
+
+	return _mm_add_ps(_mm_mul_ps(v0,_mm_sub_ps(_mm_set1_ps(1.0f),t)),_mm_mul_ps(v1,t));
+}
+
+static inline void EvalLanesSse2(const BatchConstants & c, __m128 & r, __m128 & g, __m128 & b)
+{
+	// exposure and color filter
+	r = _mm_mul_ps(r,_mm_set1_ps(c.m_filter[0]));
+	g = _mm_mul_ps(g,_mm_set1_ps(c.m_filter[1]));
+	b = _mm_mul_ps(b,_mm_set1_ps(c.m_filter[2]));
+
+	// saturation
+	__m128 grey = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r,_mm_set1_ps(c.m_weights[0])),_mm_mul_ps(g,_mm_set1_ps(c.m_weights[1]))),_mm_mul_ps(b,_mm_set1_ps(c.m_weights[2])));
+	__m128 sat = _mm_set1_ps(c.m_saturation);
+	r = _mm_add_ps(grey,_mm_mul_ps(sat,_mm_sub_ps(r,grey)));
+	g = _mm_add_ps(grey,_mm_mul_ps(sat,_mm_sub_ps(g,grey)));
+	b = _mm_add_ps(grey,_mm_mul_ps(sat,_mm_sub_ps(b,grey)));
+
+	r = ApplySpacingInvSse2(r,c.m_spacing);
+	g = ApplySpacingInvSse2(g,c.m_spacing);
+	b = ApplySpacingInvSse2(b,c.m_spacing);
+
+	// contrast, filmic curve, gamma
+	r = SampleTableSse2(c.m_curve[0],c.m_size[0],r);
+	g = SampleTableSse2(c.m_curve[1],c.m_size[1],g);
+	b = SampleTableSse2(c.m_curve[2],c.m_size[2],b);
+}
+
+// returns the number of pixels done, the caller finishes the tail
+static size_t EvalSoASse2(const BatchConstants & c, const float * rIn, const float * gIn, const float * bIn, float * rOut, float * gOut, float * bOut, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 r = _mm_loadu_ps(rIn + i);
+		__m128 g = _mm_loadu_ps(gIn + i);
+		__m128 b = _mm_loadu_ps(bIn + i);
+		EvalLanesSse2(c,r,g,b);
+		_mm_storeu_ps(rOut + i,r);
+		_mm_storeu_ps(gOut + i,g);
+		_mm_storeu_ps(bOut + i,b);
+	}
+	return i;
+}
+
+static size_t EvalInterleavedSse2(const BatchConstants & c, const float * rgbIn, float * rgbOut, size_t count)
+{
+	alignas(16) float r[4];
+	alignas(16) float g[4];
+	alignas(16) float b[4];
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const float * src = rgbIn + 3*i;
+		for (int j = 0; j < 4; j++)
+		{
+			r[j] = src[3*j+0];
+			g[j] = src[3*j+1];
+			b[j] = src[3*j+2];
+		}
+
+		__m128 vr = _mm_load_ps(r);
+		__m128 vg = _mm_load_ps(g);
+		__m128 vb = _mm_load_ps(b);
+		EvalLanesSse2(c,vr,vg,vb);
+		_mm_store_ps(r,vr);
+		_mm_store_ps(g,vg);
+		_mm_store_ps(b,vb);
+
+		float * dst = rgbOut + 3*i;
+		for (int j = 0; j < 4; j++)
+		{
+			dst[3*j+0] = r[j];
+			dst[3*j+1] = g[j];
+			dst[3*j+2] = b[j];
+		}
+	}
+	return i;
+}
+
+//
+// AVX2, 8 pixels at a time, with real gathers
+//
+
+FILMIC_TARGET_AVX2 static inline __m256 ApplySpacingInvAvx2(__m256 v, FilmicColorGrading::eTableSpacing spacing)
+{
+	if (spacing == FilmicColorGrading::kTableSpacing_Linear)
+		return v;
+	if (spacing == FilmicColorGrading::kTableSpacing_Quadratic)
+		return _mm256_sqrt_ps(v);
+	if (spacing == FilmicColorGrading::kTableSpacing_Quartic)
+		return _mm256_sqrt_ps(_mm256_sqrt_ps(v));
+
+	return _mm256_setzero_ps();
+}
+
+FILMIC_TARGET_AVX2 static inline __m256 SampleTableAvx2(const float * curve, int size, __m256 normX)
+{
+	// keep mul and add separate, an fma would not round like the scalar code
+	__m256 x = _mm256_add_ps(_mm256_mul_ps(normX,_mm256_set1_ps(float(size-1))),_mm256_set1_ps(.5f));
+	__m256 xHalf = _mm256_sub_ps(x,_mm256_set1_ps(.5f));
+
+	__m256i zero = _mm256_setzero_si256();
+	__m256i last = _mm256_set1_epi32(size-1);
+
+	__m256i baseIndex = _mm256_max_epi32(zero,_mm256_cvttps_epi32(xHalf));
+	__m256 t = _mm256_sub_ps(xHalf,_mm256_cvtepi32_ps(baseIndex));
+
+	__m256i x0 = _mm256_max_epi32(zero,_mm256_min_epi32(baseIndex,last));
+	__m256i x1 = _mm256_max_epi32(zero,_mm256_min_epi32(_mm256_add_epi32(baseIndex,_mm256_set1_epi32(1)),last));
+
+	__m256 v0 = _mm256_i32gather_ps(curve,x0,4);
+	__m256 v1 = _mm256_i32gather_ps(curve,x1,4);
+
+	return _mm256_add_ps(_mm256_mul_ps(v0,_mm256_sub_ps(_mm256_set1_ps(1.0f),t)),_mm256_mul_ps(v1,t));
+}
+
+FILMIC_TARGET_AVX2 static inline void EvalLanesAvx2(const BatchConstants & c, __m256 & r, __m256 & g, __m256 & b)
+{
+	// exposure and color filter
+	r = _mm256_mul_ps(r,_mm256_set1_ps(c.m_filter[0]));
+	g = _mm256_mul_ps(g,_mm256_set1_ps(c.m_filter[1]));
+	b = _mm256_mul_ps(b,_mm256_set1_ps(c.m_filter[2]));
+
+	// saturation
+	__m256 grey = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r,_mm256_set1_ps(c.m_weights[0])),_mm256_mul_ps(g,_mm256_set1_ps(c.m_weights[1]))),_mm256_mul_ps(b,_mm256_set1_ps(c.m_weights[2])));
+	__m256 sat = _mm256_set1_ps(c.m_saturation);
+	r = _mm256_add_ps(grey,_mm256_mul_ps(sat,_mm256_sub_ps(r,grey)));
+	g = _mm256_add_ps(grey,_mm256_mul_ps(sat,_mm256_sub_ps(g,grey)));
+	b = _mm256_add_ps(grey,_mm256_mul_ps(sat,_mm256_sub_ps(b,grey)));
+
+	r = ApplySpacingInvAvx2(r,c.m_spacing);
+	g = ApplySpacingInvAvx2(g,c.m_spacing);
+	b = ApplySpacingInvAvx2(b,c.m_spacing);
+
+	// contrast, filmic curve, gamma
+	r = SampleTableAvx2(c.m_curve[0],c.m_size[0],r);
+	g = SampleTableAvx2(c.m_curve[1],c.m_size[1],g);
+	b = SampleTableAvx2(c.m_curve[2],c.m_size[2],b);
+}
+
+FILMIC_TARGET_AVX2 static size_t EvalSoAAvx2(const BatchConstants & c, const float * rIn, const float * gIn, const float * bIn, float * rOut, float * gOut, float * bOut, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 r = _mm256_loadu_ps(rIn + i);
+		__m256 g = _mm256_loadu_ps(gIn + i);
+		__m256 b = _mm256_loadu_ps(bIn + i);
+		EvalLanesAvx2(c,r,g,b);
+		_mm256_storeu_ps(rOut + i,r);
+		_mm256_storeu_ps(gOut + i,g);
+		_mm256_storeu_ps(bOut + i,b);
+	}
+	return i;
+}
+
+FILMIC_TARGET_AVX2 static size_t EvalInterleavedAvx2(const BatchConstants & c, const float * rgbIn, float * rgbOut, size_t count)
+{
+	// rgb offsets of 8 consecutive pixels
+	const __m256i offsets = _mm256_setr_epi32(0,3,6,9,12,15,18,21);
+
+	alignas(32) float r[8];
+	alignas(32) float g[8];
+	alignas(32) float b[8];
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const float * src = rgbIn + 3*i;
+		__m256 vr = _mm256_i32gather_ps(src + 0,offsets,4);
+		__m256 vg = _mm256_i32gather_ps(src + 1,offsets,4);
+		__m256 vb = _mm256_i32gather_ps(src + 2,offsets,4);
+		EvalLanesAvx2(c,vr,vg,vb);
+		_mm256_store_ps(r,vr);
+		_mm256_store_ps(g,vg);
+		_mm256_store_ps(b,vb);
+
+		float * dst = rgbOut + 3*i;
+		for (int j = 0; j < 8; j++)
+		{
+			dst[3*j+0] = r[j];
+			dst[3*j+1] = g[j];
+			dst[3*j+2] = b[j];
+		}
+	}
+	return i;
+}
+
+#endif // FILMIC_BATCH_X86
+
+void FilmicColorGrading::BakedParams::EvalColorBatch(const float * rgbIn, float * rgbOut, size_t count) const
+{
+	size_t done = 0;
+
+#if FILMIC_BATCH_X86
+	BatchConstants c = MakeBatchConstants(*this);
+	eBatchIsa isa = GetBatchIsa();
+	if (isa == kBatchIsa_Avx2)
+		done = EvalInterleavedAvx2(c,rgbIn,rgbOut,count);
+	else if (isa == kBatchIsa_Sse2)
+		done = EvalInterleavedSse2(c,rgbIn,rgbOut,count);
+#endif
+
+	for (size_t i = done; i < count; i++)
+	{
+		Vec3 rgb = EvalColor(Vec3(rgbIn[3*i+0],rgbIn[3*i+1],rgbIn[3*i+2]));
+		rgbOut[3*i+0] = rgb.x;
+		rgbOut[3*i+1] = rgb.y;
+		rgbOut[3*i+2] = rgb.z;
+	}
+}
+
+void FilmicColorGrading::BakedParams::EvalColorBatchSoA(const float * rIn, const float * gIn, const float * bIn, float * rOut, float * gOut, float * bOut, size_t count) const
+{
+	size_t done = 0;
+
+#if FILMIC_BATCH_X86
+	BatchConstants c = MakeBatchConstants(*this);
+	eBatchIsa isa = GetBatchIsa();
+	if (isa == kBatchIsa_Avx2)
+		done = EvalSoAAvx2(c,rIn,gIn,bIn,rOut,gOut,bOut,count);
+	else if (isa == kBatchIsa_Sse2)
+		done = EvalSoASse2(c,rIn,gIn,bIn,rOut,gOut,bOut,count);
+#endif
+
+	for (size_t i = done; i < count; i++)
+	{
+		Vec3 rgb = EvalColor(Vec3(rIn[i],gIn[i],bIn[i]));
+		rOut[i] = rgb.x;
+		gOut[i] = rgb.y;
+		bOut[i] = rgb.z;
+	}
+}
@@ -9,439 +9,426 @@
 #include "tiny_obj_loader.h"
 #include "tiny_gltf.h"
 #include "gl_utils.h"
+#include "profiler.h"
 #include "utils.h"
 #include "procgen.h"
+#include "tonemap_operators.h"
+#include "scene_vertex.h"
+#include "obj_mesh.h"
+#include "mesh_cache.h"
 
 #include "FilmicCurve/FilmicToneCurve.h"
 #include "FilmicCurve/FilmicColorGrading.h"
 
 #include <vector>
 #include <fstream>
+#include <string.h>
 #include <functional>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <ctype.h>
 
 static std::string models_path = "../../../data/tonemap/models/";
 static std::string texture_path = "../../../data/tonemap/models/";
 static std::string shaders_path = "../../../data/tonemap/shaders/";
 
-void AppTest::add_to_scene(const std::string &name, const IndexedMesh &mesh)
+static FilmicColorGrading::UserParams userParams; // User params are the input
+static float g_ACESGamma = 1.0f;
+
+#define MAIN_VBO_BINDING_INDEX 0
+
+// scene_vertex format, for the arena vao.
+static void setup_scene_vertex_format(GLuint vao)
 {
-    unsigned int suffix = 0;
-    std::string object_name = name;
-    while (_m_objects.find(name) != _m_objects.end())
-    {
-        object_name = name + std::to_string(suffix++);
-    }
-    
-    auto new_object = std::make_shared<DrawItem>();
-    _v_objects.push_back(new_object);
-    _m_objects[object_name] = new_object;
+    // Specify format. The offsets are for individual components, relative to the beginning of the struct.
+    glVertexArrayAttribFormat(vao, POSITION_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribFormat(vao, NORMAL_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(scene_vertex, normal));
+    glVertexArrayAttribFormat(vao, COLOR_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(scene_vertex, diffuse_color));
+    glVertexArrayAttribFormat(vao, TEXCOORD_SHADER_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, offsetof(scene_vertex, texcoords));
 
-    auto obj = _m_objects[object_name];
+    // map a vao attrib index to a shader attrib binding locations.
+    glVertexArrayAttribBinding(vao, POSITION_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
+    glVertexArrayAttribBinding(vao, NORMAL_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
+    glVertexArrayAttribBinding(vao, COLOR_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
+    glVertexArrayAttribBinding(vao, TEXCOORD_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
+
+    // enable the attribute
+    glEnableVertexArrayAttrib(vao, POSITION_SHADER_ATTRIB_INDEX);
+    glEnableVertexArrayAttrib(vao, NORMAL_SHADER_ATTRIB_INDEX);
+    glEnableVertexArrayAttrib(vao, COLOR_SHADER_ATTRIB_INDEX);
+    glEnableVertexArrayAttrib(vao, TEXCOORD_SHADER_ATTRIB_INDEX);
+}
 
+static bool has_extension(const std::string &path, const char *extension)
+{
+    const size_t length = strlen(extension);
+    if (path.size() < length)
+        return false;
+
+    return std::equal(path.end() - length, path.end(), extension, [](char a, char b) { return tolower(a) == b; });
+}
+
+static bool is_gltf_path(const std::string &path)
+{
+    return has_extension(path, ".gltf") || has_extension(path, ".glb");
+}
+
+void AppTest::add_to_scene(const std::string &name, const IndexedMesh &mesh)
+{
     //
     // compute bbox
     //
-    glm::vec3 bbox_min(FLT_MAX, FLT_MAX, FLT_MAX);
-    glm::vec3 bbox_max(FLT_MIN, FLT_MIN, FLT_MIN);
+    MeshInfo info;
+    info.nb_vertices = mesh.vertices.size();
+    info.nb_indices = mesh.indices.size();
+    info.bbox_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    info.bbox_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
     for (const auto &v : mesh.vertices)
     {
-        bbox_min = glm::min(bbox_min, v.p);
-        bbox_max = glm::max(bbox_max, v.p);
+        info.bbox_min = glm::min(info.bbox_min, v.p);
+        info.bbox_max = glm::max(info.bbox_max, v.p);
     }
-    glm::vec3 middle = (bbox_max + bbox_min) / 2.0f;
-    float scale_factor = 1.0f / glm::length(bbox_max - middle);
 
-    obj->bbox_min = bbox_min;
-    obj->bbox_max = bbox_max;
+    auto obj = new_scene_object(name);
+    obj->bbox_min = info.bbox_min;
+    obj->bbox_max = info.bbox_max;
 
-    struct vertex
-    {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec3 diffuse_color;
-        glm::vec2 texcoords;
-    };
+    obj->range = _arena.allocate(info.nb_vertices, info.nb_indices);
+    gpu_memory += info.nb_vertices * sizeof(scene_vertex) + info.nb_indices * sizeof(unsigned int);
 
-    std::vector<vertex> vertex_buffer;
-    vertex_buffer.resize(mesh.vertices.size()); // model triangulated by tinyobj
-    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    // straight from the mesh to the staging ring.
+    _upload_ring.upload(_arena.vertex_buffer(), _arena.vertex_offset(obj->range), info.nb_vertices, sizeof(scene_vertex), [&mesh](void *ptr, size_t first, size_t count)
     {
-        const auto &v_src = mesh.vertices[i];
-        auto &v_dst = vertex_buffer[i];
-        v_dst.position = v_src.p;
-        v_dst.normal = v_src.n;
-        v_dst.diffuse_color = glm::vec3(1,1,1);
-        v_dst.texcoords = v_src.uv;
-    }
-
-    const std::vector<unsigned int> &index_buffer = mesh.indices;
-
+        auto *dst = (scene_vertex*)ptr;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto &v = mesh.vertices[first + i];
+            dst[i].position = v.p;
+            dst[i].normal = v.n;
+            dst[i].diffuse_color = glm::vec3(1, 1, 1);
+            dst[i].texcoords = v.uv;
+        }
+    });
 
-    //
-    // separate this code?
-    // function that takes vertices, indices, and obj&, and builds opengl buffers.
-    //
+    _upload_ring.upload(_arena.index_buffer(), _arena.index_offset(obj->range), info.nb_indices, sizeof(unsigned int), [&mesh](void *ptr, size_t first, size_t count)
+    {
+        memcpy(ptr, mesh.indices.data() + first, count * sizeof(unsigned int));
+    });
 
+    glutils::check_error();
+}
 
-    glCreateVertexArrays(1, &obj->vao);
-    glBindVertexArray(obj->vao);
+AppTest::DrawItemSharedPtr AppTest::new_scene_object(const std::string &name)
+{
+    unsigned int suffix = 0;
+    std::string object_name = name;
+    while (_m_objects.find(object_name) != _m_objects.end())
+    {
+        object_name = name + std::to_string(suffix++);
+    }
+    
+    auto new_object = std::make_shared<DrawItem>();
+    _v_objects.push_back(new_object);
+    _m_objects[object_name] = new_object;
 
-    //
-    // vertex buffer
-    //
-#define MAIN_VBO_BINDING_INDEX 0
+    return new_object;
+}
 
-#define POSITION_SHADER_ATTRIB_INDEX 0 // THIS one is the binding location in the shader.
-#define NORMAL_SHADER_ATTRIB_INDEX 1
-#define COLOR_SHADER_ATTRIB_INDEX 2
-#define TEXCOORD_SHADER_ATTRIB_INDEX 3
+void AppTest::add_to_scene(const std::string &name, const MeshInfo &info, const MeshGenerator &generate)
+{
+    // hidden, and not in the scene, until its data is in.
+    SceneArena::range range = _arena.allocate(info.nb_vertices, info.nb_indices, false);
+
+    const GLsizeiptr vertex_buffer_size = info.nb_vertices * sizeof(scene_vertex);
+    const GLsizeiptr index_buffer_size = info.nb_indices * sizeof(index_t);
+    gpu_memory += vertex_buffer_size + index_buffer_size;
+
+    // Not through the upload ring: generators write the whole mesh at once, in parallel,
+    // so they get a direct write mapping of their range of the arena.
+    const GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    auto *vertices = (scene_vertex*)glMapNamedBufferRange(_arena.vertex_buffer(), _arena.vertex_offset(range), vertex_buffer_size, map_flags);
+    auto *indices = (index_t*)glMapNamedBufferRange(_arena.index_buffer(), _arena.index_offset(range), index_buffer_size, map_flags);
+    if (vertices && indices)
+    {
+        VertexStreams out;
+        out.position = &vertices->position.x;
+        out.normal = &vertices->normal.x;
+        out.texcoord = &vertices->texcoords.x;
+        out.position_stride = out.normal_stride = out.texcoord_stride = sizeof(scene_vertex);
+        generate(out, indices);
+
+        for (size_t i = 0; i < info.nb_vertices; ++i)
+        {
+            vertices[i].diffuse_color = glm::vec3(1, 1, 1);
+        }
+    }
+    if (vertices)
+        glUnmapNamedBuffer(_arena.vertex_buffer());
+    if (indices)
+        glUnmapNamedBuffer(_arena.index_buffer());
 
-    glCreateBuffers(1, &obj->vertex_buffer_id);
+    glutils::check_error();
 
-    // init buffer with initial data (flags == 0 -> STATIC_DRAW, no map permitted.)
-    glNamedBufferStorage(obj->vertex_buffer_id, vertex_buffer.size() * sizeof(vertex), vertex_buffer.data(), 0);
-    gpu_memory += vertex_buffer.size() * sizeof(vertex);
+    if (!vertices || !indices)
+    {
+        printf("FAILED to map the %s buffer of \"%s\", left out of the scene\n", vertices ? "index" : "vertex", name.c_str());
+        return;
+    }
 
-    // Add a VBO to the VAO.The offset is the global offset of the beginning of the first struct, not individual components.
-    glVertexArrayVertexBuffer(obj->vao, MAIN_VBO_BINDING_INDEX, obj->vertex_buffer_id, 0, sizeof(vertex));
+    _arena.set_visible(range, true);
 
-    // Specify format. The offsets are for individual components, relative to the beginning of the struct.
-    glVertexArrayAttribFormat(obj->vao, POSITION_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayAttribFormat(obj->vao, NORMAL_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
-    glVertexArrayAttribFormat(obj->vao, COLOR_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, diffuse_color));
-    glVertexArrayAttribFormat(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, offsetof(vertex, texcoords));
+    auto obj = new_scene_object(name);
+    obj->bbox_min = info.bbox_min;
+    obj->bbox_max = info.bbox_max;
+    obj->range = range;
+}
 
-    // map a vao attrib index to a shader attrib binding locations.
-    glVertexArrayAttribBinding(obj->vao, POSITION_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-    glVertexArrayAttribBinding(obj->vao, NORMAL_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-    glVertexArrayAttribBinding(obj->vao, COLOR_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-    glVertexArrayAttribBinding(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
+void AppTest::stream_to_scene(glutils::AssetStreamer::Batch &batch, const std::string &name, const MeshInfo &info, glutils::UploadRing::fill_func fill_vertices, glutils::UploadRing::fill_func fill_indices)
+{
+    // hidden until its data is in. The arena can grow before the uploads are done, so its
+    // buffers are asked again at each step.
+    SceneArena::range range = _arena.allocate(info.nb_vertices, info.nb_indices, false);
+    gpu_memory += info.nb_vertices * sizeof(scene_vertex) + info.nb_indices * sizeof(unsigned int);
 
-    // enable the attribute
-    glEnableVertexArrayAttrib(obj->vao, POSITION_SHADER_ATTRIB_INDEX);
-    glEnableVertexArrayAttrib(obj->vao, NORMAL_SHADER_ATTRIB_INDEX);
-    glEnableVertexArrayAttrib(obj->vao, COLOR_SHADER_ATTRIB_INDEX);
-    glEnableVertexArrayAttrib(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX);
+    batch.upload([this]() { return _arena.vertex_buffer(); }, _arena.vertex_offset(range), info.nb_vertices, sizeof(scene_vertex), std::move(fill_vertices));
+    batch.upload([this]() { return _arena.index_buffer(); }, _arena.index_offset(range), info.nb_indices, sizeof(unsigned int), std::move(fill_indices));
 
-    //
-    // index buffer
-    //
-    glCreateBuffers(1, &obj->index_buffer_id);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->index_buffer_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer.size() * sizeof(unsigned int), index_buffer.data(), GL_STATIC_DRAW);
-    gpu_memory += index_buffer.size() * sizeof(unsigned int);
+    batch.then([this, name, info, range]()
+    {
+        _arena.set_visible(range, true);
 
-    obj->nb_elements = index_buffer.size();
+        auto obj = new_scene_object(name);
+        obj->bbox_min = info.bbox_min;
+        obj->bbox_max = info.bbox_max;
+        obj->range = range;
+    });
+}
 
-    glBindVertexArray(0); // unbind current VAO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void AppTest::add_OBJ_to_scene(std::shared_ptr<const ObjMesh> mesh, glutils::AssetStreamer::Batch &batch)
+{
+    const auto &shapes = mesh->shapes();
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        const auto &shape = shapes[s];
+
+        MeshInfo info;
+        info.nb_vertices = shape.nb_vertices;
+        info.nb_indices = shape.nb_indices;
+        info.bbox_min = shape.bbox_min;
+        info.bbox_max = shape.bbox_max;
+        add_scene_bounds(info.bbox_min, info.bbox_max);
+
+        // convert to my own interleaved linear format, directly in the staging memory.
+        stream_to_scene(batch, shape.name, info,
+            [mesh, s](void *ptr, size_t first, size_t count) { mesh->fill_vertices(s, (scene_vertex*)ptr, first, count); },
+            [mesh, s](void *ptr, size_t first, size_t count) { mesh->fill_indices(s, (unsigned int*)ptr, first, count); });
+    }
+}
 
-    glutils::check_error();
+void AppTest::add_cached_to_scene(std::shared_ptr<const MeshCache> cache, glutils::AssetStreamer::Batch &batch)
+{
+    for (size_t s = 0; s < cache->nb_shapes(); ++s)
+    {
+        const auto &shape = cache->shape(s);
+
+        MeshInfo info;
+        info.nb_vertices = (size_t)shape.nb_vertices;
+        info.nb_indices = (size_t)shape.nb_indices;
+        info.bbox_min = glm::vec3(shape.bbox_min[0], shape.bbox_min[1], shape.bbox_min[2]);
+        info.bbox_max = glm::vec3(shape.bbox_max[0], shape.bbox_max[1], shape.bbox_max[2]);
+        add_scene_bounds(info.bbox_min, info.bbox_max);
+
+        // already in the gpu format: from the mapped file to the staging memory. The lambdas
+        // keep the file mapped until the uploads are done.
+        const char *vertices = (const char*)cache->vertices(s);
+        const uint32_t *indices = cache->indices(s);
+        stream_to_scene(batch, shape.name, info,
+            [cache, vertices](void *ptr, size_t first, size_t count) { memcpy(ptr, vertices + first * sizeof(scene_vertex), count * sizeof(scene_vertex)); },
+            [cache, indices](void *ptr, size_t first, size_t count) { memcpy(ptr, indices + first, count * sizeof(unsigned int)); });
+    }
 }
 
-void AppTest::add_OBJ_to_scene(
-    const tinyobj::attrib_t &obj_attribs, 
-    std::vector<tinyobj::shape_t> &obj_shapes,
-    std::vector<tinyobj::material_t> &obj_material,
-    bool normalize_size)
+void AppTest::stream_obj(const std::string &filename)
 {
-    for (const auto &shape : obj_shapes)
+    const bool rebuild_mesh_cache = _rebuild_mesh_cache;
+    _streamer.load(filename, [this, filename, rebuild_mesh_cache]() -> glutils::AssetStreamer::gpu_func
     {
-        const auto &object_name = shape.name;
-        if (_m_objects.find(object_name) == _m_objects.end())
+        // worker side: parsing, or mapping the cache.
+        auto cache = std::make_shared<MeshCache>();
+        if (!rebuild_mesh_cache && cache->open(filename, sizeof(scene_vertex)))
         {
-            auto new_object = std::make_shared<DrawItem>();
-            _v_objects.push_back(new_object);
-            _m_objects[object_name] = new_object;
+            printf("Loading \"%s\" from its mesh cache...\n", filename.c_str());
+            return [this, cache, filename](glutils::AssetStreamer::Batch &batch)
+            {
+                add_cached_to_scene(cache, batch);
+                on_streamed(batch, filename);
+            };
         }
 
-        auto obj = _m_objects[object_name];
-
-        //
-        // compute bbox
-        //
-        glm::vec3 bbox_min(FLT_MAX, FLT_MAX, FLT_MAX);
-        glm::vec3 bbox_max(FLT_MIN, FLT_MIN, FLT_MIN);
-        for (size_t i = 0; i < obj_attribs.vertices.size() / 3; i += 3)
+        printf("Loading \"%s\"...\n", filename.c_str());
+        auto mesh = std::make_shared<ObjMesh>();
+        if (!mesh->load(filename, models_path))
         {
-            glm::vec3 position(obj_attribs.vertices[3 * i + 0], obj_attribs.vertices[3 * i + 1], obj_attribs.vertices[3 * i + 2]);
-            bbox_min = glm::min(bbox_min, position);
-            bbox_max = glm::max(bbox_max, position);
+            return nullptr;
         }
-        glm::vec3 middle = (bbox_max + bbox_min) / 2.0f;
-        float scale_factor = 1.0f / glm::length(bbox_max - middle);
 
-        obj->bbox_min = bbox_min;
-        obj->bbox_max = bbox_max;
-
-        struct vertex
-        {
-            glm::vec3 position;
-            glm::vec3 normal;
-            glm::vec3 diffuse_color;
-            glm::vec2 texcoords;
-        };
+        printf("SUCCESS!\n");
+        mesh->print_stats();
 
-        // convert tinyobj_loader multi-index format to my own interleaved linear format
-        std::vector<vertex> vertex_buffer;
-        vertex_buffer.resize(obj_attribs.vertices.size() / 3); // model triangulated by tinyobj
-        for (size_t i = 0; i < obj_attribs.vertices.size() / 3; ++i)
+        // next launch will skip the parsing.
+        std::vector<MeshCache::shape_desc> shapes(mesh->shapes().size());
+        for (size_t s = 0; s < shapes.size(); ++s)
         {
-            vertex &v = vertex_buffer[i];
-            v.position = glm::vec3(obj_attribs.vertices[3 * i + 0], obj_attribs.vertices[3 * i + 1], obj_attribs.vertices[3 * i + 2]);
-            v.diffuse_color = glm::vec3(obj_attribs.colors[3 * i + 0], obj_attribs.colors[3 * i + 1], obj_attribs.colors[3 * i + 2]);
-            if (normalize_size)
-            {
-                v.position.xyz = scale_factor * (v.position.xyz - middle);
-            }
+            const auto &shape = mesh->shapes()[s];
+            auto &desc = shapes[s];
+            memset(&desc, 0, sizeof(desc));
+            strncpy(desc.name, shape.name.c_str(), sizeof(desc.name) - 1);
+            desc.nb_vertices = shape.nb_vertices;
+            desc.nb_indices = shape.nb_indices;
+            memcpy(desc.bbox_min, &shape.bbox_min.x, sizeof(desc.bbox_min));
+            memcpy(desc.bbox_max, &shape.bbox_max.x, sizeof(desc.bbox_max));
         }
+        bool cached = MeshCache::write(filename, sizeof(scene_vertex), shapes,
+            [&mesh](size_t s, void *ptr, size_t first, size_t count) { mesh->fill_vertices(s, (scene_vertex*)ptr, first, count); },
+            [&mesh](size_t s, void *ptr, size_t first, size_t count) { mesh->fill_indices(s, (unsigned int*)ptr, first, count); });
+        printf("Mesh cache %s: %s\n", cached ? "written" : "NOT written", MeshCache::cache_path(filename).c_str());
 
-        std::vector<unsigned int> index_buffer;
-        index_buffer.reserve(shape.mesh.indices.size());
-        for (auto index : shape.mesh.indices)
+        // GL thread: create hardware buffers for all objects in the obj, and add them to the scene container
+        return [this, mesh, filename](glutils::AssetStreamer::Batch &batch)
         {
-            if (index.vertex_index != -1)
-            {
-                int vi = index.vertex_index;
-                int ni = index.normal_index;
-                int ti = index.texcoord_index;
-
-                index_buffer.push_back(index.vertex_index);
-
-                // complete the vertex buffer with the other attributes, which may be indexed differently.
-                // we may have to duplicate these in the process.
-                vertex &v = vertex_buffer[vi];
-                if (index.normal_index != -1)
-                {
-                    v.normal = glm::vec3(obj_attribs.normals[3 * ni + 0], obj_attribs.normals[3 * ni + 1], obj_attribs.normals[3 * ni + 2]);
-                }
-                else
-                {
-                    v.normal = glm::vec3(0.0f, 1.0f, 0.0f); // default normal = UP
-                }
-
-                if (index.texcoord_index != -1)
-                {
-                    v.texcoords = glm::vec2(obj_attribs.texcoords[2 * ti + 0], obj_attribs.texcoords[2 * ti + 1]);
-                }
-                else
-                {
-                    v.texcoords = glm::vec2(0.0f, 0.0f); // default TC = 0,0
-                }
-            }
-        }
-
-
-        size_t t = offsetof(vertex, normal);
-
-        glCreateVertexArrays(1, &obj->vao);
-        glBindVertexArray(obj->vao);
-
-        //
-        // vertex buffer
-        //
-#define MAIN_VBO_BINDING_INDEX 0
-
-#define POSITION_SHADER_ATTRIB_INDEX 0 // THIS one is the binding location in the shader.
-#define NORMAL_SHADER_ATTRIB_INDEX 1
-#define COLOR_SHADER_ATTRIB_INDEX 2
-#define TEXCOORD_SHADER_ATTRIB_INDEX 3
-
-        glCreateBuffers(1, &obj->vertex_buffer_id);
-
-        // init buffer with initial data (flags == 0 -> STATIC_DRAW, no map permitted.)
-        glNamedBufferStorage(obj->vertex_buffer_id, vertex_buffer.size() * sizeof(vertex), vertex_buffer.data(), 0);
-        gpu_memory += vertex_buffer.size() * sizeof(vertex);
-
-        // Add a VBO to the VAO.The offset is the global offset of the beginning of the first struct, not individual components.
-        glVertexArrayVertexBuffer(obj->vao, MAIN_VBO_BINDING_INDEX, obj->vertex_buffer_id, 0, sizeof(vertex));
-
-        // Specify format. The offsets are for individual components, relative to the beginning of the struct.
-        glVertexArrayAttribFormat(obj->vao, POSITION_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, 0);
-        glVertexArrayAttribFormat(obj->vao, NORMAL_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
-        glVertexArrayAttribFormat(obj->vao, COLOR_SHADER_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, diffuse_color));
-        glVertexArrayAttribFormat(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, offsetof(vertex, texcoords));
-
-        // map a vao attrib index to a shader attrib binding locations.
-        glVertexArrayAttribBinding(obj->vao, POSITION_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-        glVertexArrayAttribBinding(obj->vao, NORMAL_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-        glVertexArrayAttribBinding(obj->vao, COLOR_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-        glVertexArrayAttribBinding(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX, MAIN_VBO_BINDING_INDEX);
-
-        // enable the attribute
-        glEnableVertexArrayAttrib(obj->vao, POSITION_SHADER_ATTRIB_INDEX);
-        glEnableVertexArrayAttrib(obj->vao, NORMAL_SHADER_ATTRIB_INDEX);
-        glEnableVertexArrayAttrib(obj->vao, COLOR_SHADER_ATTRIB_INDEX);
-        glEnableVertexArrayAttrib(obj->vao, TEXCOORD_SHADER_ATTRIB_INDEX);
-
-        //
-        // index buffer
-        //
-        glCreateBuffers(1, &obj->index_buffer_id);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->index_buffer_id);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer.size() * sizeof(unsigned int), index_buffer.data(), GL_STATIC_DRAW);
-        gpu_memory += index_buffer.size() * sizeof(unsigned int);
-
-        obj->nb_elements = index_buffer.size();
-
-        glBindVertexArray(0); // unbind current VAO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glutils::check_error();
-    }
+            add_OBJ_to_scene(mesh, batch);
+            on_streamed(batch, filename);
+        };
+    });
 }
 
-bool AppTest::load_obj(const char *filename)
+void AppTest::stream_gltf(const std::string &filename)
 {
-    tinyobj::attrib_t obj_attribs;
-    std::vector<tinyobj::shape_t> obj_shapes;
-    std::vector<tinyobj::material_t> obj_material;
-
-    std::string warn;
-    std::string err;
-
-    std::ifstream ifs(filename);
-    if (ifs.fail())
-    {
-        printf("FAILED to open file: %s\n", filename);
-        return false;
-    }
-    tinyobj::MaterialFileReader mtlReader(models_path);
-    printf("Loading \"%s\"...\n", filename);
-    bool ret = tinyobj::LoadObj(&obj_attribs, &obj_shapes, &obj_material, &warn, &err, &ifs, &mtlReader, true, true);
-    if (!warn.empty())
-    {
-        printf("WARN: %s\n", warn.c_str());
-    }
-    if (!err.empty())
-    {
-        printf("ERR: %s\n", err.c_str());
-    }
-    if (!ret)
-    {
-        printf("FAILED to parse: %s\n", filename);
-        return false;
-    }
-    else
+    _streamer.load(filename, [this, filename]() -> glutils::AssetStreamer::gpu_func
     {
-        printf("SUCCESS!\n");
-        // post-process tinyobj loaded model into our own format.
-
-        printf("# of vertices         = %zd\n", obj_attribs.vertices.size() / 3);
-        printf("# of normals          = %zd\n", obj_attribs.normals.size() / 3);
-        printf("# of texcoords        = %zd\n", obj_attribs.texcoords.size() / 2);
-        printf("# of shapes           = %zd\n", obj_shapes.size());
-        for (size_t s = 0; s < obj_shapes.size(); ++s)
+        printf("Loading \"%s\"...\n", filename.c_str());
+        auto scene = std::make_shared<GltfScene>();
+        if (!scene->load(filename))
         {
-            printf("   [%zd] # of indices  = %zd\n", s, obj_shapes[s].mesh.indices.size());
+            return nullptr;
         }
-        printf("# of materials        = %zd\n", obj_material.size());
 
-        // create hardware buffers for all objects in the obj, and add it to the scene container
-        add_OBJ_to_scene(obj_attribs, obj_shapes, obj_material, false);
-        printf("=> total gpu memory = %zd\n", gpu_memory);
+        printf("SUCCESS!\n");
 
-        return true;
-    }
+        // buffer views as they are, no conversion.
+        return [this, scene, filename](glutils::AssetStreamer::Batch &batch)
+        {
+            scene->upload(batch);
+            _gltf_scenes.push_back(scene);
+            gpu_memory += scene->gpu_memory();
+            if (!scene->empty())
+            {
+                add_scene_bounds(scene->bbox_min(), scene->bbox_max());
+            }
+            on_streamed(batch, filename);
+        };
+    });
 }
 
-bool AppTest::load_gltf(const char *filename)
+void AppTest::stream_environment(const std::string &filename)
 {
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
+    const utils::HdrFormat format = _env_format;
 
-    printf("Loading \"%s\"...\n", filename);
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
-    if (!warn.empty())
-    {
-        printf("WARN: %s\n", warn.c_str());
-    }
-    if (!err.empty())
-    {
-        printf("ERR: %s\n", err.c_str());
-    }
-    if (!ret)
+    // the formats this GL can sample, by HdrFormat bit: the loader runs on a worker, no GL there.
+    uint32_t sampled_formats = 0;
+    for (utils::HdrFormat f : { utils::HdrFormat::rgb32f, utils::HdrFormat::rgb9e5, utils::HdrFormat::r11g11b10f, utils::HdrFormat::rgb16f })
     {
-        printf("FAILED to parse: %s\n", filename);
-        return false;
+        if (glutils::hdr_format_supported(f))
+            sampled_formats |= 1u << (uint32_t)f;
     }
-    else
+
+    _streamer.load(filename, [this, filename, format, sampled_formats]() -> glutils::AssetStreamer::gpu_func
     {
-        printf("SUCCESS!\n");
-        printf("Content dump:\n");
-        printf("# accessors: %zd\n", model.accessors.size());
-        printf("# animations: %zd\n", model.animations.size());
-        printf("# buffers: %zd\n", model.buffers.size());
-        printf("# bufferViews: %zd\n", model.bufferViews.size());
-        printf("# materials: %zd\n", model.materials.size());
-        printf("# meshes: %zd\n", model.meshes.size());
-        printf("# nodes: %zd\n", model.nodes.size());
-        printf("# textures: %zd\n", model.textures.size());
-        printf("# images: %zd\n", model.images.size());
-        printf("# skins: %zd\n", model.skins.size());
-        printf("# samplers: %zd\n", model.samplers.size());
-        printf("# cameras: %zd\n", model.cameras.size());
-        printf("# scenes: %zd\n", model.scenes.size());
-        printf("# lights: %zd\n", model.lights.size());
-        printf("--------------------\n");
-
-        auto PrintNode = [](const tinygltf::Model &model, const tinygltf::Node &node, int nodeIdx) 
+        // mips encoded offline, or by a previous run, or here from the decoded image.
+        auto chain = std::make_shared<utils::HdrMipChain>();
+        if (has_extension(filename, ".hdrmips"))
         {
-            printf("* [%d] Node Name: %s\n", nodeIdx, node.name.c_str());
-            if (node.matrix.size() == 16)
-            {
-                printf("* [%d]   Node Matrix: %.2f %.2f %.2f %.2f ...\n", nodeIdx, node.matrix[0], node.matrix[1], node.matrix[2], node.matrix[3]);
-            }
-            else
+            if (!chain->read(filename))
             {
-                if (node.translation.size() > 0)
-                    printf("* [%d]   Node Translation: %.2f %.2f %.2f\n", nodeIdx, node.translation[0], node.translation[1], node.translation[2]);
-                if (node.rotation.size() > 0)
-                    printf("* [%d]   Node Rotate: %.2f %.2f %.2f\n", nodeIdx, node.rotation[0], node.rotation[1], node.rotation[2]);
-                if (node.scale.size() > 0)
-                    printf("* [%d]   Node Scale: %.2f %.2f %.2f\n", nodeIdx, node.scale[0], node.scale[1], node.scale[2]);
+                return nullptr;
             }
+        }
+        else if (!_texture_cache.load_hdr(filename, format, 0, chain.get()))
+        {
+            return nullptr;
+        }
 
-            if (node.mesh >= 0)
+        // a packed file, or cache entry, this GL cannot sample.
+        if (!(sampled_formats & (1u << (uint32_t)chain->format())))
+        {
+            auto unpacked = std::make_shared<utils::HdrMipChain>();
+            chain->convert(utils::HdrFormat::rgb32f, unpacked.get());
+            chain = unpacked;
+        }
+
+        return [this, chain, filename](glutils::AssetStreamer::Batch &batch)
+        {
+            const utils::HdrFormat format = chain->format();
+            const glutils::HdrGLFormat gl_format = glutils::hdr_gl_format(format);
+
+            GLuint tex;
+            glutils::create_texture_hdr(&tex, format, chain->width(), chain->height(), chain->nb_levels());
+            for (int i = 0; i < chain->nb_levels(); ++i)
             {
-                const auto &mesh = model.meshes[node.mesh];
-                printf("* [%d]   Mesh Name %s\n", nodeIdx, mesh.name.c_str());
-                printf("* [%d]   Mesh Nb Primitives %zd\n", nodeIdx, mesh.primitives.size());
+                const auto &level = chain->get_level(i);
+                batch.upload_texture_level(tex, i, level.width, level.height, gl_format.format, gl_format.type, utils::hdr_texel_size(format), chain->level_data(i));
             }
-        };
 
+            size_t rgb32f_size = chain->payload_size() / utils::hdr_texel_size(format) * utils::hdr_texel_size(utils::HdrFormat::rgb32f);
+            printf("Environment: %dx%d, %d mips, %s, %.1f MB (%.1f MB as rgb32f)\n", chain->width(), chain->height(), chain->nb_levels(),
+                utils::hdr_format_name(format), chain->payload_size() / (1024.0 * 1024.0), rgb32f_size / (1024.0 * 1024.0));
+            gpu_memory += chain->payload_size();
 
+            // replaces the placeholder once complete.
+            batch.then([this, tex, chain]()
+            {
+                glDeleteTextures(1, &_tex);
+                _tex = tex;
+            });
+            on_streamed(batch, filename);
+        };
+    });
+}
 
+void AppTest::on_streamed(glutils::AssetStreamer::Batch &batch, const std::string &name)
+{
+    // the bounds are known before the data is in: frame the whole asset right away.
+    frame_scene();
 
-        if (!model.scenes.empty() && model.defaultScene >= 0)
-        {
-            printf("Default scene:\n");
-            printf("* Name: %s\n", model.scenes[model.defaultScene].name.c_str());
-            const auto &scene = model.scenes[model.defaultScene];
-            printf("* Nb Nodes: %zd\n", scene.nodes.size());
-            for (auto nodeIdx : scene.nodes)
-            {
-                const auto &node = model.nodes[nodeIdx];
-                PrintNode(model, node, nodeIdx);
-            }
-        }
+    batch.then([this, name]()
+    {
+        printf("\"%s\" streamed in => total gpu memory = %zd\n", name.c_str(), gpu_memory);
+    });
+}
 
-        if (!model.nodes.empty())
-        {
-            printf("ALL Nodes:\n");
-            int i = 0;
-            for (const auto &node : model.nodes)
-            {
-                PrintNode(model, node, i++);
-            }
-        }
+void AppTest::add_scene_bounds(const glm::vec3 &bbox_min, const glm::vec3 &bbox_max)
+{
+    scene_bbox_min = glm::min(scene_bbox_min, bbox_min);
+    scene_bbox_max = glm::max(scene_bbox_max, bbox_max);
+}
 
-        return true;
+void AppTest::frame_scene()
+{
+    // unit sphere while nothing is known.
+    glm::vec3 scene_middle(0.0f);
+    float scene_radius = 1.0f;
+    if (!scene_bounds_empty())
+    {
+        scene_middle = (scene_bbox_max + scene_bbox_min) / 2.0f;
+        scene_radius = glm::length(scene_bbox_max - scene_middle);
     }
+
+    auto *ac = static_cast<ArcballCamera*>(_cameras[0].get());
+    ac->eye = glm::vec3(0.0f, 0.0f, 2.0f * scene_radius);
+    ac->far_plane = 5.0f * scene_radius;// 100.0f;
+    ac->update(); // build matrices
+    ac->setup(0.5f); // eye must be set.
 }
 
 bool AppTest::load_textures()
@@ -449,33 +436,23 @@ bool AppTest::load_textures()
     //
     // TEXTURES
     //
-    //glutils::load_image_hdr(&_tex, models_path + "fish_hoek_beach_2k.hdr");
-    glutils::load_image_hdr(&_tex, models_path + "venice_sunset_2k.hdr"); // HDR Max = 8384.
+    // 1 black texel until the environment map is streamed in.
+    const float black[3] = { 0.0f, 0.0f, 0.0f };
+    glutils::create_texture_hdr(&_tex, utils::HdrFormat::rgb32f, 1, 1, 1);
+    glTextureSubImage2D(_tex, 0, 0, 0, 1, 1, GL_RGB, GL_FLOAT, black);
+
+    //stream_environment(models_path + "fish_hoek_beach_2k.hdr");
+    stream_environment(_env_path);
 
     //
-    // 3D LUT
+    // 3D LUT - filled by update_tonemap_curves.
     //
-    GLenum internalFormat = GL_RGB32F;
-    GLenum format = GL_RGB;
-    GLenum type = GL_FLOAT;
-
-    glCreateTextures(GL_TEXTURE_3D, 1, &_3dlut_tex);
-    glTextureStorage3D(_3dlut_tex, 1, internalFormat, 32, 32, 32);
-    _3dlut.resize(32 * 32 * 32);
-    for(int b=0; b<32; ++b)
-    {
-        for (int g = 0; g<32; ++g)
-        {
-            for (int r = 0; r<32; ++r)
-            {
-                int idx = b * 32 * 32 + g * 32 + r;
-                _3dlut[idx] = glm::vec3(r/31.0f, g/31.0f, b/31.0f);
-            }
-        }
-    }
-    glTextureSubImage3D(_3dlut_tex, 0, 0, 0, 0, 32, 32, 32, format, type, _3dlut.data());
+    if (!_3dlut.init(LutBaker::sizes[_3dlut_size_idx]))
+        return false;
 
     // do it once
+    _regrade.set_user_params(userParams);
+    _regrade.set_aces_gamma(g_ACESGamma);
     update_tonemap_curves();
 
     //
@@ -515,27 +492,29 @@ bool AppTest::load_textures()
 
 bool AppTest::load_shaders()
 {
-    // simple
-    {
-        auto vs = utils::read_file_content(shaders_path + "simple.vert");
-        auto fs = utils::read_file_content(shaders_path + "simple.frag");
+    // every program in one build: the missing ones compile side by side.
+    _shader_ids.simple = _shader_cache.request({ { GL_VERTEX_SHADER, shaders_path + "simple.vert" }, { GL_FRAGMENT_SHADER, shaders_path + "simple.frag" } });
+    _shader_ids.fullscreen = _shader_cache.request({ { GL_VERTEX_SHADER, shaders_path + "fullscreen.vert" }, { GL_FRAGMENT_SHADER, shaders_path + "fullscreen.frag" } });
+    _shader_ids.draw_lut = _shader_cache.request({ { GL_VERTEX_SHADER, shaders_path + "draw_lut.vert" }, { GL_FRAGMENT_SHADER, shaders_path + "draw_lut.frag" } });
 
-        GLuint vs_id = glCreateShader(GL_VERTEX_SHADER);
-        GLuint fs_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-        if (!glutils::compile_shader(vs_id, vs.data(), vs.size()))
-            return false;
-        if (!glutils::compile_shader(fs_id, fs.data(), fs.size()))
-            return false;
-
-        GLuint prog_id = glCreateProgram();
-
-        if (!glutils::link_program(prog_id, vs_id, fs_id))
-            return false;
+    // one program per view, the shader has no branch on it.
+    for (int view = 0; view < nb_views; ++view)
+    {
+        const std::string defines = "#define VIEW " + std::to_string(view) + "\n";
+        _shader_ids.tonemap[view] = _shader_cache.request({ { GL_VERTEX_SHADER, shaders_path + "tonemap.vert" }, { GL_FRAGMENT_SHADER, shaders_path + "tonemap.frag" } }, defines);
+    }
 
-        glDeleteShader(vs_id);
-        glDeleteShader(fs_id);
+    const bool ok = _shader_cache.build();
+    fetch_programs();
+    return ok;
+}
 
+// The programs of the shader cache, again after a reload.
+void AppTest::fetch_programs()
+{
+    // simple
+    {
+        GLuint prog_id = _shader_cache.program(_shader_ids.simple);
         _simple_program.program_id = prog_id;
 
         _simple_program.attrib_in_position = glGetAttribLocation(prog_id, "inPosition");
@@ -550,93 +529,109 @@ bool AppTest::load_shaders()
     }
 
     // fullscreen
-    {
-        auto vs = utils::read_file_content(shaders_path + "fullscreen.vert");
-        auto fs = utils::read_file_content(shaders_path + "fullscreen.frag");
-
-        GLuint vs_id = glCreateShader(GL_VERTEX_SHADER);
-        GLuint fs_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-        if (!glutils::compile_shader(vs_id, vs.data(), vs.size()))
-            return false;
-        if (!glutils::compile_shader(fs_id, fs.data(), fs.size()))
-            return false;
-
-        GLuint prog_id = glCreateProgram();
-
-        if (!glutils::link_program(prog_id, vs_id, fs_id))
-            return false;
-
-        glDeleteShader(vs_id);
-        glDeleteShader(fs_id);
-
-        _fullscreen_program = prog_id;
-    }
+    _fullscreen_program = _shader_cache.program(_shader_ids.fullscreen);
 
     // 3dlut
     {
-        auto vs = utils::read_file_content(shaders_path + "draw_lut.vert");
-        auto fs = utils::read_file_content(shaders_path + "draw_lut.frag");
-
-        GLuint vs_id = glCreateShader(GL_VERTEX_SHADER);
-        GLuint fs_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-        if (!glutils::compile_shader(vs_id, vs.data(), vs.size()))
-            return false;
-        if (!glutils::compile_shader(fs_id, fs.data(), fs.size()))
-            return false;
-
-        GLuint prog_id = glCreateProgram();
-
-        if (!glutils::link_program(prog_id, vs_id, fs_id))
-            return false;
-
-        glDeleteShader(vs_id);
-        glDeleteShader(fs_id);
-
+        GLuint prog_id = _shader_cache.program(_shader_ids.draw_lut);
         _3dlut_program = prog_id;
 
         _uni_width = glGetUniformLocation(prog_id, "width");
         _uni_height = glGetUniformLocation(prog_id, "height");
+        _uni_draw_lut_size = glGetUniformLocation(prog_id, "lut_size");
     }
 
-    // tonemap
+    // tonemap, lut_size and auto_exposure at locations 0 and 1.
+    for (int view = 0; view < nb_views; ++view)
     {
-        auto vs = utils::read_file_content(shaders_path + "tonemap.vert");
-        auto fs = utils::read_file_content(shaders_path + "tonemap.frag");
+        _tonemap_programs[view] = _shader_cache.program(_shader_ids.tonemap[view]);
+    }
+}
 
-        GLuint vs_id = glCreateShader(GL_VERTEX_SHADER);
-        GLuint fs_id = glCreateShader(GL_FRAGMENT_SHADER);
+// Edited shaders and grading preset, picked up while running: the scene and the textures
+// stay loaded. The programs that do not build keep the previous ones.
+void AppTest::hot_reload()
+{
+    if (!_hot_reload)
+        return;
 
-        if (!glutils::compile_shader(vs_id, vs.data(), vs.size()))
-            return false;
-        if (!glutils::compile_shader(fs_id, fs.data(), fs.size()))
-            return false;
+    // the compute tonemap adds its permutations on demand.
+    if (_shader_cache.nb_programs() != _nb_watched_programs)
+    {
+        for (const auto &filename : _shader_cache.files())
+        {
+            _watcher.add(filename);
+        }
+        _nb_watched_programs = _shader_cache.nb_programs();
+    }
 
-        GLuint prog_id = glCreateProgram();
+    const auto changed = _watcher.poll();
+    if (!_preset_path.empty() && std::find(changed.begin(), changed.end(), _preset_path) != changed.end())
+    {
+        load_preset();
+    }
+    if (!changed.empty())
+    {
+        _shader_cache.reload(changed);
+    }
 
-        if (!glutils::link_program(prog_id, vs_id, fs_id))
-            return false;
+    // compiled off the frame with the parallel compile extension, swapped once done.
+    const auto swapped = _shader_cache.poll_reloads();
+    if (!swapped.empty())
+    {
+        printf("Shaders: %zu programs reloaded\n", swapped.size());
+        fetch_programs();
+        _auto_exposure.refresh_programs();
+    }
+}
 
-        glDeleteShader(vs_id);
-        glDeleteShader(fs_id);
+bool AppTest::load_preset()
+{
+    GradingPreset preset;
+    preset.user = userParams;
+    preset.aces_gamma = g_ACESGamma;
+    if (!preset.load(_preset_path))
+        return false;
 
-        _tonemap_program = prog_id;
+    // flushed with the other edits of the frame.
+    userParams = preset.user;
+    g_ACESGamma = preset.aces_gamma;
+    _regrade.set_user_params(userParams);
+    _regrade.set_aces_gamma(g_ACESGamma);
+    printf("Grading preset \"%s\" loaded\n", _preset_path.c_str());
+    return true;
+}
 
-        _uni_splitview = glGetUniformLocation(prog_id, "view");
-    }
+bool AppTest::save_preset()
+{
+    GradingPreset preset;
+    preset.user = userParams;
+    preset.aces_gamma = g_ACESGamma;
+    if (!preset.save(_preset_path))
+        return false;
 
+    printf("Grading preset \"%s\" saved\n", _preset_path.c_str());
     return true;
 }
 
 bool AppTest::recreate_framebuffers()
 {
-    // release framebuffer resources.
-    // ...
-
+    delete_framebuffers();
     return create_framebuffers();
 }
 
+void AppTest::delete_framebuffers()
+{
+    glDeleteFramebuffers(1, &_fb_hdr);
+    glDeleteTextures(1, &_fbtex_hdr_color);
+    glDeleteRenderbuffers(1, &_fbtex_hdr_depth);
+    glDeleteFramebuffers(1, &_fb_ldr);
+    glDeleteTextures(1, &_fbtex_ldr_color);
+    glDeleteRenderbuffers(1, &_fbtex_ldr_depth);
+    _fb_hdr = _fbtex_hdr_color = _fbtex_hdr_depth = 0;
+    _fb_ldr = _fbtex_ldr_color = _fbtex_ldr_depth = 0;
+}
+
 bool AppTest::create_framebuffers()
 {
     //
@@ -646,7 +641,7 @@ bool AppTest::create_framebuffers()
 
     // COLOR - use a texture (to be able to use it later for reading, has mips)
     glCreateTextures(GL_TEXTURE_2D, 1, &_fbtex_hdr_color);
-    glTextureStorage2D(_fbtex_hdr_color, 1, GL_RGBA32F, _fb_width, _fb_height);
+    glTextureStorage2D(_fbtex_hdr_color, 1, _hdr_color_format, _fb_width, _fb_height);
     glNamedFramebufferTexture(_fb_hdr, GL_COLOR_ATTACHMENT0, _fbtex_hdr_color, 0);
 
     // DEPTH - use renderbuffer = 2D,no-mips,no-read (we could use a texture, though)
@@ -658,6 +653,8 @@ bool AppTest::create_framebuffers()
     glNamedFramebufferDrawBuffer(_fb_hdr, GL_COLOR_ATTACHMENT0);
 
     glutils::check_error();
+    if (!glutils::check_framebuffer(_fb_hdr, "hdr"))
+        return false;
 
     //
     // LDR Framebuffer
@@ -666,7 +663,7 @@ bool AppTest::create_framebuffers()
 
     // COLOR - use a texture (to be able to use it later for reading, has mips)
     glCreateTextures(GL_TEXTURE_2D, 1, &_fbtex_ldr_color);
-    glTextureStorage2D(_fbtex_ldr_color, 1, GL_RGBA8, _fb_width, _fb_height);
+    glTextureStorage2D(_fbtex_ldr_color, 1, _ldr_color_format, _fb_width, _fb_height);
     glNamedFramebufferTexture(_fb_ldr, GL_COLOR_ATTACHMENT0, _fbtex_ldr_color, 0);
 
     // DEPTH - use renderbuffer = 2D,no-mips,no-read (we could use a texture, though)
@@ -678,6 +675,8 @@ bool AppTest::create_framebuffers()
     glNamedFramebufferDrawBuffer(_fb_ldr, GL_COLOR_ATTACHMENT0);
 
     glutils::check_error();
+    if (!glutils::check_framebuffer(_fb_ldr, "ldr"))
+        return false;
 
     return true;
 }
@@ -692,6 +691,28 @@ AppTest::AppTest(void * options)
         int dontrender;
         int verbose;
         int extraverbose;
+        std::string microbench;
+        int validate_exposure;
+        int rebuild_mesh_cache;
+        int upload_budget_mb;
+        std::string env_format;
+        std::string env_filename;
+        std::string texture_cache_dir;
+        std::string hdr_format;
+        std::string ldr_format;
+        int fb_bench_frames;
+        int benchmark_frames;
+        std::string camera_path;
+        std::string benchmark_out;
+        std::string headless;
+        int headless_frames;
+        std::string output;
+        std::string capture;
+        int capture_hdr;
+        int compute_tonemap;
+        int tonemap_bench_frames;
+        std::string shader_cache_dir;
+        std::string preset;
     };
     
     options_t o = *(options_t*)options;
@@ -700,60 +721,111 @@ AppTest::AppTest(void * options)
     {
         _scene_path = o.in_filename;
     }
+
+    _validate_exposure = (o.validate_exposure != 0);
+    _rebuild_mesh_cache = (o.rebuild_mesh_cache != 0);
+    _upload_budget_mb = std::max(o.upload_budget_mb, 1);
+
+    _env_path = o.env_filename.empty() ? models_path + "venice_sunset_2k.hdr" : o.env_filename; // HDR Max = 8384.
+    if (!utils::parse_hdr_format(o.env_format, &_env_format))
+    {
+        printf("Unknown environment format \"%s\", using %s\n", o.env_format.c_str(), utils::hdr_format_name(_env_format));
+    }
+    _texture_cache_dir = o.texture_cache_dir;
+    _shader_cache_dir = o.shader_cache_dir;
+    _preset_path = o.preset;
+
+    if (!glutils::parse_color_format(o.hdr_format, &_hdr_color_format))
+    {
+        printf("Unknown framebuffer format \"%s\", using %s\n", o.hdr_format.c_str(), glutils::color_format_name(_hdr_color_format));
+    }
+    if (!glutils::parse_color_format(o.ldr_format, &_ldr_color_format))
+    {
+        printf("Unknown framebuffer format \"%s\", using %s\n", o.ldr_format.c_str(), glutils::color_format_name(_ldr_color_format));
+    }
+    _fb_bench_frames = std::max(o.fb_bench_frames, 0);
+    _benchmark_frames = std::max(o.benchmark_frames, 0);
+    _camera_path_file = o.camera_path;
+    _benchmark_out = o.benchmark_out;
+    _capture_prefix = o.capture;
+    _capture_at_start = !o.capture.empty();
+    _capture_hdr = (o.capture_hdr != 0);
+    _use_compute_tonemap = (o.compute_tonemap != 0);
+    _tonemap_bench_frames = std::max(o.tonemap_bench_frames, 0);
 }
 
 bool AppTest::init(int framebuffer_width, int framebuffer_height)
 {
-    bool ret = true;
-
     _fb_width = framebuffer_width;
     _fb_height = framebuffer_height;
 
-    load_shaders();
-    load_textures();
-    create_framebuffers();
+    // staging memory for the static meshes, and their final home. The assets are loaded
+    // in the background, and come in through the ring a few MB per frame.
+    if (!_upload_ring.init())
+        return false;
+    _streamer.init(&_upload_ring, (size_t)_upload_budget_mb * 1024 * 1024);
+    _texture_cache.init(_texture_cache_dir);
+    if (!_arena.init(sizeof(scene_vertex), MAIN_VBO_BINDING_INDEX))
+        return false;
+    setup_scene_vertex_format(_arena.vao());
 
-    // OBJ
-    //if (_scene_path.empty())
-    //{
-    //    _scene_path = models_path + "bunny.obj";
-    //    //_scene_path = models_path + "sponza.obj";
-    //}
-    //ret = load_obj(_scene_path.c_str());
+    // the packed formats are core, but not always filterable (some software GLs).
+    if (!glutils::hdr_format_supported(_env_format))
+    {
+        printf("Environment format %s cannot be sampled here, falling back to rgb32f\n", utils::hdr_format_name(_env_format));
+        _env_format = utils::HdrFormat::rgb32f;
+    }
 
-    //add_to_scene("cube", make_flat_cube(1.0f, 1.0f, 1.0f));
-    //add_to_scene("sphere", make_icosphere(5, 1.0f));
-    add_to_scene("sphere", make_uvsphere(50, 100, 1.0f));
-    
-    //
-    // compute the whole scene bbox
-    //
-    scene_bbox_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
-    scene_bbox_max = glm::vec3(FLT_MIN, FLT_MIN, FLT_MIN);
-    for (const auto &obj : _v_objects)
+    // R11G11B10F is core, but only color-renderable where the driver says so.
+    if (!glutils::color_format_renderable(_hdr_color_format))
     {
-        scene_bbox_min = glm::min(scene_bbox_min, obj->bbox_min);
-        scene_bbox_max = glm::max(scene_bbox_max, obj->bbox_max);
+        printf("Framebuffer format %s is not renderable here, falling back to rgba32f\n", glutils::color_format_name(_hdr_color_format));
+        _hdr_color_format = GL_RGBA32F;
     }
-    glm::vec3 scene_middle = (scene_bbox_max + scene_bbox_min) / 2.0f;
-    float scene_radius = glm::length(scene_bbox_max - scene_middle);
-    
-    // GLTF
-    //std::string filename = "scene.gltf";
-    //bool ret = load_gltf(filename.c_str());
+    if (!glutils::color_format_renderable(_ldr_color_format))
+    {
+        printf("Framebuffer format %s is not renderable here, falling back to rgba8\n", glutils::color_format_name(_ldr_color_format));
+        _ldr_color_format = GL_RGBA8;
+    }
+
+    // loaded before the first bake, if it exists. F7 writes it.
+    if (!_preset_path.empty())
+    {
+        uint64_t size, mtime;
+        if (utils::file_info(_preset_path, &size, &mtime))
+        {
+            load_preset();
+        }
+        _watcher.add(_preset_path);
+    }
+
+    _shader_cache.init(_shader_cache_dir);
+    load_shaders();
+    if (!_compute_tonemap.init(shaders_path, _shader_cache))
+        return false;
+    if (_use_compute_tonemap)
+    {
+        _compute_tonemap.prepare(_ldr_color_format, nb_views);
+    }
+    load_textures(); // bakes the grading, for the LUT and the compute tonemap.
+    if (!create_framebuffers())
+        return false;
+
+    if (!_auto_exposure.init(shaders_path, _shader_cache))
+        return false;
+    printf("Shaders: %d from the cache, %d compiled%s, %.1f ms\n", _shader_cache.nb_loaded(), _shader_cache.nb_compiled(), _shader_cache.parallel() ? " in parallel" : "", _shader_cache.build_ms());
 
     //
-    // Camera
+    // Camera - framed again as the scene bounds come in.
     //
+    scene_bbox_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    scene_bbox_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
     auto ac = std::make_unique<ArcballCamera>();
     ac->viewport = glm::ivec4(0, 0, _fb_width, _fb_height); // full framebuffer viewport
-    ac->eye = glm::vec3(0.0f, 0.0f, 2.0f * scene_radius);
     ac->target = glm::vec3(0, 0, 0);
     ac->near_plane = 1.0f;
-    ac->far_plane = 5.0f * scene_radius;// 100.0f;
     ac->fovy_degrees = 45.0f;
-    ac->update(); // build initial matrices
-    ac->setup(0.5f); // eye must be set.
     _cameras.emplace_back(std::move(ac));
 
     auto fc = std::make_unique<FpsCamera>();
@@ -770,177 +842,733 @@ bool AppTest::init(int framebuffer_width, int framebuffer_height)
     fc->update(); // build initial matrices
     _cameras.emplace_back(std::move(fc));
 
-    // VAO for fullscreen pass
-    glCreateVertexArrays(1, &_dummy_vao);
+    // OBJ
+    //if (_scene_path.empty())
+    //{
+    //    _scene_path = models_path + "bunny.obj";
+    //    //_scene_path = models_path + "sponza.obj";
+    //}
+    if (is_gltf_path(_scene_path))
+    {
+        stream_gltf(_scene_path);
+    }
+    else if (!_scene_path.empty())
+    {
+        stream_obj(_scene_path);
+    }
+    else
+    {
+        //add_to_scene("cube", make_flat_cube(1.0f, 1.0f, 1.0f));
+        //add_to_scene("sphere", make_icosphere(5, 1.0f));
+        auto info = uvsphere_info(50, 100, 1.0f);
+        add_to_scene("sphere", info, [](const VertexStreams &out, index_t *indices)
+        {
+            make_uvsphere(out, indices, 50, 100, 1.0f);
+        });
+        add_scene_bounds(info.bbox_min, info.bbox_max);
+    }
+    frame_scene();
+
+    // VAO for fullscreen pass
+    glCreateVertexArrays(1, &_dummy_vao);
+
+    if (_fb_bench_frames > 0)
+    {
+        start_fb_bench();
+    }
+
+    // recorded path, or an orbit once the scene bounds are known.
+    if (_benchmark_frames > 0 && !_camera_path_file.empty() && !_camera_path.load(_camera_path_file))
+        return false;
+
+    return true;
+}
+
+void AppTest::shutdown()
+{
+    // nothing in flight anymore.
+    _streamer.shutdown();
+    stop_capture();
+    _ldr_capture.shutdown();
+    _hdr_capture.shutdown();
+    if (_texture_cache.enabled())
+    {
+        printf("Texture cache: %zu hits, %zu misses, %.1f MB of decoding saved\n", _texture_cache.nb_hits(), _texture_cache.nb_misses(), _texture_cache.bytes_saved() / (1024.0 * 1024.0));
+    }
+
+    // release buffers
+    _3dlut.shutdown();
+    _compute_tonemap.shutdown();
+    _auto_exposure.shutdown();
+    _shader_cache.shutdown(); // every program.
+    _watcher.clear();
+    for (auto &scene : _gltf_scenes)
+    {
+        scene->shutdown();
+    }
+    _gltf_scenes.clear();
+    _upload_ring.shutdown();
+    _arena.shutdown();
+    delete_framebuffers();
+    glutils::profiler().shutdown();
+    for (auto &config : _fb_bench)
+    {
+        glDeleteQueries((GLsizei)config.queries.size(), config.queries.data());
+    }
+    _fb_bench.clear();
+}
+
+void AppTest::update_camera(float dt)
+{
+    Camera *cm = current_camera();
+    if (!cm)
+    {
+        return;
+    }
+
+    ImGuiIO& io = ImGui::GetIO();
+    bool left = io.KeysDown[GLFW_KEY_A];
+    bool right = io.KeysDown[GLFW_KEY_D];
+    bool forward = io.KeysDown[GLFW_KEY_W];
+    bool backward = io.KeysDown[GLFW_KEY_S];
+    bool up = io.KeysDown[GLFW_KEY_PAGE_UP];
+    bool down = io.KeysDown[GLFW_KEY_PAGE_DOWN];
+
+    glm::vec3 direction(0.0f);
+    direction.x = !(left ^ right) ? 0.0f : ( left ? -1.0f : 1.0f);
+    direction.y = !(down ^ up) ? 0.0f : (down ? -1.0f : 1.0f);
+    direction.z = !(forward ^ backward) ? 0.0f : (forward ? -1.0f : 1.0f);
+
+    direction *= dt;
+    cm->translate(direction);
+
+    cm->update(); // rebuild matrices
+
+    cm->viewport = glm::ivec4(0, 0, _fb_width, _fb_height);
+}
+
+void AppTest::run(float dt)
+{
+    // fixed time step: the benchmark frames are the same from a run to the next.
+    const float real_dt = dt;
+    if (_benchmark_frames > 0)
+    {
+        dt = benchmark_dt;
+    }
+
+    static float accum = 0.0f;
+    accum += dt;
+
+    Camera *cm = current_camera();
+    if (!cm)
+        return;
+    
+    //
+    // update
+    //
+    {
+        glutils::ProfileScope scope("update");
+        update_camera(dt); // reads key states and translates/updates camera.
+        hot_reload();
+        update_tonemap_curves(); // only what the edits of the last frame touched.
+        _streamer.update(); // what the loaders finished, and this frame's share of the uploads.
+        benchmark_frame(real_dt);
+        record_camera(dt);
+        if (_capture_at_start && _streamer.idle())
+        {
+            _capture_at_start = false;
+            start_capture();
+        }
+    }
+
+    const bool fb_bench_timed = fb_bench_begin_frame();
+
+    //
+    // DRAW scene in HDR framebuffer.
+    //
+    glBindFramebuffer(GL_FRAMEBUFFER, _fb_hdr);
+    {
+        glutils::ProfileScope scope("hdr");
+        glViewport(0, 0, _fb_width, _fb_height);
+
+        // Clear
+        const GLfloat clear_color[] = {
+            (float)std::sin(accum) * 0.5f + 0.5f,
+            (float)std::cos(accum) * 0.5f + 0.5f,
+            0.0f, 1.0f };
+        glClearBufferfv(GL_COLOR, 0, clear_color);
+        glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+        // Background texture.
+        {
+            glutils::ProfileScope scope("background");
+            glDisable(GL_DEPTH_TEST);
+            glBindSampler(0, _sampler); // bind the sampler to the texture unit 0
+            glBindTextureUnit(0, _tex); // bind the texture object to the texture unit 0
+            glUseProgram(_fullscreen_program);
+            glBindVertexArray(_dummy_vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glUseProgram(0);
+        }
+
+#if 1
+        // Scene content
+        glutils::ProfileScope scene_scope("scene");
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(_simple_program.program_id);
+
+        // camera
+        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_view, 1, GL_FALSE, glm::value_ptr(cm->view));
+        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_proj, 1, GL_FALSE, glm::value_ptr(cm->proj));
+
+        // global scene transform
+        glm::vec3 scene_middle = scene_bounds_empty() ? glm::vec3(0.0f) : (scene_bbox_max + scene_bbox_min) / 2.0f;
+        glm::mat4 model(1);
+        model = glm::translate(model, -scene_middle);
+        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_model, 1, GL_FALSE, glm::value_ptr(model));
+
+        // texture
+        glBindSampler(0, _sampler); // bind the sampler to the texture unit 0
+        glBindTextureUnit(0, _tex); // bind the texture object to the texture unit 0
+
+        if (_multi_draw_indirect)
+        {
+            // whole scene in one call.
+            _arena.draw();
+        }
+        else
+        {
+            glBindVertexArray(_arena.vao());
+            for (const auto &obj : _v_objects)
+            {
+                //glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_model, 1, GL_FALSE, glm::value_ptr(model));
+                const auto &r = obj->range;
+                glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)r.nb_indices, GL_UNSIGNED_INT, (void*)_arena.index_offset(r), (GLint)r.base_vertex);
+            }
+        }
+
+        glBindVertexArray(0);
+
+        // glTF meshes, with their node transforms.
+        for (const auto &scene : _gltf_scenes)
+        {
+            scene->draw(_simple_program.program_id, _simple_program.uni_model, model, _tex, _sampler);
+        }
+
+        glUseProgram(0);
+        glDisable(GL_DEPTH_TEST);
+#endif
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    //
+    // Auto exposure - READS hdr - WRITES exposure SSBO
+    //
+    if (_validate_exposure && ++_nb_validation_frames == 3)
+    {
+        // a few frames in, so the hdr framebuffer holds the scene.
+        bool ok = _auto_exposure.validate(_fbtex_hdr_color, _fb_width, _fb_height);
+        _exit_code = ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        _should_exit = true;
+    }
+
+    if (_use_auto_exposure)
+    {
+        glutils::ProfileScope scope("auto exposure");
+        _auto_exposure.update(_fbtex_hdr_color, _fb_width, _fb_height, dt);
+    }
+
+    tonemap_bench();
+
+    //
+    // Tone-Mapping - READS hdr - WRITES ldr, or the screen when nothing reads the ldr after
+    //
+    const bool direct = present_direct();
+    {
+        glutils::ProfileScope scope("tonemap");
+        if (_use_compute_tonemap)
+        {
+            _auto_exposure.bind_result();
+            _compute_tonemap.dispatch(_fbtex_hdr_color, _fbtex_ldr_color, _ldr_color_format, _fb_width, _fb_height, _current_view, _use_auto_exposure);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, direct ? 0 : _fb_ldr);
+            draw_tonemap(_current_view);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+    }
+
+    //
+    // Capture - READS ldr (and hdr), the files are written in the background
+    //
+    if (_ldr_capture.active())
+    {
+        glutils::ProfileScope scope("capture");
+        _ldr_capture.capture(_fbtex_ldr_color, _fb_width, _fb_height);
+        _hdr_capture.capture(_fbtex_hdr_color, _fb_width, _fb_height);
+    }
+
+    //
+    // copy the LDR framebuffer to the screen, when the tonemap did not write there.
+    //
+    if (!direct && !_headless)
+    {
+        glutils::ProfileScope scope("blit");
+        glBlitNamedFramebuffer(_fb_ldr, 0, 0, 0, _fb_width, _fb_height, 0, 0, _fb_width, _fb_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    fb_bench_end_frame(fb_bench_timed);
+
+    // Draw 3d LUT - over the tonemapped image, same framebuffer
+    if(_draw3dlut && !_headless)
+    {
+        glutils::ProfileScope scope("lut overlay");
+        glBindSampler(1, _linear_sampler);
+        glBindTextureUnit(1, _3dlut.texture());
+        glUseProgram(_3dlut_program);
+        glUniform1i(_uni_width, _fb_width);
+        glUniform1i(_uni_height, _fb_height);
+        glUniform1i(_uni_draw_lut_size, _3dlut.size());
+        glBindVertexArray(_dummy_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    //
+    // GUI - over the default framebuffer
+    //
+    glutils::ProfileScope scope("gui");
+    do_gui();
+    glutils::profiler().draw_overlay();
+}
+
+// Fragment tonemap, with the 3D LUT, into the bound framebuffer.
+void AppTest::draw_tonemap(int view)
+{
+    glBindSampler(0, _linear_sampler); // bind the sampler to the texture unit 0
+    glBindTextureUnit(0, _fbtex_hdr_color); // bind the texture object to the texture unit 0
+
+    glBindSampler(1, _linear_sampler);
+    glBindTextureUnit(1, _3dlut.texture());
+
+    glUseProgram(_tonemap_programs[view]);
+    glUniform1i(0, _3dlut.size()); // lut_size
+    glUniform1i(1, _use_auto_exposure ? 1 : 0); // auto_exposure
+    _auto_exposure.bind_result();
+    glBindVertexArray(_dummy_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+//
+// Benchmark: once everything is loaded, plays the camera path over the warmup and the
+// measured frames, with a fixed time step. The profiler gives the cpu and gpu time of each
+// measured frame, the main loop its wall time.
+//
+static const int benchmark_warmup = 30;
+
+void AppTest::benchmark_frame(float real_dt)
+{
+    if (_benchmark_frames == 0 || !_streamer.idle())
+        return;
+
+    const int nb_frames = benchmark_warmup + _benchmark_frames;
+    if (_benchmark_frame < 0)
+    {
+        glm::vec3 scene_middle = scene_bounds_empty() ? glm::vec3(0.0f) : (scene_bbox_max + scene_bbox_min) / 2.0f;
+        float scene_radius = scene_bounds_empty() ? 1.0f : glm::length(scene_bbox_max - scene_middle);
+        if (_camera_path.empty())
+        {
+            _camera_path = CameraPath::orbit(2.0f * scene_radius, (nb_frames - 1) * benchmark_dt);
+        }
+
+        _current_camera_idx = 1; // fps camera, looks at the path targets.
+        Camera *cm = current_camera();
+        cm->near_plane = 0.01f * scene_radius;
+        cm->far_plane = 10.0f * scene_radius;
+        glutils::profiler().enabled = true;
+        _benchmark_frame = 0;
+    }
+
+    const int frame = _benchmark_frame++;
+
+    // the whole path, whatever the number of frames.
+    auto key = _camera_path.sample(_camera_path.duration() * frame / std::max(nb_frames - 1, 1));
+    auto *fc = static_cast<FpsCamera*>(current_camera());
+    fc->eye = key.eye;
+    fc->dir = glm::normalize(key.target - key.eye);
+    fc->fovy_degrees = key.fovy_degrees;
+    fc->update();
+
+    // frames [warmup, warmup + N) are recorded by the profiler. The dt of a frame is the wall
+    // time of the previous one.
+    if (frame == benchmark_warmup - 1)
+    {
+        glutils::profiler().clear_frame_times();
+        glutils::profiler().record_frame_times(true);
+    }
+    if (frame > benchmark_warmup)
+    {
+        _benchmark.frame_ms.push_back(real_dt * 1000.0);
+    }
+    if (frame == nb_frames - 1)
+    {
+        glutils::profiler().record_frame_times(false);
+    }
+    if (frame < nb_frames)
+        return;
+
+    glutils::profiler().flush();
+    for (const auto &t : glutils::profiler().frame_times())
+    {
+        _benchmark.cpu_ms.push_back(t.cpu_ms);
+        _benchmark.gpu_ms.push_back(t.gpu_ms);
+    }
 
-    return ret;
+    _benchmark.scene = _scene_path.empty() ? "uvsphere" : _scene_path;
+    _benchmark.camera_path = _camera_path_file;
+    _benchmark.gl_vendor = (const char*)glGetString(GL_VENDOR);
+    _benchmark.gl_renderer = (const char*)glGetString(GL_RENDERER);
+    _benchmark.gl_version = (const char*)glGetString(GL_VERSION);
+    _benchmark.hdr_format = glutils::color_format_name(_hdr_color_format);
+    _benchmark.ldr_format = glutils::color_format_name(_ldr_color_format);
+    _benchmark.width = _fb_width;
+    _benchmark.height = _fb_height;
+    _benchmark.nb_warmup_frames = benchmark_warmup;
+    _benchmark.print();
+
+    bool ok = _benchmark.write_json(_benchmark_out);
+    _exit_code = ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    _should_exit = true;
 }
 
-void AppTest::shutdown()
+void AppTest::record_camera(float dt)
 {
-    // release shaders
-    glDeleteProgram(_simple_program.program_id);
-
-    // release buffers
+    if (!_recording_camera)
+        return;
 
-    // release vao
-    for (const auto &obj : _v_objects)
-    {
-        glDeleteVertexArrays(1, &obj->vao);
-    }
+    _recording_time += dt;
+    _recorded_path.add(_recording_time, *current_camera());
 }
 
-void AppTest::update_camera(float dt)
+void AppTest::toggle_camera_recording()
 {
-    Camera *cm = current_camera();
-    if (!cm)
+    _recording_camera = !_recording_camera;
+    if (_recording_camera)
     {
+        _recorded_path.clear();
+        _recording_time = 0.0f;
+        printf("Recording the camera path, F5 to stop\n");
         return;
     }
 
-    ImGuiIO& io = ImGui::GetIO();
-    bool left = io.KeysDown[GLFW_KEY_A];
-    bool right = io.KeysDown[GLFW_KEY_D];
-    bool forward = io.KeysDown[GLFW_KEY_W];
-    bool backward = io.KeysDown[GLFW_KEY_S];
-    bool up = io.KeysDown[GLFW_KEY_PAGE_UP];
-    bool down = io.KeysDown[GLFW_KEY_PAGE_DOWN];
+    const std::string filename = _camera_path_file.empty() ? "camera_path.txt" : _camera_path_file;
+    if (_recorded_path.save(filename))
+    {
+        printf("Camera path: %zu keys, %.1f s, written to %s\n", _recorded_path.nb_keys(), _recorded_path.duration(), filename.c_str());
+    }
+}
 
-    glm::vec3 direction(0.0f);
-    direction.x = !(left ^ right) ? 0.0f : ( left ? -1.0f : 1.0f);
-    direction.y = !(down ^ up) ? 0.0f : (down ? -1.0f : 1.0f);
-    direction.z = !(forward ^ backward) ? 0.0f : (forward ? -1.0f : 1.0f);
+//
+// The tonemap writes straight to the default framebuffer unless something reads the ldr
+// framebuffer after it: the headless output, the capture, or the formats benchmark (which
+// measures the ldr formats). Saves a full screen read and write per frame. The compute
+// tonemap cannot write the default framebuffer, it always goes through the blit.
+//
+bool AppTest::present_direct() const
+{
+    return _present_direct && !_use_compute_tonemap && !_headless && !_ldr_capture.active() && _fb_bench.empty();
+}
 
-    direction *= dt;
-    cm->translate(direction);
+//
+// Image sequence: the ldr framebuffer of every frame, and the hdr one with --capture-hdr, read
+// back and written by FrameCapture without waiting for the gpu.
+//
+void AppTest::start_capture()
+{
+    if (_capture_prefix.empty())
+    {
+        _capture_prefix = "capture/frame_";
+    }
 
-    cm->update(); // rebuild matrices
+    // one level, like the texture cache.
+    const size_t slash = _capture_prefix.find_last_of("/\\");
+    if (slash != std::string::npos && slash > 0)
+    {
+        utils::make_directory(_capture_prefix.substr(0, slash));
+    }
 
-    cm->viewport = glm::ivec4(0, 0, _fb_width, _fb_height);
+    _ldr_capture.start(_capture_prefix, glutils::FrameCapture::Format::png);
+    if (_capture_hdr)
+    {
+        _hdr_capture.start(_capture_prefix, glutils::FrameCapture::Format::hdr);
+    }
+    printf("Capturing frames to %s*, F6 to stop\n", _capture_prefix.c_str());
 }
 
-void AppTest::run(float dt)
+void AppTest::stop_capture()
 {
-    static float accum = 0.0f;
-    accum += dt;
+    if (!_ldr_capture.active())
+        return;
 
-    Camera *cm = current_camera();
-    if (!cm)
+    _ldr_capture.stop();
+    _hdr_capture.stop();
+    printf("Capture: %d frames written (%d hdr), %d stalls, %.3f ms per frame at most\n",
+        _ldr_capture.nb_written(), _hdr_capture.nb_written(), _ldr_capture.nb_stalls() + _hdr_capture.nb_stalls(), std::max(_ldr_capture.max_ms(), _hdr_capture.max_ms()));
+}
+
+//
+// Tonemap benchmark: the fragment pass sampling the 3D LUT, at each LUT size, against the
+// compute pass evaluating the filmic grading analytically. Same hdr frame, filmic only view.
+// The analytic result is the reference: the differences are the error of the LUTs. The
+// pixels the LUT clips at its white point are left out, the analytic path has no such limit.
+//
+static const int tonemap_bench_warmup = 10; // frames once loaded, the exposure settles.
+static const float tonemap_bench_white_point = 4.0f; // of the LUT, as in tonemap.frag.
+
+void AppTest::tonemap_bench()
+{
+    if (_tonemap_bench_frames == 0 || !_streamer.idle() || ++_tonemap_bench_frame != tonemap_bench_warmup)
         return;
-    
-    //
-    // update
-    //
-    update_camera(dt); // reads key states and translates/updates camera.
 
-    //
-    // DRAW scene in HDR framebuffer.
-    //
-    glBindFramebuffer(GL_FRAMEBUFFER, _fb_hdr);
+    const int view = 3; // Filmic LUT Only
+    const size_t nb_pixels = (size_t)_fb_width * _fb_height;
+
+    // median gpu time of _tonemap_bench_frames passes, in ms.
+    auto time_pass = [this](const std::function<void()> &pass)
     {
-        glViewport(0, 0, _fb_width, _fb_height);
+        std::vector<GLuint> queries(_tonemap_bench_frames);
+        glCreateQueries(GL_TIME_ELAPSED, _tonemap_bench_frames, queries.data());
+        for (GLuint query : queries)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            pass();
+            glEndQuery(GL_TIME_ELAPSED);
+        }
 
-        // Clear
-        const GLfloat clear_color[] = {
-            (float)std::sin(accum) * 0.5f + 0.5f,
-            (float)std::cos(accum) * 0.5f + 0.5f,
-            0.0f, 1.0f };
-        glClearBufferfv(GL_COLOR, 0, clear_color);
-        glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+        std::vector<double> ms;
+        for (GLuint query : queries)
+        {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            ms.push_back(ns / 1000000.0);
+        }
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+        std::sort(ms.begin(), ms.end());
+        return ms[ms.size() / 2];
+    };
 
-        // Background texture.
-        glDisable(GL_DEPTH_TEST);
-        glBindSampler(0, _sampler); // bind the sampler to the texture unit 0
-        glBindTextureUnit(0, _tex); // bind the texture object to the texture unit 0
-        glUseProgram(_fullscreen_program);
-        glBindVertexArray(_dummy_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
-        glUseProgram(0);
+    auto read_ldr = [this, nb_pixels]()
+    {
+        std::vector<float> pixels(nb_pixels * 4);
+        glGetTextureImage(_fbtex_ldr_color, 0, GL_RGBA, GL_FLOAT, (GLsizei)(pixels.size() * sizeof(float)), pixels.data());
+        return pixels;
+    };
 
-#if 1
-        // Scene content
-        glEnable(GL_DEPTH_TEST);
-        glUseProgram(_simple_program.program_id);
+    // reference
+    const double analytic_ms = time_pass([this, view]()
+    {
+        _auto_exposure.bind_result();
+        _compute_tonemap.dispatch(_fbtex_hdr_color, _fbtex_ldr_color, _ldr_color_format, _fb_width, _fb_height, view, _use_auto_exposure);
+    });
+    const std::vector<float> reference = read_ldr();
+
+    // the exposed hdr input, as the fragment pass sees it.
+    std::vector<char> clipped(nb_pixels, 0);
+    size_t nb_clipped = 0;
+    {
+        std::vector<float> hdr(nb_pixels * 4);
+        glGetTextureImage(_fbtex_hdr_color, 0, GL_RGBA, GL_FLOAT, (GLsizei)(hdr.size() * sizeof(float)), hdr.data());
+        const float exposure = _use_auto_exposure ? _auto_exposure.read_result().exposure : 1.0f; // the one both passes use.
+        for (size_t p = 0; p < nb_pixels; ++p)
+        {
+            const float *c = &hdr[4 * p];
+            clipped[p] = std::max(std::max(exposure * c[0], exposure * c[1]), exposure * c[2]) > tonemap_bench_white_point;
+            nb_clipped += clipped[p];
+        }
+    }
+    const size_t nb_compared = nb_pixels - nb_clipped;
 
-        // camera
-        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_view, 1, GL_FALSE, glm::value_ptr(cm->view));
-        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_proj, 1, GL_FALSE, glm::value_ptr(cm->proj));
+    const double mpixels = nb_pixels / 1000000.0;
+    printf("Tonemap, %dx%d, %s, median of %d passes, errors in 8 bits steps against the analytic grading:\n",
+        _fb_width, _fb_height, glutils::color_format_name(_ldr_color_format), _tonemap_bench_frames);
+    printf("%.2f%% of the pixels above the LUT white point (%.0f), not in the errors\n", 100.0 * nb_clipped / nb_pixels, tonemap_bench_white_point);
+    printf("%-24s %9s %10s %8s %9s\n", "path", "median ms", "Mpixels/s", "max err", "mean err");
+    printf("%-24s %9.3f %10.1f %8s %9s\n", "compute, analytic", analytic_ms, mpixels / analytic_ms * 1000.0, "-", "-");
 
-        // global scene transform
-        glm::vec3 scene_middle = (scene_bbox_max + scene_bbox_min) / 2.0f;
-        glm::mat4 model(1);
-        model = glm::translate(model, -scene_middle);
-        glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_model, 1, GL_FALSE, glm::value_ptr(model));
+    for (int size : LutBaker::sizes)
+    {
+        _3dlut.init(size);
+        _3dlut.bake(_regrade.baked_params(), tonemap_bench_white_point);
 
-        // texture
-        glBindSampler(0, _sampler); // bind the sampler to the texture unit 0
-        glBindTextureUnit(0, _tex); // bind the texture object to the texture unit 0
+        glBindFramebuffer(GL_FRAMEBUFFER, _fb_ldr);
+        const double lut_ms = time_pass([this, view]() { draw_tonemap(view); });
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        const std::vector<float> pixels = read_ldr();
 
-        for (const auto &obj : _v_objects)
+        double sum = 0.0;
+        float max_error = 0.0f;
+        for (size_t i = 0; i < pixels.size(); ++i)
         {
-            //glProgramUniformMatrix4fv(_simple_program.program_id, _simple_program.uni_model, 1, GL_FALSE, glm::value_ptr(model));
-            glBindVertexArray(obj->vao);
-            glDrawElements(GL_TRIANGLES, obj->nb_elements, GL_UNSIGNED_INT, 0);
+            if ((i & 3) == 3 || clipped[i / 4])
+                continue; // alpha, or beyond the LUT
+
+            float error = std::abs(pixels[i] - reference[i]) * 255.0f;
+            max_error = std::max(max_error, error);
+            sum += error;
         }
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDisable(GL_DEPTH_TEST);
-#endif
+        char name[32];
+        snprintf(name, sizeof(name), "fragment, LUT %d^3", size);
+        printf("%-24s %9.3f %10.1f %8.2f %9.4f\n", name, lut_ms, mpixels / lut_ms * 1000.0, max_error, nb_compared ? sum / (nb_compared * 3) : 0.0);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    //
-    // Tone-Mapping - READS hdr - WRITES ldr
-    //
-    glBindFramebuffer(GL_FRAMEBUFFER, _fb_ldr);
+    _exit_code = EXIT_SUCCESS;
+    _should_exit = true;
+}
+
+//
+// Framebuffer formats benchmark: every pair of hdr/ldr formats renders the same frames, timed
+// on the gpu from the scene to the copy on screen. The ldr image of each pair is compared to
+// the one of the first pair, the most precise.
+//
+static const int fb_bench_warmup = 10; // frames, after a format change.
+static const float fb_bench_tolerance = 1.0f; // max error, in 8 bits steps.
+
+void AppTest::start_fb_bench()
+{
+    static const GLenum hdr_formats[] = { GL_RGBA32F, GL_RGBA16F, GL_R11F_G11F_B10F };
+    static const GLenum ldr_formats[] = { GL_RGBA16F, GL_RGB10_A2, GL_RGBA8 };
+
+    for (GLenum hdr : hdr_formats)
     {
-        glBindSampler(0, _linear_sampler); // bind the sampler to the texture unit 0
-        glBindTextureUnit(0, _fbtex_hdr_color); // bind the texture object to the texture unit 0
+        for (GLenum ldr : ldr_formats)
+        {
+            if (!glutils::color_format_renderable(hdr) || !glutils::color_format_renderable(ldr))
+            {
+                printf("Framebuffer benchmark: skipping %s/%s, not renderable\n", glutils::color_format_name(hdr), glutils::color_format_name(ldr));
+                continue;
+            }
 
-        glBindSampler(1, _linear_sampler);
-        glBindTextureUnit(1, _3dlut_tex);
+            fb_bench_config config;
+            config.hdr_format = hdr;
+            config.ldr_format = ldr;
+            config.queries.resize(_fb_bench_frames);
+            glCreateQueries(GL_TIME_ELAPSED, _fb_bench_frames, config.queries.data());
+            _fb_bench.push_back(std::move(config));
+        }
+    }
 
-        glUseProgram(_tonemap_program);
-        glUniform1i(_uni_splitview, _current_view);
-        glBindVertexArray(_dummy_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
+    if (_fb_bench.empty())
+    {
+        printf("Framebuffer benchmark: no renderable format pair\n");
+        _exit_code = EXIT_FAILURE;
+        _should_exit = true;
+        return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    //
-    // fullscreen pass - copy the LDR framebuffer to the screen (could use a blit)
-    //
+    // the exposure would adapt differently for each pair.
+    _use_auto_exposure = false;
+
+    _fb_bench_config = 0;
+    _fb_bench_frame = 0;
+    _hdr_color_format = _fb_bench[0].hdr_format;
+    _ldr_color_format = _fb_bench[0].ldr_format;
+    recreate_framebuffers();
+}
+
+bool AppTest::fb_bench_begin_frame()
+{
+    // once everything is loaded, and the new framebuffers are warm.
+    if (_fb_bench.empty() || !_streamer.idle() || _fb_bench_frame < fb_bench_warmup)
+        return false;
+
+    glBeginQuery(GL_TIME_ELAPSED, _fb_bench[_fb_bench_config].queries[_fb_bench_frame - fb_bench_warmup]);
+    return true;
+}
+
+void AppTest::fb_bench_end_frame(bool timed)
+{
+    if (_fb_bench.empty() || !_streamer.idle())
+        return;
+
+    if (timed)
     {
-        glBindSampler(0, _nearest_sampler); // bind the sampler to the texture unit 0
-        glBindTextureUnit(0, _fbtex_ldr_color); // bind the texture object to the texture unit 0
-        glUseProgram(_fullscreen_program);
-        glBindVertexArray(_dummy_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
-        glUseProgram(0);
+        glEndQuery(GL_TIME_ELAPSED);
     }
+    if (++_fb_bench_frame < fb_bench_warmup + _fb_bench_frames)
+        return;
+
+    auto &config = _fb_bench[_fb_bench_config];
 
-    // Draw 3d LUT
-    if(_draw3dlut)
+    // waits for the last frames.
+    std::vector<double> ms;
+    for (GLuint query : config.queries)
     {
-        glBindSampler(1, _linear_sampler);
-        glBindTextureUnit(1, _3dlut_tex);
-        glUseProgram(_3dlut_program);
-        glUniform1i(_uni_width, _fb_width);
-        glUniform1i(_uni_height, _fb_height);
-        glBindVertexArray(_dummy_vao);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glUseProgram(0);
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        ms.push_back(ns / 1000000.0);
+    }
+    std::sort(ms.begin(), ms.end());
+    config.min_ms = ms.front();
+    config.median_ms = ms[ms.size() / 2];
+    config.avg_ms = std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    config.mb_per_frame = (double)_fb_width * _fb_height * (glutils::color_format_size(config.hdr_format) + glutils::color_format_size(config.ldr_format)) / (1024.0 * 1024.0);
+
+    // quality, against the first pair.
+    std::vector<float> pixels((size_t)_fb_width * _fb_height * 4);
+    glGetTextureImage(_fbtex_ldr_color, 0, GL_RGBA, GL_FLOAT, (GLsizei)(pixels.size() * sizeof(float)), pixels.data());
+    if (_fb_bench_config == 0)
+    {
+        _fb_bench_reference.swap(pixels);
+    }
+    else if (pixels.size() == _fb_bench_reference.size())
+    {
+        double sum = 0.0;
+        float max_error = 0.0f;
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            if ((i & 3) == 3)
+                continue; // alpha
+
+            float error = std::abs(pixels[i] - _fb_bench_reference[i]) * 255.0f;
+            max_error = std::max(max_error, error);
+            sum += error;
+        }
+        config.max_error = max_error;
+        config.mean_error = (float)(sum / (pixels.size() / 4 * 3));
     }
 
-    //
-    // GUI - over the default framebuffer
-    //
-    do_gui();
+    // next pair.
+    if (++_fb_bench_config < _fb_bench.size())
+    {
+        _fb_bench_frame = 0;
+        _hdr_color_format = _fb_bench[_fb_bench_config].hdr_format;
+        _ldr_color_format = _fb_bench[_fb_bench_config].ldr_format;
+        recreate_framebuffers();
+        return;
+    }
+
+    printf("Framebuffer formats, %dx%d, %d frames each, gpu time from the scene to the screen copy:\n", _fb_width, _fb_height, _fb_bench_frames);
+    printf("%-11s %-11s %9s %8s %10s %8s %8s %9s\n", "hdr", "ldr", "MB/frame", "min ms", "median ms", "avg ms", "max err", "mean err");
+    const fb_bench_config *cheapest = nullptr;
+    for (const auto &c : _fb_bench)
+    {
+        printf("%-11s %-11s %9.1f %8.3f %10.3f %8.3f %8.2f %9.4f\n", glutils::color_format_name(c.hdr_format), glutils::color_format_name(c.ldr_format),
+            c.mb_per_frame, c.min_ms, c.median_ms, c.avg_ms, c.max_error, c.mean_error);
+        if (c.max_error <= fb_bench_tolerance && (!cheapest || c.median_ms < cheapest->median_ms))
+        {
+            cheapest = &c;
+        }
+    }
+    printf("Cheapest within %.0f step(s) of the reference: %s/%s\n", fb_bench_tolerance,
+        glutils::color_format_name(cheapest->hdr_format), glutils::color_format_name(cheapest->ldr_format));
+
+    _exit_code = EXIT_SUCCESS;
+    _should_exit = true;
 }
 
 void AppTest::onWindowSize(GLFWwindow * window, int w, int h)
@@ -969,6 +1597,24 @@ void AppTest::onKeyboard(GLFWwindow * window, int key, int scancode, int action,
             _mouse_locked = !_mouse_locked;
             glfwSetInputMode(window, GLFW_CURSOR, _mouse_locked ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
         }
+
+        if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+        {
+            toggle_camera_recording();
+        }
+
+        if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+        {
+            if (_ldr_capture.active())
+                stop_capture();
+            else
+                start_capture();
+        }
+
+        if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+        {
+            save_preset();
+        }
         
         // Close window
         if (key == GLFW_KEY_Q || key == GLFW_KEY_ESCAPE)
@@ -1032,9 +1678,6 @@ void AppTest::onMouseScroll(GLFWwindow* window, double xoffset, double yoffset)
     //dist = glm::clamp(dist, 0.5f, 10.f);
 }
 
-static FilmicColorGrading::UserParams userParams; // User params are the input
-static float g_ACESGamma = 1.0f;
-
 void AppTest::update_tonemap_curves()
 {
     int nb_steps = 256;
@@ -1053,120 +1696,53 @@ void AppTest::update_tonemap_curves()
         }
     };
 
-    auto linear_curve = [nb_steps, min_x, max_x](float srcValue) 
-    { 
-        float range = max_x - min_x;
-        return (srcValue-min_x)/range;
-    };
-
-    auto filmic_curve = [nb_steps, min_x, max_x](float srcValue)
-    {
-        float x = std::max(0.0f, srcValue - 0.004f);
-        return (x*(6.2f*x + 0.5f)) / (x*(6.2f*x + 1.7f) + 0.06f);
-    };
-
-    build_curve(_curve0, linear_curve);
-    build_curve(_curve1, filmic_curve);
-    
-    {
-        //FilmicColorGrading::UserParams userParams; // User params are the input
-        FilmicColorGrading::RawParams rawParams;
-        FilmicColorGrading::EvalParams evalParams;
-        FilmicColorGrading::BakedParams bakeParams;
-        FilmicColorGrading::BakedParams bakeParamsForLut;
-
-        FilmicColorGrading::RawFromUserParams(rawParams, userParams);
-        FilmicColorGrading::EvalFromRawParams(evalParams, rawParams);
-        FilmicColorGrading::BakeFromEvalParams(bakeParams, evalParams, 1024, FilmicColorGrading::kTableSpacing_Quadratic);
-
-        _curve2.resize(nb_steps); // fill with 0
-        float delta = (max_x - min_x) / (nb_steps - 1);
-        for (int i = 0; i < nb_steps; ++i)
-        {
-            float x = min_x + i * delta;
-            Vec3 srcColor = Vec3(x, x, x);
-            Vec3 dstColor = bakeParams.EvalColor(srcColor);
-            _curve2[i] = dstColor.x;
-        }
-
-
-        for (int b = 0; b<32; ++b)
-        {
-            for (int g = 0; g<32; ++g)
-            {
-                for (int r = 0; r<32; ++r)
-                {
-                    int idx = b * 32 * 32 + g * 32 + r;
-
-                    //Vec3 srcColor = Vec3(r / 31.0f, g / 31.0f, b / 31.0f); // [0..1]
-                    //Vec3 srcColor = Vec3(r / (31.0f / 2.0f), g / (31.0f / 2.0f), b / (31.0f / 2.0f)); // [0..2]
-                    Vec3 srcColor = Vec3(r / (31.0f/4.0f), g / (31.0f / 4.0f), b / (31.0f / 4.0f)); // [0..4]
-                    Vec3 dstColor = bakeParams.EvalColor(srcColor);
-                    _3dlut[idx] = glm::vec3(dstColor.x, dstColor.y, dstColor.z);
-                }
-            }
-        }
-
-        // dont do that every frame
-        GLenum format = GL_RGB;
-        GLenum type = GL_FLOAT;
-        glTextureSubImage3D(_3dlut_tex, 0, 0, 0, 0, 32, 32, 32, format, type, _3dlut.data());
-    }
-
-    // ACES
+    // constant curves, built once.
+    if (_curve0.empty())
     {
-        const glm::mat3 ACESInputMat =
-        {
-            { 0.59719, 0.35458, 0.04823 },
-            { 0.07600, 0.90834, 0.01566 },
-            { 0.02840, 0.13383, 0.83777 }
+        auto linear_curve = [nb_steps, min_x, max_x](float srcValue) 
+        { 
+            float range = max_x - min_x;
+            return (srcValue-min_x)/range;
         };
 
-        // ODT_SAT => XYZ => D60_2_D65 => sRGB
-        const glm::mat3 ACESOutputMat =
+        auto filmic_curve = [](float srcValue)
         {
-            { 1.60475, -0.53108, -0.07367 },
-            { -0.10208,  1.10813, -0.00605 },
-            { -0.00327, -0.07276,  1.07602 }
+            return tonemap::filmic_uc2(srcValue);
         };
 
-        auto RRTAndODTFit = [](vec3 v) -> vec3
-        {
-            vec3 a = v * (v + 0.0245786f) - 0.000090537f;
-            vec3 b = v * (0.983729f * v + 0.4329510f) + 0.238081f;
-            return a / b;
-         };
-
-        auto ACESFitted = [&](glm::vec3 color) -> glm::vec3
-        {
-            color = glm::transpose(ACESInputMat) * color; // transpose because HLSL matrix
-
-                                                     // Apply RRT and ODT
-            color = RRTAndODTFit(color);
+        build_curve(_curve0, linear_curve);
+        build_curve(_curve1, filmic_curve);
+    }
 
-            color = glm::transpose(ACESOutputMat) * color;
+    unsigned int stages = _regrade.flush();
+    const FilmicColorGrading::BakedParams &bakeParams = _regrade.baked_params();
 
-            // Clamp to [0, 1]
-            color = glm::clamp(color, glm::vec3(0), glm::vec3(1));
+    if (stages & RegradePipeline::stage_filmic_preview)
+    {
+        build_curve(_curve2, [&bakeParams](float x)
+        {
+            return bakeParams.EvalColor(Vec3(x, x, x)).x;
+        });
+    }
 
-            return color;
-        };
+    if (stages & RegradePipeline::stage_lut)
+    {
+        // [0..4] input range, same white point as the tonemap shader.
+        _3dlut.bake(bakeParams, 4.0f);
 
-        auto Linear_To_sRGB = [](glm::vec3 linear_color, float p) -> glm::vec3
-        {
-            return glm::pow(linear_color, glm::vec3(1.0f / p));
-        };
+        // the same grading, evaluated in the shader.
+        _compute_tonemap.set_params(_regrade.eval_params());
+    }
 
-        _curve3.resize(nb_steps); // fill with 0
-        float delta = (max_x - min_x) / (nb_steps - 1);
-        for (int i = 0; i < nb_steps; ++i)
+    // ACES
+    if (stages & RegradePipeline::stage_aces_preview)
+    {
+        float aces_gamma = _regrade.aces_gamma();
+        build_curve(_curve3, [aces_gamma](float x)
         {
-            float x = min_x + i * delta;
-            glm::vec3 srcColor = glm::vec3(x, x, x);
-            glm::vec3 dstColor = Linear_To_sRGB(ACESFitted(srcColor), g_ACESGamma);
-
-            _curve3[i] = dstColor.x;
-        }
+            glm::vec3 dstColor = tonemap::linear_to_gamma(tonemap::aces_fitted(glm::vec3(x, x, x)), aces_gamma);
+            return dstColor.x;
+        });
     }
 }
 
@@ -1220,6 +1796,44 @@ void AppTest::do_gui()
 
         bool something_changed = false;
 
+        ImGui::Checkbox("Multi-Draw Indirect", &_multi_draw_indirect);
+        ImGui::SameLine();
+        ImGui::Text("%zu objects, %zu vertices, %zu indices", _arena.nb_draws(), _arena.nb_vertices(), _arena.nb_indices());
+        for (const auto &scene : _gltf_scenes)
+        {
+            ImGui::Text("glTF: %zu mesh instances%s", scene->nb_draws(), scene->ready() ? "" : " (streaming)");
+        }
+
+        if (ImGui::SliderInt("Upload budget (MB/frame)", &_upload_budget_mb, 1, 256))
+        {
+            _streamer.set_frame_budget((size_t)_upload_budget_mb * 1024 * 1024);
+        }
+        ImGui::Text("Framebuffers: hdr %s, ldr %s", glutils::color_format_name(_hdr_color_format), glutils::color_format_name(_ldr_color_format));
+        ImGui::Checkbox("Compute tonemap (analytic filmic)", &_use_compute_tonemap);
+        ImGui::Checkbox("Tonemap to screen", &_present_direct);
+        ImGui::SameLine();
+        ImGui::Text(present_direct() ? "(no ldr pass)" : "(ldr pass + blit)");
+        ImGui::Text("Streaming: %zu loading, %zu uploading, %.2f MB this frame", _streamer.nb_loading(), _streamer.nb_uploading(), _streamer.bytes_last_frame() / (1024.0 * 1024.0));
+        if (_texture_cache.enabled())
+        {
+            ImGui::Text("Texture cache: %zu hits, %zu misses, %.1f MB of decoding saved", _texture_cache.nb_hits(), _texture_cache.nb_misses(), _texture_cache.bytes_saved() / (1024.0 * 1024.0));
+        }
+        ImGui::Text("Shaders: %d from the cache, %d compiled, %.1f ms, %d reloaded", _shader_cache.nb_loaded(), _shader_cache.nb_compiled(), _shader_cache.build_ms(), _shader_cache.nb_reloaded());
+        ImGui::Checkbox("Hot reload", &_hot_reload);
+        if (!_preset_path.empty())
+        {
+            ImGui::SameLine();
+            if (ImGui::Button("Save preset (F7)"))
+            {
+                save_preset();
+            }
+        }
+
+        if (_ldr_capture.active())
+        {
+            ImGui::Text("Capture: %d frames, %d written, %d queued, %d stalls, %.3f ms (max %.3f)", _ldr_capture.nb_captured(), _ldr_capture.nb_written(), _ldr_capture.nb_queued(), _ldr_capture.nb_stalls(), _ldr_capture.last_ms(), _ldr_capture.max_ms());
+        }
+
         ImGui::Combo("View", &_current_view, "Horizontal Split 4\0Split 2 ACES\0Linear Only\0Filmic LUT Only\0ACES Only\0Filmic UC2 Only\0\0");
 
         //ImGui::PlotLines("L", _curve0.data(), _curve0.size(), 0, "Linear", 0.0f, 1.2f, ImVec2(0, 128)); 
@@ -1227,6 +1841,12 @@ void AppTest::do_gui()
         ImGui::PlotLines("F1", _curve1.data(), _curve1.size(), 0, "Filmic Uncharted 2 with Gamma", 0.0f, 1.0f, ImVec2(512, 128));
 
         ImGui::Checkbox("Draw 3D LUT", &_draw3dlut);
+        if (ImGui::Combo("3D LUT Size", &_3dlut_size_idx, "17\0" "33\0" "65\0" "129\0\0"))
+        {
+            _3dlut.init(LutBaker::sizes[_3dlut_size_idx]);
+            _regrade.invalidate(RegradePipeline::stage_lut);
+        }
+        ImGui::Text("3D LUT bake: %.2f ms (gpu wait %.2f ms)", _3dlut.bake_ms(), _3dlut.wait_ms());
         something_changed = ImGui::SliderFloat("Toe Strength", &userParams.m_filmicToeStrength, 0.0f, 1.0f, "%.2f") || something_changed;
         something_changed = ImGui::SliderFloat("Toe Length", &userParams.m_filmicToeLength, 0.0f, 1.0f, "%.2f") || something_changed;
         something_changed = ImGui::SliderFloat("Shoulder Strength", &userParams.m_filmicShoulderStrength, 0.0f, 4.0f, "%.2f") || something_changed;
@@ -1235,13 +1855,30 @@ void AppTest::do_gui()
         something_changed = ImGui::SliderFloat("Filmic Gamma", &userParams.m_filmicGamma, 1.0f / 2.2f, 1.0f, "%.2f") || something_changed;
         ImGui::PlotLines("F2", _curve2.data(), _curve2.size(), 0, "Filmic J.Hable 2016", 0.0f, 1.0f, ImVec2(512, 128));
 
+        if (ImGui::Checkbox("Auto Exposure", &_use_auto_exposure))
+        {
+            _auto_exposure.reset();
+        }
+        if (_use_auto_exposure)
+        {
+            auto &ae = _auto_exposure.get_params();
+            ImGui::SliderFloat("Key", &ae.key, 0.01f, 1.0f, "%.3f");
+            ImGui::SliderFloat("Adaptation Speed", &ae.tau, 0.1f, 10.0f, "%.2f");
+            ImGui::DragFloatRange2("Log Lum Range", &ae.min_log_lum, &ae.max_log_lum, 0.1f, -16.0f, 16.0f);
+            const auto &r = _auto_exposure.last_result();
+            ImGui::Text("Average lum %.3f, adapted %.3f, exposure %.3f", r.average_luminance, r.adapted_luminance, r.exposure);
+        }
+
         something_changed = ImGui::SliderFloat("ACES Gamma", &g_ACESGamma, 1.0f, 2.2f, "%.2f") || something_changed;
         ImGui::PlotLines("A", _curve3.data(), _curve3.size(), 0, "ACES", 0.0f, 1.2f, ImVec2(512, 128));
 
+        // only recorded here, run() flushes once per frame.
         if (something_changed)
         {
-            update_tonemap_curves();
+            _regrade.set_user_params(userParams);
+            _regrade.set_aces_gamma(g_ACESGamma);
         }
+        ImGui::Text("Curve bakes: %u tables, %u scalars", _regrade.nb_table_bakes(), _regrade.nb_scalar_bakes());
 
         // if combobox
         // choose which lut to fill
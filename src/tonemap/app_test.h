@@ -3,12 +3,31 @@
 
 #include "app.h"
 #include "arcball_camera.h"
-#include "tiny_obj_loader.h"
 #include "procgen.h"
+#include "lut_baker.h"
+#include "regrade_pipeline.h"
+#include "auto_exposure.h"
+#include "upload_ring.h"
+#include "asset_streamer.h"
+#include "hdr_texture.h"
+#include "texture_cache.h"
+#include "shader_cache.h"
+#include "file_watcher.h"
+#include "scene_arena.h"
+#include "gltf_scene.h"
+#include "camera_path.h"
+#include "benchmark_report.h"
+#include "frame_capture.h"
+#include "compute_tonemap.h"
+#include "grading_preset.h"
 
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
+
+class ObjMesh;
+class MeshCache;
 
 class AppTest : public App
 {
@@ -19,6 +38,10 @@ public:
     bool init(int framebuffer_width, int framebuffer_height) override;
     void shutdown() override;
     void run(float dt) override;
+    bool should_exit() const override { return _should_exit; }
+    int exit_code() const override { return _exit_code; }
+    bool ready() const override { return _streamer.idle(); }
+    unsigned int output_texture() const override { return _fbtex_ldr_color; }
 
     void onWindowSize(GLFWwindow* window, int w, int h) override;
     void onFramebufferSize(GLFWwindow* window, int w, int h) override;
@@ -29,10 +52,7 @@ public:
 
     struct DrawItem
     {
-        unsigned int vao = 0;
-        unsigned int index_buffer_id = 0;
-        unsigned int vertex_buffer_id = 0;
-        unsigned int nb_elements = 0;
+        SceneArena::range range; // vertices and indices in the scene arena.
 
 
         glm::vec3 bbox_min;
@@ -48,21 +68,56 @@ public:
 
 private:
 
-    bool load_obj(const char *filename);
-    bool load_gltf(const char *filename);
+    // The cpu side runs on the thread pool, the objects appear as their uploads complete.
+    void stream_obj(const std::string &filename);
+    void stream_gltf(const std::string &filename);
+    void stream_environment(const std::string &filename);
+    void on_streamed(glutils::AssetStreamer::Batch &batch, const std::string &name);
     bool load_shaders();
+    void fetch_programs();
+    void hot_reload();
+    bool load_preset();
+    bool save_preset();
     bool load_textures();
     bool create_framebuffers();
     bool recreate_framebuffers();
+    void delete_framebuffers();
+
+    void start_fb_bench();
+    bool fb_bench_begin_frame(); // true: this frame is timed.
+    void fb_bench_end_frame(bool timed);
+
+    void benchmark_frame(float real_dt);
+    void record_camera(float dt);
+    void toggle_camera_recording();
+
+    bool present_direct() const; // tonemap to the screen, no ldr framebuffer.
+    void draw_tonemap(int view);
+    void tonemap_bench();
+
+    void start_capture();
+    void stop_capture();
 
+    DrawItemSharedPtr new_scene_object(const std::string &name);
+
+    // Goes through the upload ring into the scene arena.
     void add_to_scene(const std::string &name, const IndexedMesh &mesh);
 
+    // Writes the mesh straight into the mapped scene arena. Left out of the scene if it cannot map it.
+    using MeshGenerator = std::function<void(const VertexStreams &out, index_t *indices)>;
+    void add_to_scene(const std::string &name, const MeshInfo &info, const MeshGenerator &generate);
+
+    // Queues the uploads of a mesh into the scene arena. It becomes a scene object, and
+    // gets drawn, once they are done.
+    void stream_to_scene(glutils::AssetStreamer::Batch &batch, const std::string &name, const MeshInfo &info, glutils::UploadRing::fill_func fill_vertices, glutils::UploadRing::fill_func fill_indices);
+
     // Adds all the objects in an OBJ into the objects containers.
-    void add_OBJ_to_scene(
-        const tinyobj::attrib_t &obj_attribs,
-        std::vector<tinyobj::shape_t> &obj_shapes,
-        std::vector<tinyobj::material_t> &obj_material,
-        bool normalize_size);
+    void add_OBJ_to_scene(std::shared_ptr<const ObjMesh> mesh, glutils::AssetStreamer::Batch &batch);
+    void add_cached_to_scene(std::shared_ptr<const MeshCache> cache, glutils::AssetStreamer::Batch &batch);
+
+    void add_scene_bounds(const glm::vec3 &bbox_min, const glm::vec3 &bbox_max);
+    bool scene_bounds_empty() const { return scene_bbox_min.x > scene_bbox_max.x; }
+    void frame_scene(); // arcball camera around the scene bounds.
 
     void do_gui();
     void update_camera(float dt);
@@ -71,6 +126,8 @@ private:
 
 private:
 
+    static const int nb_views = 6; // the "View" combo, VIEW in tonemap.frag and tonemap.comp.
+
     struct program 
     {
         unsigned int program_id = 0;
@@ -87,34 +144,103 @@ private:
     };
 
     unsigned int _tex;
-    unsigned int _3dlut_tex;
     unsigned int _sampler;
     unsigned int _nearest_sampler;
     unsigned int _linear_sampler;
 
     std::string _scene_path;
+    bool _rebuild_mesh_cache = false;
+    int _upload_budget_mb = 16;
+    std::string _env_path; // .hdr, or .hdrmips packed offline by hdrtonemap.
+    utils::HdrFormat _env_format = utils::HdrFormat::rgb9e5; // environment map texels.
+    std::string _texture_cache_dir;
+    utils::TextureCache _texture_cache;
+    std::string _shader_cache_dir;
+    glutils::ShaderCache _shader_cache; // owns the programs below.
+
+    // hot reload
+    utils::FileWatcher _watcher; // the shader sources and the preset.
+    bool _hot_reload = true;
+    int _nb_watched_programs = 0;
+    std::string _preset_path;
+
+    struct shader_ids
+    {
+        int simple = -1;
+        int fullscreen = -1;
+        int draw_lut = -1;
+        int tonemap[nb_views];
+    };
+    shader_ids _shader_ids;
 
     program _simple_program;
     unsigned int _fullscreen_program;
-    unsigned int _tonemap_program;
+    unsigned int _tonemap_programs[nb_views] = {}; // one per view, VIEW is a #define.
     unsigned int _3dlut_program;
     unsigned int _uni_width;
     unsigned int _uni_height;
-    unsigned int _uni_splitview;
+    unsigned int _uni_draw_lut_size;
     unsigned int _dummy_vao;
 
     // framebuffers
-    unsigned int _fb_hdr; // main rendering here
-    unsigned int _fbtex_hdr_color;
-    unsigned int _fbtex_hdr_depth;
-
-    unsigned int _fb_ldr; // tone mapping here
-    unsigned int _fbtex_ldr_color;
-    unsigned int _fbtex_ldr_depth;
+    unsigned int _fb_hdr = 0; // main rendering here
+    unsigned int _fbtex_hdr_color = 0;
+    unsigned int _fbtex_hdr_depth = 0;
+    GLenum _hdr_color_format = GL_RGBA32F;
+
+    unsigned int _fb_ldr = 0; // tone mapping here
+    unsigned int _fbtex_ldr_color = 0;
+    unsigned int _fbtex_ldr_depth = 0;
+    GLenum _ldr_color_format = GL_RGBA8;
+    bool _present_direct = true; // when nothing reads the ldr framebuffer, see present_direct().
+
+    // framebuffer formats benchmark (--fb-bench)
+    struct fb_bench_config
+    {
+        GLenum hdr_format;
+        GLenum ldr_format;
+        std::vector<GLuint> queries; // GL_TIME_ELAPSED, one per frame.
+        double min_ms = 0.0;
+        double median_ms = 0.0;
+        double avg_ms = 0.0;
+        double mb_per_frame = 0.0; // color attachments.
+        float max_error = 0.0f; // vs the first config, in 8 bits steps.
+        float mean_error = 0.0f;
+    };
+    std::vector<fb_bench_config> _fb_bench;
+    size_t _fb_bench_config = 0;
+    int _fb_bench_frames = 0; // per config, 0: no benchmark.
+    int _fb_bench_frame = 0; // in the current config, warmup included.
+    std::vector<float> _fb_bench_reference; // ldr pixels of the first config.
+
+    // benchmark (--benchmark)
+    static constexpr float benchmark_dt = 1.0f / 60.0f;
+    int _benchmark_frames = 0; // measured, 0: no benchmark.
+    int _benchmark_frame = -1; // from the first frame with everything loaded, warmup included.
+    std::string _benchmark_out;
+    std::string _camera_path_file; // played by the benchmark, written by F5.
+    CameraPath _camera_path;
+    BenchmarkReport _benchmark;
+
+    bool _recording_camera = false;
+    float _recording_time = 0.0f;
+    CameraPath _recorded_path;
+
+    // image sequence (--capture, F6)
+    glutils::FrameCapture _ldr_capture;
+    glutils::FrameCapture _hdr_capture;
+    std::string _capture_prefix;
+    bool _capture_at_start = false; // once the scene is loaded.
+    bool _capture_hdr = false; // the hdr framebuffer too.
 
 
     DrawItemArray _v_objects;
     DrawItemMap _m_objects;
+    glutils::UploadRing _upload_ring;
+    glutils::AssetStreamer _streamer;
+    SceneArena _arena;
+    std::vector<std::shared_ptr<GltfScene>> _gltf_scenes; // drawn from their own buffers, after the arena.
+    bool _multi_draw_indirect = true; // else one glDrawElementsBaseVertex per object.
     unsigned int _current_picking_id = 1; // 0 and 0xffffffff are reserved.
 
     double _mouse_x = 0;
@@ -143,9 +269,24 @@ private:
     std::vector<float> _curve2;
     std::vector<float> _curve3;
 
-    std::vector<glm::vec3> _3dlut;
+    RegradePipeline _regrade;
+    LutBaker _3dlut;
+    int _3dlut_size_idx = 1; // 33^3
     bool _draw3dlut = true;
+    ComputeTonemap _compute_tonemap;
+    bool _use_compute_tonemap = false; // else the fragment pass, with the 3D LUT.
+    int _tonemap_bench_frames = 0; // passes per path, 0: no benchmark (--tonemap-bench).
+    int _tonemap_bench_frame = 0; // frames once loaded.
     int _current_view = 0;
+
+    // auto exposure
+    AutoExposure _auto_exposure;
+    bool _use_auto_exposure = true;
+    bool _validate_exposure = false;
+    int _nb_validation_frames = 0;
+
+    bool _should_exit = false;
+    int _exit_code = 0;
 };
 
 #endif // _APP_TEST_2018_12_03_H_
@@ -0,0 +1,238 @@
+#include "auto_exposure.h"
+#include "gl_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#define GROUP_SIZE 16
+#define EPSILON 0.005f
+
+AutoExposure::~AutoExposure()
+{
+    shutdown();
+}
+
+bool AutoExposure::init(const std::string &shaders_path, glutils::ShaderCache &shader_cache)
+{
+    // both in the same build, compiled side by side when they are not cached.
+    _shader_cache = &shader_cache;
+    _histogram_id = shader_cache.request({ { GL_COMPUTE_SHADER, shaders_path + "histogram.comp" } });
+    _average_id = shader_cache.request({ { GL_COMPUTE_SHADER, shaders_path + "average_luminance.comp" } });
+    shader_cache.build();
+    refresh_programs();
+    if (!_histogram_program || !_average_program)
+        return false;
+
+    // the average pass clears the bins after reading them.
+    std::vector<uint32_t> zeros(nb_bins, 0);
+    glCreateBuffers(1, &_histogram_buffer);
+    glNamedBufferStorage(_histogram_buffer, nb_bins * sizeof(uint32_t), zeros.data(), 0);
+
+    // mapped for the gui, written with glNamedBufferSubData by reset().
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &_exposure_buffer);
+    glNamedBufferStorage(_exposure_buffer, sizeof(result), nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+    _mapped_result = (result*)glMapNamedBufferRange(_exposure_buffer, 0, sizeof(result), flags);
+
+    reset();
+
+    return _mapped_result != nullptr;
+}
+
+void AutoExposure::shutdown()
+{
+    if (_exposure_buffer)
+    {
+        glUnmapNamedBuffer(_exposure_buffer);
+        glDeleteBuffers(1, &_exposure_buffer);
+        _exposure_buffer = 0;
+        _mapped_result = nullptr;
+    }
+
+    if (_histogram_buffer)
+    {
+        glDeleteBuffers(1, &_histogram_buffer);
+        _histogram_buffer = 0;
+    }
+
+    // the shader cache's.
+    _histogram_program = 0;
+    _average_program = 0;
+}
+
+void AutoExposure::refresh_programs()
+{
+    _histogram_program = _shader_cache->program(_histogram_id);
+    _average_program = _shader_cache->program(_average_id);
+
+    _uni_histogram_min_log_lum = glGetUniformLocation(_histogram_program, "min_log_lum");
+    _uni_histogram_inv_log_lum_range = glGetUniformLocation(_histogram_program, "inv_log_lum_range");
+    _uni_average_min_log_lum = glGetUniformLocation(_average_program, "min_log_lum");
+    _uni_average_log_lum_range = glGetUniformLocation(_average_program, "log_lum_range");
+    _uni_average_pixel_count = glGetUniformLocation(_average_program, "pixel_count");
+    _uni_average_time_coeff = glGetUniformLocation(_average_program, "time_coeff");
+    _uni_average_exposure_key = glGetUniformLocation(_average_program, "exposure_key");
+}
+
+void AutoExposure::reset()
+{
+    // adapted == key -> exposure 1.
+    result r = { _params.key, 1.0f, _params.key, 0.0f };
+    glNamedBufferSubData(_exposure_buffer, 0, sizeof(result), &r);
+}
+
+void AutoExposure::bind_result() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, exposure_binding, _exposure_buffer);
+}
+
+AutoExposure::result AutoExposure::read_result() const
+{
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT); // shader writes, read back by glGetNamedBufferSubData.
+    result r;
+    glGetNamedBufferSubData(_exposure_buffer, 0, sizeof(result), &r);
+    return r;
+}
+
+void AutoExposure::dispatch_histogram(GLuint hdr_tex, int width, int height)
+{
+    float log_lum_range = _params.max_log_lum - _params.min_log_lum;
+
+    glUseProgram(_histogram_program);
+    glUniform1f(_uni_histogram_min_log_lum, _params.min_log_lum);
+    glUniform1f(_uni_histogram_inv_log_lum_range, 1.0f / log_lum_range);
+
+    glBindTextureUnit(0, hdr_tex);
+    glBindSampler(0, 0); // texelFetch only
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, histogram_binding, _histogram_buffer);
+
+    glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void AutoExposure::dispatch_average(int width, int height, float time_coeff)
+{
+    float log_lum_range = _params.max_log_lum - _params.min_log_lum;
+
+    glUseProgram(_average_program);
+    glUniform1f(_uni_average_min_log_lum, _params.min_log_lum);
+    glUniform1f(_uni_average_log_lum_range, log_lum_range);
+    glUniform1f(_uni_average_pixel_count, (float)width * (float)height);
+    glUniform1f(_uni_average_time_coeff, time_coeff);
+    glUniform1f(_uni_average_exposure_key, _params.key);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, histogram_binding, _histogram_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, exposure_binding, _exposure_buffer);
+
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void AutoExposure::update(GLuint hdr_tex, int width, int height, float dt)
+{
+    dispatch_histogram(hdr_tex, width, height);
+
+    float time_coeff = std::min(std::max(1.0f - std::exp(-dt * _params.tau), 0.0f), 1.0f);
+    dispatch_average(width, height, time_coeff);
+
+    glUseProgram(0);
+}
+
+//
+// CPU REFERENCE
+//
+
+uint32_t AutoExposure::cpu_luminance_bin(float r, float g, float b, const params &p)
+{
+    float lum = r * 0.2125f + g * 0.7154f + b * 0.0721f;
+    if (lum < EPSILON)
+    {
+        return 0;
+    }
+
+    float inv_log_lum_range = 1.0f / (p.max_log_lum - p.min_log_lum);
+    float log_lum = std::min(std::max((std::log2(lum) - p.min_log_lum) * inv_log_lum_range, 0.0f), 1.0f);
+    return (uint32_t)(log_lum * 254.0f + 1.0f);
+}
+
+void AutoExposure::cpu_histogram(const float *rgba, int width, int height, const params &p, uint32_t *bins)
+{
+    std::fill(bins, bins + nb_bins, 0);
+
+    size_t nb_pixels = (size_t)width * height;
+    for (size_t i = 0; i < nb_pixels; ++i)
+    {
+        const float *c = rgba + i * 4;
+        ++bins[cpu_luminance_bin(c[0], c[1], c[2], p)];
+    }
+}
+
+float AutoExposure::cpu_average_log_luminance(const uint32_t *bins, uint32_t pixel_count, const params &p)
+{
+    double weighted = 0.0;
+    for (int i = 0; i < nb_bins; ++i)
+    {
+        weighted += (double)bins[i] * i;
+    }
+
+    double weighted_log_average = weighted / std::max((double)pixel_count - bins[0], 1.0) - 1.0;
+    double log_lum = (weighted_log_average / 254.0) * (p.max_log_lum - p.min_log_lum) + p.min_log_lum;
+    return (float)std::exp2(log_lum);
+}
+
+float AutoExposure::cpu_adapt(float adapted, float target, float dt, float tau)
+{
+    float time_coeff = std::min(std::max(1.0f - std::exp(-dt * tau), 0.0f), 1.0f);
+    return adapted + (target - adapted) * time_coeff;
+}
+
+bool AutoExposure::validate(GLuint hdr_tex, int width, int height)
+{
+    uint32_t pixel_count = (uint32_t)width * height;
+
+    // gpu
+    std::vector<uint32_t> gpu_bins(nb_bins);
+    dispatch_histogram(hdr_tex, width, height);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT); // shader writes, read back by glGetNamedBufferSubData.
+    glGetNamedBufferSubData(_histogram_buffer, 0, nb_bins * sizeof(uint32_t), gpu_bins.data());
+
+    dispatch_average(width, height, 1.0f); // no adaptation: adapted == average
+    glUseProgram(0);
+    result gpu_result = read_result();
+
+    // cpu, on the same pixels
+    std::vector<float> pixels((size_t)pixel_count * 4);
+    glGetTextureImage(hdr_tex, 0, GL_RGBA, GL_FLOAT, (GLsizei)(pixels.size() * sizeof(float)), pixels.data());
+
+    std::vector<uint32_t> cpu_bins(nb_bins);
+    cpu_histogram(pixels.data(), width, height, _params, cpu_bins.data());
+    float cpu_average = cpu_average_log_luminance(cpu_bins.data(), pixel_count, _params);
+
+    reset();
+
+    // log2 precision differs between gpu and cpu, pixels right on a bin edge may move by one bin.
+    uint64_t gpu_total = 0;
+    uint64_t nb_moved = 0;
+    for (int i = 0; i < nb_bins; ++i)
+    {
+        gpu_total += gpu_bins[i];
+        nb_moved += (gpu_bins[i] > cpu_bins[i]) ? gpu_bins[i] - cpu_bins[i] : cpu_bins[i] - gpu_bins[i];
+    }
+    nb_moved /= 2;
+
+    // one bin is 1/254 of the log range.
+    float log_error = std::fabs(std::log2(gpu_result.average_luminance) - std::log2(cpu_average));
+    float max_log_error = (_params.max_log_lum - _params.min_log_lum) / 254.0f;
+
+    bool ok = (gpu_total == pixel_count)
+        && (nb_moved <= pixel_count / 1000)
+        && (log_error <= max_log_error);
+
+    printf("auto exposure validation: %s\n", ok ? "OK" : "FAILED");
+    printf("  pixels     : gpu %llu, cpu %u\n", (unsigned long long)gpu_total, pixel_count);
+    printf("  moved      : %llu pixels to a neighbour bin\n", (unsigned long long)nb_moved);
+    printf("  average    : gpu %f, cpu %f (log2 error %f, max %f)\n", gpu_result.average_luminance, cpu_average, log_error, max_log_error);
+
+    return ok;
+}
@@ -0,0 +1,111 @@
+#ifndef _AUTO_EXPOSURE_2026_10_17_H_
+#define _AUTO_EXPOSURE_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include "shader_cache.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//
+// Auto exposure from a 256 bins log-luminance histogram, in 2 compute passes:
+// - histogram.comp: shared memory atomics per 16x16 group, then one global atomic per bin.
+// - average_luminance.comp: weighted average of the bins, adapted over time, written
+//   with the resulting exposure into an SSBO read by the tonemap pass (no readback).
+//
+// The cpu_* functions are the software reference of both passes, used by validate().
+//
+class AutoExposure
+{
+public:
+
+    static const int nb_bins = 256;
+
+    // binding points, shared with the shaders.
+    static const GLuint histogram_binding = 0;
+    static const GLuint exposure_binding = 1;
+
+    struct params
+    {
+        float min_log_lum = -10.0f;
+        float max_log_lum = 2.0f;
+        float tau = 1.1f;    // adaptation speed
+        float key = 0.18f;   // middle grey target
+    };
+
+    // what the exposure SSBO holds.
+    struct result
+    {
+        float adapted_luminance;
+        float exposure;
+        float average_luminance;
+        float padding;
+    };
+
+    AutoExposure() = default;
+    ~AutoExposure();
+
+    // The programs are the cache's, it must outlive this.
+    bool init(const std::string &shaders_path, glutils::ShaderCache &shader_cache);
+    void shutdown();
+
+    // After a shader reload: the programs, and their uniforms, again.
+    void refresh_programs();
+
+    // dispatches both passes on a RGBA32F texture. Leaves the result in the exposure SSBO.
+    void update(GLuint hdr_tex, int width, int height, float dt);
+
+    // back to a neutral exposure of 1.
+    void reset();
+
+    // binds the exposure SSBO for the tonemap pass.
+    void bind_result() const;
+
+    // Last values written by the gpu, for display only: it may lag a frame or two.
+    const result &last_result() const { return *_mapped_result; }
+
+    // What the passes dispatched so far wrote: a barrier then a readback, it stalls.
+    result read_result() const;
+
+    params &get_params() { return _params; }
+
+    //
+    // cpu reference
+    //
+    static uint32_t cpu_luminance_bin(float r, float g, float b, const params &p);
+    static void cpu_histogram(const float *rgba, int width, int height, const params &p, uint32_t *bins);
+    static float cpu_average_log_luminance(const uint32_t *bins, uint32_t pixel_count, const params &p);
+    static float cpu_adapt(float adapted, float target, float dt, float tau);
+
+    // Runs the gpu histogram and average on hdr_tex (without adaptation) and compares them
+    // with the cpu reference. Prints the differences. Leaves the adaptation state reset.
+    bool validate(GLuint hdr_tex, int width, int height);
+
+private:
+
+    void dispatch_histogram(GLuint hdr_tex, int width, int height);
+    void dispatch_average(int width, int height, float time_coeff);
+
+    params _params;
+
+    glutils::ShaderCache *_shader_cache = nullptr;
+    int _histogram_id = -1;
+    int _average_id = -1;
+    GLuint _histogram_program = 0;
+    GLuint _average_program = 0;
+    GLuint _histogram_buffer = 0;
+    GLuint _exposure_buffer = 0;
+    result *_mapped_result = nullptr;
+
+    int _uni_histogram_min_log_lum = -1;
+    int _uni_histogram_inv_log_lum_range = -1;
+    int _uni_average_min_log_lum = -1;
+    int _uni_average_log_lum_range = -1;
+    int _uni_average_pixel_count = -1;
+    int _uni_average_time_coeff = -1;
+    int _uni_average_exposure_key = -1;
+};
+
+#endif // _AUTO_EXPOSURE_2026_10_17_H_
@@ -0,0 +1,78 @@
+#include "benchmark_report.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <stdio.h>
+
+using nlohmann::json;
+
+TimingSummary summarize_timings(std::vector<double> ms)
+{
+    TimingSummary s;
+    if (ms.empty())
+        return s;
+
+    std::sort(ms.begin(), ms.end());
+
+    // nearest rank.
+    auto percentile = [&ms](int p)
+    {
+        size_t rank = (ms.size() * p + 99) / 100;
+        return ms[std::min(ms.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+
+    s.min = ms.front();
+    s.avg = std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    s.p50 = percentile(50);
+    s.p90 = percentile(90);
+    s.p95 = percentile(95);
+    s.p99 = percentile(99);
+    s.max = ms.back();
+    return s;
+}
+
+static json to_json(const TimingSummary &s)
+{
+    return json{ { "min", s.min }, { "avg", s.avg }, { "p50", s.p50 }, { "p90", s.p90 }, { "p95", s.p95 }, { "p99", s.p99 }, { "max", s.max } };
+}
+
+bool BenchmarkReport::write_json(const std::string &filename) const
+{
+    json j;
+    j["scene"] = scene;
+    j["camera_path"] = camera_path.empty() ? "orbit" : camera_path;
+    j["gl"] = { { "vendor", gl_vendor }, { "renderer", gl_renderer }, { "version", gl_version } };
+    j["framebuffers"] = { { "hdr", hdr_format }, { "ldr", ldr_format } };
+    j["width"] = width;
+    j["height"] = height;
+    j["warmup_frames"] = nb_warmup_frames;
+    j["frames"] = frame_ms.size();
+    j["frame_ms"] = to_json(summarize_timings(frame_ms));
+    j["cpu_ms"] = to_json(summarize_timings(cpu_ms));
+    j["gpu_ms"] = to_json(summarize_timings(gpu_ms));
+
+    std::ofstream out(filename);
+    if (!out)
+    {
+        printf("FAILED to write the benchmark report \"%s\"\n", filename.c_str());
+        return false;
+    }
+    out << j.dump(2) << std::endl;
+    return true;
+}
+
+void BenchmarkReport::print() const
+{
+    printf("Benchmark: %zu frames at %dx%d on %s\n", frame_ms.size(), width, height, gl_renderer.c_str());
+    printf("%-6s %8s %8s %8s %8s %8s %8s\n", "ms", "min", "avg", "p50", "p95", "p99", "max");
+
+    const std::pair<const char*, const std::vector<double>*> rows[] = { { "frame", &frame_ms }, { "cpu", &cpu_ms }, { "gpu", &gpu_ms } };
+    for (const auto &row : rows)
+    {
+        TimingSummary s = summarize_timings(*row.second);
+        printf("%-6s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", row.first, s.min, s.avg, s.p50, s.p95, s.p99, s.max);
+    }
+}
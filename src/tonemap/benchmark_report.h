@@ -0,0 +1,47 @@
+#ifndef _BENCHMARK_REPORT_2026_10_17_H_
+#define _BENCHMARK_REPORT_2026_10_17_H_
+
+#include <string>
+#include <vector>
+
+// Distribution of frame timings, in ms.
+struct TimingSummary
+{
+    double min = 0.0;
+    double avg = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+TimingSummary summarize_timings(std::vector<double> ms);
+
+//
+// Result of a --benchmark run, written as JSON for the CI to compare runs.
+//
+// frame_ms is the wall time between frames (swap included), cpu_ms the time to submit a
+// frame and gpu_ms its time on the gpu, both from the profiler "frame" scope.
+//
+struct BenchmarkReport
+{
+    std::string scene;
+    std::string camera_path; // empty: default orbit.
+    std::string gl_vendor;
+    std::string gl_renderer;
+    std::string gl_version;
+    std::string hdr_format;
+    std::string ldr_format;
+    int width = 0;
+    int height = 0;
+    int nb_warmup_frames = 0;
+    std::vector<double> frame_ms;
+    std::vector<double> cpu_ms;
+    std::vector<double> gpu_ms;
+
+    bool write_json(const std::string &filename) const;
+    void print() const;
+};
+
+#endif // _BENCHMARK_REPORT_2026_10_17_H_
@@ -0,0 +1,103 @@
+#include "camera_path.h"
+
+#include "arcball_camera.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+CameraPath CameraPath::orbit(float radius, float duration, int nb_keys)
+{
+    CameraPath path;
+    for (int i = 0; i <= nb_keys; ++i)
+    {
+        const float a = 2.0f * glm::pi<float>() * i / nb_keys;
+        key k;
+        k.time = duration * i / nb_keys;
+        k.eye = glm::vec3(radius * std::sin(a), 0.25f * radius, radius * std::cos(a));
+        k.target = glm::vec3(0.0f);
+        k.fovy_degrees = 45.0f;
+        path.add(k);
+    }
+    return path;
+}
+
+void CameraPath::add(float time, const Camera &camera)
+{
+    add({ time, camera.eye, camera.target, camera.fovy_degrees });
+}
+
+bool CameraPath::load(const std::string &filename)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        printf("FAILED to open the camera path \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    _keys.clear();
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        std::istringstream fields(line);
+        key k;
+        if (!(fields >> k.time >> k.eye.x >> k.eye.y >> k.eye.z >> k.target.x >> k.target.y >> k.target.z >> k.fovy_degrees)
+            || (!_keys.empty() && k.time < _keys.back().time))
+        {
+            printf("FAILED to read the camera path \"%s\", line %d\n", filename.c_str(), line_number);
+            _keys.clear();
+            return false;
+        }
+        _keys.push_back(k);
+    }
+    return !_keys.empty();
+}
+
+bool CameraPath::save(const std::string &filename) const
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        printf("FAILED to write the camera path \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    fprintf(file, "# time eye.x eye.y eye.z target.x target.y target.z fovy\n");
+    for (const auto &k : _keys)
+    {
+        fprintf(file, "%.4f %.6g %.6g %.6g %.6g %.6g %.6g %.3f\n", k.time, k.eye.x, k.eye.y, k.eye.z, k.target.x, k.target.y, k.target.z, k.fovy_degrees);
+    }
+    fclose(file);
+    return true;
+}
+
+CameraPath::key CameraPath::sample(float time) const
+{
+    if (_keys.empty())
+        return { 0.0f, glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), 45.0f };
+
+    auto next = std::upper_bound(_keys.begin(), _keys.end(), time, [](float t, const key &k) { return t < k.time; });
+    if (next == _keys.begin())
+        return _keys.front();
+    if (next == _keys.end())
+        return _keys.back();
+
+    const key &a = *(next - 1);
+    const key &b = *next;
+    const float s = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 1.0f;
+
+    key k;
+    k.time = time;
+    k.eye = glm::mix(a.eye, b.eye, s);
+    k.target = glm::mix(a.target, b.target, s);
+    k.fovy_degrees = glm::mix(a.fovy_degrees, b.fovy_degrees, s);
+    return k;
+}
@@ -0,0 +1,51 @@
+#ifndef _CAMERA_PATH_2026_10_17_H_
+#define _CAMERA_PATH_2026_10_17_H_
+
+#include "glm_usage.h"
+
+#include <string>
+#include <vector>
+
+struct Camera;
+
+//
+// Camera keyframes, linearly interpolated. Recorded from the app (F5), played by --benchmark.
+//
+// Text file, one key per line: "time eye.x eye.y eye.z target.x target.y target.z fovy",
+// '#' starts a comment.
+//
+class CameraPath
+{
+public:
+
+    struct key
+    {
+        float time; // seconds.
+        glm::vec3 eye;
+        glm::vec3 target;
+        float fovy_degrees;
+    };
+
+    // Around the origin, at `radius`, slightly above, one turn in `duration` seconds.
+    static CameraPath orbit(float radius, float duration, int nb_keys = 64);
+
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+
+    void clear() { _keys.clear(); }
+    void add(const key &k) { _keys.push_back(k); } // in time order.
+    void add(float time, const Camera &camera);
+
+    bool empty() const { return _keys.empty(); }
+    size_t nb_keys() const { return _keys.size(); }
+    float duration() const { return _keys.empty() ? 0.0f : _keys.back().time; }
+
+    // Clamped to the first and last keys.
+    key sample(float time) const;
+
+private:
+
+    std::vector<key> _keys;
+};
+
+#endif // _CAMERA_PATH_2026_10_17_H_
@@ -0,0 +1,163 @@
+#include "compute_tonemap.h"
+#include "gl_utils.h"
+
+#include <stdio.h>
+
+#define GROUP_SIZE 16
+
+// GLSL image format qualifiers.
+static const char *image_format_qualifier(GLenum format)
+{
+    switch (format)
+    {
+    case GL_RGBA8: return "rgba8";
+    case GL_RGB10_A2: return "rgb10_a2";
+    case GL_RGBA16F: return "rgba16f";
+    case GL_R11F_G11F_B10F: return "r11f_g11f_b10f";
+    case GL_RGBA32F: return "rgba32f";
+    default: return nullptr;
+    }
+}
+
+static void copy3(float *dst, const Vec3 &v)
+{
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
+}
+
+ComputeTonemap::~ComputeTonemap()
+{
+    shutdown();
+}
+
+bool ComputeTonemap::init(const std::string &shaders_path, glutils::ShaderCache &shader_cache)
+{
+    shutdown();
+
+    _shaders_path = shaders_path;
+    _shader_cache = &shader_cache;
+
+    static_assert(sizeof(gpu_params) == 192, "see grading_params in tonemap.comp");
+    glCreateBuffers(1, &_params_buffer);
+    glNamedBufferStorage(_params_buffer, sizeof(gpu_params), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    set_params(FilmicColorGrading::EvalParams());
+
+    return true;
+}
+
+void ComputeTonemap::shutdown()
+{
+    _programs.clear(); // the shader cache's.
+
+    if (_params_buffer)
+    {
+        glDeleteBuffers(1, &_params_buffer);
+        _params_buffer = 0;
+    }
+}
+
+void ComputeTonemap::set_params(const FilmicColorGrading::EvalParams &params)
+{
+    gpu_params p = {};
+    copy3(p.lin_color_filter_exposure, params.m_linColorFilterExposure);
+    p.saturation = params.m_saturation;
+    copy3(p.luminance_weights, params.m_luminanceWeights);
+    p.contrast_strength = params.m_contrastStrength;
+    copy3(p.lift, params.m_liftAdjust);
+    p.contrast_log_midpoint = params.m_contrastLogMidpoint;
+    copy3(p.inv_gamma, params.m_invGammaAdjust);
+    p.contrast_epsilon = params.m_contrastEpsilon;
+    copy3(p.gain, params.m_gainAdjust);
+    p.post_gamma = params.m_postGamma;
+
+    const FilmicToneCurve::FullCurve &curve = params.m_filmicCurve;
+    p.curve_w = curve.m_W;
+    p.curve_inv_w = curve.m_invW;
+    p.curve_x0 = curve.m_x0;
+    p.curve_x1 = curve.m_x1;
+    for (int i = 0; i < 3; ++i)
+    {
+        const FilmicToneCurve::CurveSegment &s = curve.m_segments[i];
+        p.segments[i].offset_x = s.m_offsetX;
+        p.segments[i].offset_y = s.m_offsetY;
+        p.segments[i].scale_x = s.m_scaleX;
+        p.segments[i].scale_y = s.m_scaleY;
+        p.segments[i].ln_a = s.m_lnA;
+        p.segments[i].b = s.m_B;
+    }
+
+    glNamedBufferSubData(_params_buffer, 0, sizeof(p), &p);
+}
+
+int ComputeTonemap::request(int view, GLenum ldr_format)
+{
+    const char *qualifier = image_format_qualifier(ldr_format);
+    if (!qualifier)
+        return -1;
+
+    char defines[128];
+    snprintf(defines, sizeof(defines), "#define VIEW %d\n#define LDR_FORMAT %s\n", view, qualifier);
+    return _shader_cache->request({ { GL_COMPUTE_SHADER, _shaders_path + "tonemap.comp" } }, defines);
+}
+
+bool ComputeTonemap::prepare(GLenum ldr_format, int nb_views)
+{
+    std::map<int, int> ids; // view -> request
+    for (int view = 0; view < nb_views; ++view)
+    {
+        if (_programs.find(std::make_pair(view, ldr_format)) == _programs.end())
+            ids[view] = request(view, ldr_format);
+    }
+    if (ids.empty())
+        return true;
+
+    _shader_cache->build();
+
+    bool ok = true;
+    for (const auto &id : ids)
+    {
+        if (!_shader_cache->program(id.second))
+        {
+            printf("FAILED to build the compute tonemap for view %d, format %s\n", id.first, glutils::color_format_name(ldr_format));
+            ok = false;
+        }
+        _programs[std::make_pair(id.first, ldr_format)] = id.second;
+    }
+    return ok;
+}
+
+GLuint ComputeTonemap::program(int view, GLenum ldr_format)
+{
+    auto it = _programs.find(std::make_pair(view, ldr_format));
+    if (it == _programs.end())
+    {
+        prepare(ldr_format, view + 1); // with the missing views before it, in the same build.
+        it = _programs.find(std::make_pair(view, ldr_format));
+    }
+
+    // by id: a reload may have swapped it.
+    return _shader_cache->program(it->second);
+}
+
+bool ComputeTonemap::dispatch(GLuint hdr_tex, GLuint ldr_tex, GLenum ldr_format, int width, int height, int view, bool auto_exposure)
+{
+    GLuint prog_id = program(view, ldr_format);
+    if (!prog_id)
+        return false;
+
+    glUseProgram(prog_id);
+    glProgramUniform1i(prog_id, 0, auto_exposure ? 1 : 0); // layout(location = 0)
+    glBindTextureUnit(0, hdr_tex);
+    glBindImageTexture(0, ldr_tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, ldr_format);
+    glBindBufferBase(GL_UNIFORM_BUFFER, params_binding, _params_buffer);
+
+    glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+    // read next by the blit to the screen, a readback or a sampler.
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, ldr_format);
+    glUseProgram(0);
+    return true;
+}
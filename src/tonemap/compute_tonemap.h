@@ -0,0 +1,95 @@
+#ifndef _COMPUTE_TONEMAP_2026_10_17_H_
+#define _COMPUTE_TONEMAP_2026_10_17_H_
+
+#include "FilmicCurve/FilmicColorGrading.h"
+
+#include <GL/glew.h>
+
+#include "shader_cache.h"
+
+#include <map>
+#include <string>
+#include <utility>
+
+//
+// Tonemap pass in a compute shader (tonemap.comp), writing the ldr texture as an image.
+//
+// The filmic grading is evaluated analytically: the EvalParams, with the 3 segments of the
+// filmic curve, are in a UBO, instead of baked in the 3D LUT. No white point either, the
+// shoulder segment saturates by itself.
+//
+// Each view mode, and each ldr format (the image format is in the shader), is a separate
+// program: the view is a #define, the shader has no branch on it. The permutations come
+// from the shader cache the first time they are dispatched, or all at once with prepare().
+//
+class ComputeTonemap
+{
+public:
+
+    // binding points, shared with the shader. The exposure SSBO is AutoExposure's.
+    static const GLuint params_binding = 2;
+
+    ComputeTonemap() = default;
+    ~ComputeTonemap();
+
+    ComputeTonemap(const ComputeTonemap &) = delete;
+    ComputeTonemap &operator=(const ComputeTonemap &) = delete;
+
+    // The programs are the cache's, it must outlive this.
+    bool init(const std::string &shaders_path, glutils::ShaderCache &shader_cache);
+    void shutdown();
+
+    // Builds the views [0, nb_views) for a format in one go, false if one fails.
+    bool prepare(GLenum ldr_format, int nb_views);
+
+    void set_params(const FilmicColorGrading::EvalParams &params);
+
+    // Reads hdr_tex, writes ldr_tex (rgba8, rgb10a2, rgba16f...). The exposure SSBO must be
+    // bound, see AutoExposure::bind_result. False if the permutation does not compile.
+    bool dispatch(GLuint hdr_tex, GLuint ldr_tex, GLenum ldr_format, int width, int height, int view, bool auto_exposure);
+
+    size_t nb_programs() const { return _programs.size(); }
+
+private:
+
+    // std140 layout of grading_params in tonemap.comp.
+    struct gpu_segment
+    {
+        float offset_x;
+        float offset_y;
+        float scale_x;
+        float scale_y;
+        float ln_a;
+        float b;
+        float padding[2];
+    };
+
+    struct gpu_params
+    {
+        float lin_color_filter_exposure[3];
+        float saturation;
+        float luminance_weights[3];
+        float contrast_strength;
+        float lift[3];
+        float contrast_log_midpoint;
+        float inv_gamma[3];
+        float contrast_epsilon;
+        float gain[3];
+        float post_gamma;
+        float curve_w;
+        float curve_inv_w;
+        float curve_x0;
+        float curve_x1;
+        gpu_segment segments[3];
+    };
+
+    GLuint program(int view, GLenum ldr_format);
+    int request(int view, GLenum ldr_format); // -1 if the format has no image qualifier.
+
+    std::string _shaders_path;
+    glutils::ShaderCache *_shader_cache = nullptr;
+    std::map<std::pair<int, GLenum>, int> _programs; // ids in the shader cache.
+    GLuint _params_buffer = 0;
+};
+
+#endif // _COMPUTE_TONEMAP_2026_10_17_H_
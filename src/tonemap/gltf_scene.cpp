@@ -0,0 +1,470 @@
+#include "gltf_scene.h"
+#include "scene_vertex.h"
+#include "gl_utils.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+// nodes deeper than this are ignored (cycles in a broken file).
+static const int gltf_max_node_depth = 64;
+
+// vertex attributes read from the primitives, at the locations of the scene shaders.
+static const struct
+{
+    const char *name;
+    GLuint location;
+} gltf_attributes[] = {
+    { "POSITION", POSITION_SHADER_ATTRIB_INDEX },
+    { "NORMAL", NORMAL_SHADER_ATTRIB_INDEX },
+    { "COLOR_0", COLOR_SHADER_ATTRIB_INDEX },
+    { "TEXCOORD_0", TEXCOORD_SHADER_ATTRIB_INDEX },
+};
+
+// The parser only keeps the encoded bytes, decoding is done afterwards, in parallel.
+static bool defer_image_decode(tinygltf::Image *image, std::string *, std::string *, int, int, const unsigned char *bytes, int size, void *)
+{
+    image->image.assign(bytes, bytes + size);
+    image->as_is = true;
+    return true;
+}
+
+static bool has_extension(const std::string &filename, const char *extension)
+{
+    const size_t length = strlen(extension);
+    if (filename.size() < length)
+        return false;
+
+    return std::equal(filename.end() - length, filename.end(), extension, [](char a, char b) { return tolower(a) == b; });
+}
+
+static glm::mat4 node_matrix(const tinygltf::Node &node)
+{
+    if (node.matrix.size() == 16)
+    {
+        float m[16];
+        std::copy(node.matrix.begin(), node.matrix.end(), m);
+        return glm::make_mat4(m); // column major, as in the file.
+    }
+
+    glm::mat4 matrix(1);
+    if (node.translation.size() == 3)
+    {
+        matrix = glm::translate(matrix, glm::vec3((float)node.translation[0], (float)node.translation[1], (float)node.translation[2]));
+    }
+    if (node.rotation.size() == 4)
+    {
+        // x y z w in the file.
+        glm::quat q((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]);
+        matrix = matrix * glm::toMat4(q);
+    }
+    if (node.scale.size() == 3)
+    {
+        matrix = glm::scale(matrix, glm::vec3((float)node.scale[0], (float)node.scale[1], (float)node.scale[2]));
+    }
+    return matrix;
+}
+
+GltfScene::~GltfScene()
+{
+    shutdown();
+}
+
+bool GltfScene::load(const std::string &filename, utils::ThreadPool &pool)
+{
+    shutdown();
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(defer_image_decode, nullptr);
+
+    std::string err;
+    std::string warn;
+    bool ret = has_extension(filename, ".glb")
+        ? loader.LoadBinaryFromFile(&_model, &err, &warn, filename)
+        : loader.LoadASCIIFromFile(&_model, &err, &warn, filename);
+    if (!warn.empty())
+    {
+        printf("WARN: %s\n", warn.c_str());
+    }
+    if (!err.empty())
+    {
+        printf("ERR: %s\n", err.c_str());
+    }
+    if (!ret)
+    {
+        printf("FAILED to parse: %s\n", filename.c_str());
+        return false;
+    }
+
+    //
+    // images, RGBA8. glTF texcoords start at the first row, so no flip. The stb_image flag
+    // is global and left alone: this can run next to other loads.
+    //
+    pool.parallel_for(_model.images.size(), 1, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            tinygltf::Image &image = _model.images[i];
+            if (!image.as_is)
+                continue;
+
+            int width, height, components;
+            unsigned char *pixels = stbi_load_from_memory(image.image.data(), (int)image.image.size(), &width, &height, &components, 4);
+            if (pixels)
+            {
+                image.image.assign(pixels, pixels + (size_t)width * height * 4);
+                image.width = width;
+                image.height = height;
+                image.component = 4;
+                stbi_image_free(pixels);
+            }
+            else
+            {
+                printf("WARN: could not decode image %zd \"%s\"\n", i, image.uri.c_str());
+                std::vector<unsigned char>().swap(image.image);
+            }
+            image.as_is = false;
+        }
+    });
+
+    //
+    // node hierarchy of the default scene, or of every scene if there is none.
+    //
+    _bbox_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    _bbox_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    if (_model.defaultScene >= 0 && _model.defaultScene < (int)_model.scenes.size())
+    {
+        for (int node : _model.scenes[_model.defaultScene].nodes)
+        {
+            add_node(node, glm::mat4(1), 0);
+        }
+    }
+    else
+    {
+        for (const auto &scene : _model.scenes)
+        {
+            for (int node : scene.nodes)
+            {
+                add_node(node, glm::mat4(1), 0);
+            }
+        }
+    }
+
+    printf("# meshes              = %zd\n", _model.meshes.size());
+    printf("# nodes               = %zd\n", _model.nodes.size());
+    printf("# mesh instances      = %zd\n", _draws.size());
+    printf("# images              = %zd\n", _model.images.size());
+
+    return true;
+}
+
+void GltfScene::add_node(int node_index, const glm::mat4 &parent, int depth)
+{
+    if (node_index < 0 || node_index >= (int)_model.nodes.size() || depth > gltf_max_node_depth)
+        return;
+
+    const tinygltf::Node &node = _model.nodes[node_index];
+    const glm::mat4 world = parent * node_matrix(node);
+
+    if (node.mesh >= 0 && node.mesh < (int)_model.meshes.size())
+    {
+        _draws.push_back({ node.mesh, world });
+
+        // POSITION min/max are required by the spec.
+        for (const auto &prim : _model.meshes[node.mesh].primitives)
+        {
+            auto it = prim.attributes.find("POSITION");
+            if (it == prim.attributes.end())
+                continue;
+
+            const tinygltf::Accessor &accessor = _model.accessors[it->second];
+            if (accessor.minValues.size() < 3 || accessor.maxValues.size() < 3)
+                continue;
+
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                glm::vec4 p(
+                    (float)((corner & 1) ? accessor.maxValues[0] : accessor.minValues[0]),
+                    (float)((corner & 2) ? accessor.maxValues[1] : accessor.minValues[1]),
+                    (float)((corner & 4) ? accessor.maxValues[2] : accessor.minValues[2]),
+                    1.0f);
+                glm::vec3 world_p = glm::vec3(world * p);
+                _bbox_min = glm::min(_bbox_min, world_p);
+                _bbox_max = glm::max(_bbox_max, world_p);
+            }
+        }
+    }
+
+    for (int child : node.children)
+    {
+        add_node(child, world, depth + 1);
+    }
+}
+
+void GltfScene::upload(glutils::AssetStreamer::Batch &batch)
+{
+    //
+    // buffer views read by the primitives, as they are in the file.
+    //
+    std::vector<bool> used_views(_model.bufferViews.size(), false);
+    auto use_accessor = [&](int accessor_index)
+    {
+        if (accessor_index >= 0 && accessor_index < (int)_model.accessors.size())
+        {
+            int view = _model.accessors[accessor_index].bufferView;
+            if (view >= 0 && view < (int)used_views.size())
+            {
+                used_views[view] = true;
+            }
+        }
+    };
+    for (const auto &mesh : _model.meshes)
+    {
+        for (const auto &prim : mesh.primitives)
+        {
+            for (const auto &attribute : gltf_attributes)
+            {
+                auto it = prim.attributes.find(attribute.name);
+                if (it != prim.attributes.end())
+                {
+                    use_accessor(it->second);
+                }
+            }
+            use_accessor(prim.indices);
+        }
+    }
+
+    _view_buffers.assign(_model.bufferViews.size(), 0);
+    for (size_t v = 0; v < _model.bufferViews.size(); ++v)
+    {
+        const tinygltf::BufferView &view = _model.bufferViews[v];
+        if (!used_views[v] || view.buffer < 0 || view.buffer >= (int)_model.buffers.size())
+            continue;
+
+        const tinygltf::Buffer &buffer = _model.buffers[view.buffer];
+        if (view.byteOffset + view.byteLength > buffer.data.size())
+        {
+            printf("WARN: buffer view %zd is out of its buffer\n", v);
+            continue;
+        }
+
+        glCreateBuffers(1, &_view_buffers[v]);
+        glNamedBufferStorage(_view_buffers[v], view.byteLength, nullptr, 0);
+        _gpu_memory += view.byteLength;
+
+        const unsigned char *src = buffer.data.data() + view.byteOffset;
+        batch.upload(_view_buffers[v], 0, view.byteLength, 1, [src](void *ptr, size_t first, size_t count)
+        {
+            memcpy(ptr, src + first, count);
+        });
+    }
+
+    //
+    // textures, sRGB with a full mip chain. Their sampler parameters are set on the texture.
+    //
+    _textures.assign(_model.textures.size(), 0);
+    for (size_t t = 0; t < _model.textures.size(); ++t)
+    {
+        const tinygltf::Texture &texture = _model.textures[t];
+        if (texture.source < 0 || texture.source >= (int)_model.images.size())
+            continue;
+
+        const tinygltf::Image &image = _model.images[texture.source];
+        if (image.image.empty() || image.component != 4)
+            continue;
+
+        int nb_levels = 1;
+        while ((std::max(image.width, image.height) >> nb_levels) > 0)
+            ++nb_levels;
+
+        GLuint tex;
+        glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+        glTextureStorage2D(tex, nb_levels, GL_SRGB8_ALPHA8, image.width, image.height);
+        batch.upload_texture(tex, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, 4, image.image.data());
+        _gpu_memory += (size_t)image.width * image.height * 4 * 4 / 3;
+
+        glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (texture.sampler >= 0 && texture.sampler < (int)_model.samplers.size())
+        {
+            // same enums as GL.
+            const tinygltf::Sampler &sampler = _model.samplers[texture.sampler];
+            if (sampler.minFilter > 0)
+                glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+            if (sampler.magFilter > 0)
+                glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+            glTextureParameteri(tex, GL_TEXTURE_WRAP_S, sampler.wrapS);
+            glTextureParameteri(tex, GL_TEXTURE_WRAP_T, sampler.wrapT);
+        }
+
+        _textures[t] = tex;
+    }
+
+    //
+    // one vao per primitive, one binding per attribute: the accessor offset goes in the
+    // binding, so it is not limited by GL_MAX_VERTEX_ATTRIB_RELATIVE_OFFSET.
+    //
+    _meshes.resize(_model.meshes.size());
+    for (size_t m = 0; m < _model.meshes.size(); ++m)
+    {
+        for (const auto &prim : _model.meshes[m].primitives)
+        {
+            auto position = prim.attributes.find("POSITION");
+            if (position == prim.attributes.end())
+                continue;
+
+            primitive p;
+            p.mode = (prim.mode >= 0) ? (GLenum)prim.mode : GL_TRIANGLES; // same enums as GL.
+            p.count = (GLsizei)_model.accessors[position->second].count;
+            glCreateVertexArrays(1, &p.vao);
+
+            bool valid = true;
+            for (const auto &attribute : gltf_attributes)
+            {
+                auto it = prim.attributes.find(attribute.name);
+                if (it == prim.attributes.end())
+                    continue;
+
+                const tinygltf::Accessor &accessor = _model.accessors[it->second];
+                if (accessor.bufferView < 0 || !_view_buffers[accessor.bufferView])
+                {
+                    valid = valid && (attribute.location != POSITION_SHADER_ATTRIB_INDEX);
+                    continue;
+                }
+
+                const int stride = accessor.ByteStride(_model.bufferViews[accessor.bufferView]);
+                const int nb_components = tinygltf::GetTypeSizeInBytes(accessor.type);
+                if (stride <= 0 || nb_components < 1 || nb_components > 4)
+                {
+                    valid = valid && (attribute.location != POSITION_SHADER_ATTRIB_INDEX);
+                    continue;
+                }
+
+                glVertexArrayVertexBuffer(p.vao, attribute.location, _view_buffers[accessor.bufferView], (GLintptr)accessor.byteOffset, stride);
+                glVertexArrayAttribFormat(p.vao, attribute.location, nb_components, (GLenum)accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, 0);
+                glVertexArrayAttribBinding(p.vao, attribute.location, attribute.location);
+                glEnableVertexArrayAttrib(p.vao, attribute.location);
+
+                p.has_normal = p.has_normal || (attribute.location == NORMAL_SHADER_ATTRIB_INDEX);
+                p.has_color = p.has_color || (attribute.location == COLOR_SHADER_ATTRIB_INDEX);
+                p.has_texcoord = p.has_texcoord || (attribute.location == TEXCOORD_SHADER_ATTRIB_INDEX);
+            }
+
+            if (prim.indices >= 0)
+            {
+                const tinygltf::Accessor &accessor = _model.accessors[prim.indices];
+                if (accessor.bufferView >= 0 && _view_buffers[accessor.bufferView])
+                {
+                    glVertexArrayElementBuffer(p.vao, _view_buffers[accessor.bufferView]);
+                    p.index_type = (GLenum)accessor.componentType; // same enums as GL.
+                    p.index_offset = accessor.byteOffset;
+                    p.count = (GLsizei)accessor.count;
+                }
+                else
+                {
+                    valid = false;
+                }
+            }
+
+            if (prim.material >= 0 && prim.material < (int)_model.materials.size())
+            {
+                const auto &values = _model.materials[prim.material].values;
+                auto it = values.find("baseColorTexture");
+                if (it != values.end())
+                {
+                    int texture = it->second.TextureIndex();
+                    if (texture >= 0 && texture < (int)_textures.size())
+                    {
+                        p.texture = _textures[texture];
+                    }
+                }
+            }
+
+            if (!valid)
+            {
+                glDeleteVertexArrays(1, &p.vao);
+                continue;
+            }
+            _meshes[m].push_back(p);
+        }
+    }
+
+    glutils::check_error();
+
+    // everything is on the gpu side (or in the ring) then.
+    batch.then([this]()
+    {
+        _model = tinygltf::Model();
+        _ready = true;
+    });
+}
+
+void GltfScene::shutdown()
+{
+    for (auto &mesh : _meshes)
+    {
+        for (auto &p : mesh)
+        {
+            glDeleteVertexArrays(1, &p.vao);
+        }
+    }
+    for (GLuint buffer : _view_buffers)
+    {
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    }
+    for (GLuint tex : _textures)
+    {
+        if (tex)
+            glDeleteTextures(1, &tex);
+    }
+
+    _meshes.clear();
+    _view_buffers.clear();
+    _textures.clear();
+    _draws.clear();
+    _model = tinygltf::Model();
+    _gpu_memory = 0;
+    _ready = false;
+}
+
+void GltfScene::draw(GLuint program, GLint uni_model, const glm::mat4 &scene_transform, GLuint default_texture, GLuint default_sampler) const
+{
+    if (!_ready)
+        return;
+
+    for (const auto &item : _draws)
+    {
+        const glm::mat4 model = scene_transform * item.world;
+        glProgramUniformMatrix4fv(program, uni_model, 1, GL_FALSE, glm::value_ptr(model));
+
+        for (const auto &p : _meshes[item.mesh])
+        {
+            // missing attributes read the current generic values.
+            if (!p.has_normal)
+                glVertexAttrib3f(NORMAL_SHADER_ATTRIB_INDEX, 0.0f, 1.0f, 0.0f); // default normal = UP
+            if (!p.has_color)
+                glVertexAttrib3f(COLOR_SHADER_ATTRIB_INDEX, 1.0f, 1.0f, 1.0f);
+            if (!p.has_texcoord)
+                glVertexAttrib2f(TEXCOORD_SHADER_ATTRIB_INDEX, 0.0f, 0.0f); // default TC = 0,0
+
+            // a glTF texture has its own sampling parameters.
+            glBindSampler(0, p.texture ? 0 : default_sampler);
+            glBindTextureUnit(0, p.texture ? p.texture : default_texture);
+
+            glBindVertexArray(p.vao);
+            if (p.index_type)
+            {
+                glDrawElements(p.mode, p.count, p.index_type, (void*)p.index_offset);
+            }
+            else
+            {
+                glDrawArrays(p.mode, 0, p.count);
+            }
+        }
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,89 @@
+#ifndef _GLTF_SCENE_2026_10_17_H_
+#define _GLTF_SCENE_2026_10_17_H_
+
+#include <GL/glew.h>
+#include "glm_usage.h"
+#include "tiny_gltf.h"
+#include "asset_streamer.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+
+//
+// glTF 2.0 scene (.gltf or .glb), drawn from its own buffers.
+//
+// The buffer views read by the accessors are uploaded as they are, and each primitive gets
+// a vao reading them through the accessor offsets and view strides (one binding per
+// attribute): nothing is repacked on the cpu. The images are only copied by the parser,
+// and decoded in parallel afterwards.
+//
+// load() only touches the cpu and can run on any thread, upload() needs the GL context.
+//
+class GltfScene
+{
+public:
+
+    GltfScene() = default;
+    ~GltfScene();
+
+    GltfScene(const GltfScene &) = delete;
+    GltfScene &operator=(const GltfScene &) = delete;
+
+    // parse, node hierarchy, image decode.
+    bool load(const std::string &filename, utils::ThreadPool &pool = utils::thread_pool());
+
+    // buffer views, vaos and textures, their contents queued in the batch. Once it is done,
+    // the cpu copies of the buffers and images are released and the scene is ready.
+    void upload(glutils::AssetStreamer::Batch &batch);
+    void shutdown();
+
+    // Every mesh instance (nothing until ready), with model = scene_transform * node world matrix.
+    // Unit 0 gets the base color texture of the material, or the default texture and sampler.
+    void draw(GLuint program, GLint uni_model, const glm::mat4 &scene_transform, GLuint default_texture, GLuint default_sampler) const;
+
+    const glm::vec3 &bbox_min() const { return _bbox_min; }
+    const glm::vec3 &bbox_max() const { return _bbox_max; }
+    bool empty() const { return _draws.empty(); }
+    bool ready() const { return _ready; }
+
+    size_t nb_draws() const { return _draws.size(); }
+    size_t gpu_memory() const { return _gpu_memory; }
+
+private:
+
+    void add_node(int node_index, const glm::mat4 &parent, int depth);
+
+    struct primitive
+    {
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLsizei count = 0;
+        GLenum index_type = 0; // 0: not indexed.
+        size_t index_offset = 0;
+        GLuint texture = 0;
+        bool has_normal = false;
+        bool has_color = false;
+        bool has_texcoord = false;
+    };
+
+    struct draw_item
+    {
+        int mesh;
+        glm::mat4 world;
+    };
+
+    tinygltf::Model _model;
+
+    std::vector<GLuint> _view_buffers; // per buffer view, 0 if no accessor reads it.
+    std::vector<GLuint> _textures; // per texture, 0 if its image could not be decoded.
+    std::vector<std::vector<primitive>> _meshes;
+    std::vector<draw_item> _draws;
+
+    glm::vec3 _bbox_min;
+    glm::vec3 _bbox_max;
+    size_t _gpu_memory = 0;
+    bool _ready = false;
+};
+
+#endif // _GLTF_SCENE_2026_10_17_H_
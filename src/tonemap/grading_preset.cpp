@@ -0,0 +1,412 @@
+#include "grading_preset.h"
+
+#include "json.hpp"
+
+#include <fstream>
+#include <stdio.h>
+
+using nlohmann::json;
+using UserParams = FilmicColorGrading::UserParams;
+using RawParams = FilmicColorGrading::RawParams;
+using BakedParams = FilmicColorGrading::BakedParams;
+using CurveParams = FilmicToneCurve::CurveParamsDirect;
+
+template <typename T>
+struct float_param
+{
+    const char *name;
+    float T::*member;
+};
+
+template <typename T>
+struct vec3_param
+{
+    const char *name;
+    Vec3 T::*member;
+};
+
+static const float_param<UserParams> float_params[] =
+{
+    { "saturation", &UserParams::m_saturation },
+    { "exposure_bias", &UserParams::m_exposureBias },
+    { "contrast", &UserParams::m_contrast },
+    { "toe_strength", &UserParams::m_filmicToeStrength },
+    { "toe_length", &UserParams::m_filmicToeLength },
+    { "shoulder_strength", &UserParams::m_filmicShoulderStrength },
+    { "shoulder_length", &UserParams::m_filmicShoulderLength },
+    { "shoulder_angle", &UserParams::m_filmicShoulderAngle },
+    { "filmic_gamma", &UserParams::m_filmicGamma },
+    { "post_gamma", &UserParams::m_postGamma },
+    { "shadow_offset", &UserParams::m_shadowOffset },
+    { "midtone_offset", &UserParams::m_midtoneOffset },
+    { "highlight_offset", &UserParams::m_highlightOffset },
+};
+
+static const vec3_param<UserParams> vec3_params[] =
+{
+    { "color_filter", &UserParams::m_colorFilter },
+    { "shadow_color", &UserParams::m_shadowColor },
+    { "midtone_color", &UserParams::m_midtoneColor },
+    { "highlight_color", &UserParams::m_highlightColor },
+};
+
+static const float_param<RawParams> raw_float_params[] =
+{
+    { "saturation", &RawParams::m_saturation },
+    { "exposure_bias", &RawParams::m_exposureBias },
+    { "contrast_strength", &RawParams::m_contrastStrength },
+    { "contrast_midpoint", &RawParams::m_contrastMidpoint },
+    { "contrast_epsilon", &RawParams::m_contrastEpsilon },
+    { "post_gamma", &RawParams::m_postGamma },
+};
+
+static const vec3_param<RawParams> raw_vec3_params[] =
+{
+    { "color_filter", &RawParams::m_colorFilter },
+    { "luminance_weights", &RawParams::m_luminanceWeights },
+    { "lift_adjust", &RawParams::m_liftAdjust },
+    { "gamma_adjust", &RawParams::m_gammaAdjust },
+    { "gain_adjust", &RawParams::m_gainAdjust },
+};
+
+// raw "filmic_curve" object.
+static const float_param<CurveParams> curve_params[] =
+{
+    { "x0", &CurveParams::m_x0 },
+    { "y0", &CurveParams::m_y0 },
+    { "x1", &CurveParams::m_x1 },
+    { "y1", &CurveParams::m_y1 },
+    { "w", &CurveParams::m_W },
+    { "overshoot_x", &CurveParams::m_overshootX },
+    { "overshoot_y", &CurveParams::m_overshootY },
+    { "gamma", &CurveParams::m_gamma },
+};
+
+static const float_param<BakedParams> baked_float_params[] =
+{
+    { "saturation", &BakedParams::m_saturation },
+};
+
+static const vec3_param<BakedParams> baked_vec3_params[] =
+{
+    { "lin_color_filter_exposure", &BakedParams::m_linColorFilterExposure },
+    { "luminance_weights", &BakedParams::m_luminanceWeights },
+};
+
+static const char *spacing_names[FilmicColorGrading::kTableSpacing_Num] = { "linear", "quadratic", "quartic" };
+
+static bool is_vec3(const json &j)
+{
+    return j.is_array() && j.size() == 3 && j[0].is_number() && j[1].is_number() && j[2].is_number();
+}
+
+// The floats go through doubles: they read back bit-exact.
+template <typename T, size_t F, size_t V>
+static void params_to_json(const T &params, const float_param<T> (&floats)[F], const vec3_param<T> (&vec3s)[V], json *j)
+{
+    for (const auto &p : floats)
+    {
+        (*j)[p.name] = params.*p.member;
+    }
+    for (const auto &p : vec3s)
+    {
+        const Vec3 &v = params.*p.member;
+        (*j)[p.name] = { v.x, v.y, v.z };
+    }
+}
+
+// Missing keys keep their value, other keys are for the caller. False: *bad names the bad value.
+template <typename T, size_t F, size_t V>
+static bool params_from_json(const json &j, const float_param<T> (&floats)[F], const vec3_param<T> (&vec3s)[V], T *params, std::string *bad)
+{
+    for (const auto &p : floats)
+    {
+        json::const_iterator it = j.find(p.name);
+        if (it == j.end())
+            continue;
+        if (!it->is_number())
+        {
+            *bad = p.name;
+            return false;
+        }
+        params->*p.member = it->get<float>();
+    }
+    for (const auto &p : vec3s)
+    {
+        json::const_iterator it = j.find(p.name);
+        if (it == j.end())
+            continue;
+        if (!is_vec3(*it))
+        {
+            *bad = p.name;
+            return false;
+        }
+        params->*p.member = Vec3((*it)[0].get<float>(), (*it)[1].get<float>(), (*it)[2].get<float>());
+    }
+    return true;
+}
+
+static json raw_to_json(const RawParams &raw)
+{
+    json j;
+    params_to_json(raw, raw_float_params, raw_vec3_params, &j);
+    json curve;
+    for (const auto &p : curve_params)
+    {
+        curve[p.name] = raw.m_filmicCurve.*p.member;
+    }
+    j["filmic_curve"] = curve;
+    return j;
+}
+
+static bool raw_from_json(const json &j, RawParams *raw, std::string *bad)
+{
+    if (!j.is_object())
+    {
+        *bad = "raw";
+        return false;
+    }
+    if (!params_from_json(j, raw_float_params, raw_vec3_params, raw, bad))
+        return false;
+
+    auto curve = j.find("filmic_curve");
+    if (curve == j.end())
+        return true;
+    if (!curve->is_object())
+    {
+        *bad = "filmic_curve";
+        return false;
+    }
+    for (const auto &p : curve_params)
+    {
+        auto it = curve->find(p.name);
+        if (it == curve->end())
+            continue;
+        if (!it->is_number())
+        {
+            *bad = std::string("filmic_curve.") + p.name;
+            return false;
+        }
+        raw->m_filmicCurve.*p.member = it->get<float>();
+    }
+    return true;
+}
+
+static json baked_to_json(const BakedParams &baked)
+{
+    json j;
+    params_to_json(baked, baked_float_params, baked_vec3_params, &j);
+    j["curve_size"] = baked.m_curveSize;
+    j["spacing"] = spacing_names[baked.m_spacing];
+    j["curve_r"] = baked.m_curveR;
+    j["curve_g"] = baked.m_curveG;
+    j["curve_b"] = baked.m_curveB;
+    return j;
+}
+
+// The tables are needed, the scalars keep their value if missing.
+static bool baked_from_json(const json &j, BakedParams *baked, std::string *bad)
+{
+    if (!j.is_object())
+    {
+        *bad = "baked";
+        return false;
+    }
+    if (!params_from_json(j, baked_float_params, baked_vec3_params, baked, bad))
+        return false;
+
+    auto size = j.find("curve_size");
+    if (size == j.end() || !size->is_number_integer() || size->get<int>() < 2)
+    {
+        *bad = "curve_size";
+        return false;
+    }
+    baked->m_curveSize = size->get<int>();
+
+    auto spacing = j.find("spacing");
+    if (spacing != j.end())
+    {
+        int found = -1;
+        for (int i = 0; i < FilmicColorGrading::kTableSpacing_Num; ++i)
+        {
+            if (spacing->is_string() && spacing->get<std::string>() == spacing_names[i])
+                found = i;
+        }
+        if (found < 0)
+        {
+            *bad = "spacing";
+            return false;
+        }
+        baked->m_spacing = (FilmicColorGrading::eTableSpacing)found;
+    }
+
+    const std::pair<const char*, std::vector<float> BakedParams::*> curves[] =
+    {
+        { "curve_r", &BakedParams::m_curveR },
+        { "curve_g", &BakedParams::m_curveG },
+        { "curve_b", &BakedParams::m_curveB },
+    };
+    for (const auto &c : curves)
+    {
+        auto it = j.find(c.first);
+        bool valid = it != j.end() && it->is_array() && it->size() == size_t(baked->m_curveSize);
+        for (size_t i = 0; valid && i < it->size(); ++i)
+        {
+            valid = (*it)[i].is_number();
+        }
+        if (!valid)
+        {
+            *bad = c.first;
+            return false;
+        }
+        baked->*c.second = it->get<std::vector<float>>();
+    }
+    return true;
+}
+
+static bool read_json(const std::string &filename, json *j)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        printf("FAILED to open the grading preset \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    *j = json::parse(in, nullptr, false);
+    if (j->is_discarded() || !j->is_object())
+    {
+        printf("FAILED to parse the grading preset \"%s\"\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GradingPreset::load(const std::string &filename)
+{
+    json j;
+    if (!read_json(filename, &j))
+        return false;
+
+    // into a copy: a bad value leaves the params as they were.
+    GradingPreset preset = *this;
+    for (auto it = j.begin(); it != j.end(); ++it)
+    {
+        bool known = false;
+        bool valid = false;
+        for (const auto &p : float_params)
+        {
+            if (it.key() == p.name)
+            {
+                known = true;
+                valid = it->is_number();
+                if (valid)
+                    preset.user.*p.member = it->get<float>();
+            }
+        }
+        for (const auto &p : vec3_params)
+        {
+            if (it.key() == p.name)
+            {
+                known = true;
+                valid = is_vec3(*it);
+                if (valid)
+                    preset.user.*p.member = Vec3((*it)[0].get<float>(), (*it)[1].get<float>(), (*it)[2].get<float>());
+            }
+        }
+        if (it.key() == "aces_gamma")
+        {
+            known = true;
+            valid = it->is_number();
+            if (valid)
+                preset.aces_gamma = it->get<float>();
+        }
+        if (it.key() == "raw" || it.key() == "baked")
+        {
+            known = true; // derived from the above, see load_derived().
+            valid = true;
+        }
+
+        if (!known)
+        {
+            printf("Grading preset \"%s\": unknown \"%s\", ignored\n", filename.c_str(), it.key().c_str());
+        }
+        else if (!valid)
+        {
+            printf("FAILED to read the grading preset \"%s\": bad \"%s\"\n", filename.c_str(), it.key().c_str());
+            return false;
+        }
+    }
+
+    *this = preset;
+    return true;
+}
+
+bool GradingPreset::save(const std::string &filename, bool with_derived) const
+{
+    json j;
+    params_to_json(user, float_params, vec3_params, &j);
+    j["aces_gamma"] = aces_gamma;
+
+    if (with_derived)
+    {
+        RawParams raw;
+        BakedParams baked;
+        bake(&baked, &raw);
+        j["raw"] = raw_to_json(raw);
+        j["baked"] = baked_to_json(baked);
+    }
+
+    std::ofstream out(filename);
+    if (!out)
+    {
+        printf("FAILED to write the grading preset \"%s\"\n", filename.c_str());
+        return false;
+    }
+    out << j.dump(2) << std::endl;
+    return true;
+}
+
+void GradingPreset::bake(FilmicColorGrading::BakedParams *baked, FilmicColorGrading::RawParams *raw, int curve_size) const
+{
+    FilmicColorGrading::RawParams raw_params;
+    FilmicColorGrading::EvalParams eval;
+    FilmicColorGrading::RawFromUserParams(raw_params, user);
+    FilmicColorGrading::EvalFromRawParams(eval, raw_params);
+    FilmicColorGrading::BakeFromEvalParams(*baked, eval, curve_size, FilmicColorGrading::kTableSpacing_Quadratic);
+    if (raw)
+        *raw = raw_params;
+}
+
+bool GradingPreset::load_derived(const std::string &filename, FilmicColorGrading::RawParams *raw, FilmicColorGrading::BakedParams *baked)
+{
+    json j;
+    if (!read_json(filename, &j))
+        return false;
+
+    RawParams raw_params;
+    BakedParams baked_params;
+    std::string bad;
+    bool ok = true;
+    if (raw)
+    {
+        bad = "raw";
+        ok = j.count("raw") && raw_from_json(j["raw"], &raw_params, &bad);
+    }
+    if (ok && baked)
+    {
+        bad = "baked";
+        ok = j.count("baked") && baked_from_json(j["baked"], &baked_params, &bad);
+    }
+    if (!ok)
+    {
+        printf("FAILED to read the grading preset \"%s\": bad or missing \"%s\"\n", filename.c_str(), bad.c_str());
+        return false;
+    }
+
+    if (raw)
+        *raw = raw_params;
+    if (baked)
+        *baked = baked_params;
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef _GRADING_PRESET_2026_10_17_H_
+#define _GRADING_PRESET_2026_10_17_H_
+
+#include "FilmicCurve/FilmicColorGrading.h"
+
+#include <string>
+
+//
+// The grading user params and the ACES gamma, as a JSON object:
+//   { "exposure_bias": 0.5, "color_filter": [1, 0.95, 0.9], "toe_strength": 0.2, ... }
+// Missing keys keep their value, a preset can set only a few params. Saved by the app (F7),
+// and reloaded when the file changes.
+//
+// Saved with_derived, the file also has the params the user ones lead to: a "raw" object
+// (RawParams, the curve in "filmic_curve") and a "baked" one (BakedParams, the tables as
+// arrays). Written for tools that grade from the tables alone and to diff two gradings;
+// load() skips them and load_derived() reads them back.
+//
+class GradingPreset
+{
+public:
+
+    FilmicColorGrading::UserParams user;
+    float aces_gamma = 1.0f;
+
+    // false: left unchanged.
+    bool load(const std::string &filename);
+    bool save(const std::string &filename, bool with_derived = false) const;
+
+    // RawFromUserParams, EvalFromRawParams and BakeFromEvalParams, quadratic spacing.
+    void bake(FilmicColorGrading::BakedParams *baked, FilmicColorGrading::RawParams *raw = nullptr, int curve_size = 1024) const;
+
+    // The "raw" and "baked" objects of a file saved with_derived, null to skip one.
+    // false: missing or bad, left unchanged.
+    static bool load_derived(const std::string &filename, FilmicColorGrading::RawParams *raw, FilmicColorGrading::BakedParams *baked);
+};
+
+#endif // _GRADING_PRESET_2026_10_17_H_
@@ -0,0 +1,131 @@
+#include "lut_baker.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <stdio.h>
+
+const int LutBaker::sizes[LutBaker::nb_sizes] = { 17, 33, 65, 129 };
+
+LutBaker::~LutBaker()
+{
+    shutdown();
+}
+
+bool LutBaker::init(int size)
+{
+    bool supported = false;
+    for (int i = 0; i < nb_sizes; ++i)
+    {
+        supported = supported || (sizes[i] == size);
+    }
+    if (!supported)
+    {
+        printf("3D LUT size %d not supported\n", size);
+        return false;
+    }
+
+    shutdown();
+
+    _size = size;
+    _region_floats = (size_t)size * size * size * 3;
+
+    glCreateTextures(GL_TEXTURE_3D, 1, &_tex);
+    glTextureStorage3D(_tex, 1, GL_RGB32F, size, size, size);
+
+    // persistent + coherent: no flush needed, the fence after the upload is enough.
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr pbo_size = (GLsizeiptr)(nb_regions * _region_floats * sizeof(float));
+    glCreateBuffers(1, &_pbo);
+    glNamedBufferStorage(_pbo, pbo_size, nullptr, flags);
+    _mapped = (float*)glMapNamedBufferRange(_pbo, 0, pbo_size, flags);
+
+    return _mapped != nullptr;
+}
+
+void LutBaker::shutdown()
+{
+    for (auto &fence : _fences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (_pbo)
+    {
+        glUnmapNamedBuffer(_pbo);
+        glDeleteBuffers(1, &_pbo);
+        _pbo = 0;
+        _mapped = nullptr;
+    }
+
+    if (_tex)
+    {
+        glDeleteTextures(1, &_tex);
+        _tex = 0;
+    }
+
+    _current_region = 0;
+    _size = 0;
+}
+
+void LutBaker::bake(const FilmicColorGrading::BakedParams &params, float white_point)
+{
+    if (!_mapped)
+    {
+        return;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    // wait for the gpu to be done reading this region.
+    GLsync &fence = _fences[_current_region];
+    if (fence)
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    const int n = _size;
+    const float step = white_point / (float)(n - 1);
+    float *region = _mapped + _current_region * _region_floats;
+
+    // one blue slice per chunk, rows evaluated in place.
+    utils::thread_pool().parallel_for((size_t)n, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t b = begin; b < end; ++b)
+        {
+            for (int g = 0; g < n; ++g)
+            {
+                float *row = region + ((b * n + g) * n) * 3;
+                for (int r = 0; r < n; ++r)
+                {
+                    row[r * 3 + 0] = r * step;
+                    row[r * 3 + 1] = g * step;
+                    row[r * 3 + 2] = b * step;
+                }
+                params.EvalColorBatch(row, row, (size_t)n);
+            }
+        }
+    });
+
+    // rows of RGB32F are always 4 bytes aligned.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+    glTextureSubImage3D(_tex, 0, 0, 0, 0, n, n, n, GL_RGB, GL_FLOAT,
+        (const void*)(_current_region * _region_floats * sizeof(float)));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    _current_region = (_current_region + 1) % nb_regions;
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    _wait_ms = std::chrono::duration<float, std::milli>(t1 - t0).count();
+    _bake_ms = std::chrono::duration<float, std::milli>(t2 - t0).count();
+}
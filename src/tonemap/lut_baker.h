@@ -0,0 +1,60 @@
+#ifndef _LUT_BAKER_2026_10_17_H_
+#define _LUT_BAKER_2026_10_17_H_
+
+#include "FilmicCurve/FilmicColorGrading.h"
+
+#include <GL/glew.h>
+
+//
+// Bakes the filmic color grading into a 3D LUT texture (RGB32F, size^3).
+//
+// The blue slices are split across the thread pool, and each slice is evaluated
+// in place with BakedParams::EvalColorBatch, directly into a persistently mapped PBO.
+// The PBO has 2 regions used in turn, so the cpu bake only waits on the gpu if
+// the upload of the bake before the previous one is still pending.
+//
+class LutBaker
+{
+public:
+
+    // supported sizes, for the gui.
+    static const int nb_sizes = 4;
+    static const int sizes[nb_sizes]; // 17, 33, 65, 129
+
+    LutBaker() = default;
+    ~LutBaker();
+
+    LutBaker(const LutBaker &) = delete;
+    LutBaker &operator=(const LutBaker &) = delete;
+
+    // (re)creates the texture and the PBO. Returns false on an unsupported size.
+    bool init(int size);
+    void shutdown();
+
+    // input colors cover [0..white_point], as in the tonemap shader.
+    void bake(const FilmicColorGrading::BakedParams &params, float white_point);
+
+    GLuint texture() const { return _tex; }
+    int size() const { return _size; }
+
+    // timings of the last bake, in ms.
+    float bake_ms() const { return _bake_ms; }
+    float wait_ms() const { return _wait_ms; }
+
+private:
+
+    GLuint _tex = 0;
+    GLuint _pbo = 0;
+    float *_mapped = nullptr;
+
+    static const int nb_regions = 2;
+    GLsync _fences[nb_regions] = {};
+    int _current_region = 0;
+    size_t _region_floats = 0;
+
+    int _size = 0;
+    float _bake_ms = 0.0f;
+    float _wait_ms = 0.0f;
+};
+
+#endif // _LUT_BAKER_2026_10_17_H_
@@ -2,7 +2,10 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "gl_utils.h"
+#include "profiler.h"
+#include "headless.h"
 #include "app_test.h"
+#include "microbench.h"
 
 #include <chrono>
 #include <string>
@@ -164,10 +167,32 @@ int main(int argc, char **argv)
     options.add_options()
         ("w,width", "Window width", cxxopts::value<int>()->default_value("1280"))
         ("h,height", "Window height", cxxopts::value<int>()->default_value("720"))
-        ("i,input", "Input filename", cxxopts::value<std::string>())
+        ("i,input", "Input scene (.obj, .gltf or .glb)", cxxopts::value<std::string>())
         ("x,exit", "Exit without rendering", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
         ("v,verbose", "Prints text", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
         ("V,extra-verbose", "Prints extra text", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("microbench", "Runs a CPU micro-benchmark and exits (grading, icosphere, obj)", cxxopts::value<std::string>())
+        ("validate-exposure", "Checks the gpu luminance histogram against the cpu reference and exits", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("rebuild-cache", "Re-parses the input mesh and rewrites its binary cache", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("upload-budget", "MB uploaded per frame by the asset streaming", cxxopts::value<int>()->default_value("16"))
+        ("env", "Environment map (.hdr, or .hdrmips from hdrtonemap)", cxxopts::value<std::string>())
+        ("env-format", "Environment map texels: rgb9e5, r11g11b10f, rgb16f or rgb32f", cxxopts::value<std::string>()->default_value("rgb9e5"))
+        ("hdr-format", "HDR framebuffer: rgba16f, r11g11b10f or rgba32f", cxxopts::value<std::string>()->default_value("rgba32f"))
+        ("ldr-format", "LDR framebuffer: rgba8, rgb10a2 or rgba16f", cxxopts::value<std::string>()->default_value("rgba8"))
+        ("fb-bench", "Renders N frames per framebuffer format pair, prints the gpu times and exits", cxxopts::value<int>()->default_value("0")->implicit_value("200"))
+        ("benchmark", "Plays the camera path for N frames without vsync, writes the frame times and exits", cxxopts::value<int>()->default_value("0")->implicit_value("600"))
+        ("camera-path", "Camera path played by --benchmark, or written by F5 (default: an orbit, camera_path.txt)", cxxopts::value<std::string>())
+        ("benchmark-out", "JSON report of --benchmark", cxxopts::value<std::string>()->default_value("benchmark.json"))
+        ("compute-tonemap", "Tonemaps in a compute shader, with the filmic grading evaluated analytically", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("tonemap-bench", "Times N passes of the compute tonemap and of the LUT one at each size, prints their errors and exits", cxxopts::value<int>()->default_value("0")->implicit_value("100"))
+        ("headless", "Renders without a window, through egl or osmesa", cxxopts::value<std::string>()->implicit_value("egl"))
+        ("frames", "Frames rendered by --headless once the scene is loaded", cxxopts::value<int>()->default_value("1"))
+        ("o,output", "PNG written by --headless, from the last frame", cxxopts::value<std::string>())
+        ("capture", "Writes every frame once the scene is loaded, as <prefix>000000.png... (F6 toggles, default capture/frame_)", cxxopts::value<std::string>())
+        ("capture-hdr", "Also writes the HDR framebuffer of the captured frames, as <prefix>000000.hdr...", cxxopts::value<int>()->default_value("0")->implicit_value("1"))
+        ("texture-cache", "Directory of the converted textures, empty to disable", cxxopts::value<std::string>()->default_value("texture_cache"))
+        ("shader-cache", "Directory of the linked program binaries, empty to disable", cxxopts::value<std::string>()->default_value("shader_cache"))
+        ("preset", "Grading preset (JSON), loaded if it exists, reloaded when it changes, written by F7", cxxopts::value<std::string>()->default_value("grading.json"))
         ;
 
     options.parse(argc, argv);
@@ -180,6 +205,28 @@ int main(int argc, char **argv)
         int dontrender;
         int verbose;
         int extraverbose;
+        std::string microbench;
+        int validate_exposure;
+        int rebuild_mesh_cache;
+        int upload_budget_mb;
+        std::string env_format;
+        std::string env_filename;
+        std::string texture_cache_dir;
+        std::string hdr_format;
+        std::string ldr_format;
+        int fb_bench_frames;
+        int benchmark_frames;
+        std::string camera_path;
+        std::string benchmark_out;
+        std::string headless;
+        int headless_frames;
+        std::string output;
+        std::string capture;
+        int capture_hdr;
+        int compute_tonemap;
+        int tonemap_bench_frames;
+        std::string shader_cache_dir;
+        std::string preset;
     } o;
 
     // parse
@@ -189,6 +236,28 @@ int main(int argc, char **argv)
     o.dontrender = options["x"].as<int>();
     o.verbose = options["v"].as<int>();
     o.extraverbose = options["extra-verbose"].as<int>();
+    o.microbench = options["microbench"].as<std::string>();
+    o.validate_exposure = options["validate-exposure"].as<int>();
+    o.rebuild_mesh_cache = options["rebuild-cache"].as<int>();
+    o.upload_budget_mb = options["upload-budget"].as<int>();
+    o.env_format = options["env-format"].as<std::string>();
+    o.env_filename = options["env"].as<std::string>();
+    o.texture_cache_dir = options["texture-cache"].as<std::string>();
+    o.hdr_format = options["hdr-format"].as<std::string>();
+    o.ldr_format = options["ldr-format"].as<std::string>();
+    o.fb_bench_frames = options["fb-bench"].as<int>();
+    o.benchmark_frames = options["benchmark"].as<int>();
+    o.camera_path = options["camera-path"].as<std::string>();
+    o.benchmark_out = options["benchmark-out"].as<std::string>();
+    o.headless = options["headless"].as<std::string>();
+    o.headless_frames = options["frames"].as<int>();
+    o.output = options["o"].as<std::string>();
+    o.capture = options["capture"].as<std::string>();
+    o.capture_hdr = options["capture-hdr"].as<int>();
+    o.compute_tonemap = options["compute-tonemap"].as<int>();
+    o.tonemap_bench_frames = options["tonemap-bench"].as<int>();
+    o.shader_cache_dir = options["shader-cache"].as<std::string>();
+    o.preset = options["preset"].as<std::string>();
 
     if (o.verbose)
     {
@@ -205,12 +274,49 @@ int main(int argc, char **argv)
         std::cout << "Extra verbose       : " << o.extraverbose << "\n";
     }
 
+    //
+    // MICRO-BENCHMARKS - cpu only, no window
+    //
+
+    if (!o.microbench.empty())
+    {
+        return run_microbench(o.microbench) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     //
     // APP
     //
 
     App *app = new AppTest((void*)&o);
 
+    //
+    // HEADLESS - no window, no display needed
+    //
+
+    if (!o.headless.empty())
+    {
+        glutils::HeadlessOptions headless;
+        headless.backend = o.headless;
+        headless.width = o.width;
+        headless.height = o.height;
+        headless.nb_frames = o.headless_frames;
+        headless.output = o.output;
+
+        // these end by themselves.
+        if (o.benchmark_frames > 0 || o.fb_bench_frames > 0 || o.tonemap_bench_frames > 0 || o.validate_exposure)
+        {
+            headless.nb_frames = -1;
+        }
+        if (o.dontrender)
+        {
+            headless.nb_frames = 0;
+        }
+
+        int exit_code = glutils::run_headless(app, headless);
+        delete app;
+        return exit_code;
+    }
+
     //
     // GLFW
     //
@@ -262,7 +368,7 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
     
-    glfwSwapInterval(1); // ou pas hein!
+    glfwSwapInterval(o.benchmark_frames > 0 ? 0 : 1); // the benchmark measures the frames, not the display.
 
     //
     // IMGUI
@@ -306,7 +412,7 @@ int main(int argc, char **argv)
     // Main Loop
     //
 
-    while (!glfwWindowShouldClose(window))
+    while (!o.dontrender && !glfwWindowShouldClose(window) && !app->should_exit())
     {
         glfwPollEvents();
 
@@ -335,10 +441,15 @@ int main(int argc, char **argv)
         //    ImGui::ShowDemoWindow(&show_demo_window);
         //}
 
+        glutils::profiler().begin_frame();
         run(window, dt);
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            glutils::ProfileScope scope("imgui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        glutils::profiler().end_frame();
         glfwSwapBuffers(window);
     }
 
@@ -346,11 +457,13 @@ int main(int argc, char **argv)
     // Cleanup
     //
 
+    app->shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     glfwDestroyWindow(window);
     glfwTerminate();
+    int exit_code = app->exit_code();
     delete app;
-    return EXIT_SUCCESS;
+    return exit_code;
 }
@@ -0,0 +1,196 @@
+#include "mesh_cache.h"
+
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+
+// bump when the layout or the conversion changes.
+static const uint32_t mesh_cache_version = 2;
+static const char mesh_cache_magic[8] = { 'G', 'L', 'X', 'P', 'M', 'S', 'H', '\0' };
+
+// sections start aligned, for the mapped reads.
+static const uint64_t mesh_cache_alignment = 16;
+
+// written by chunks of this size.
+static const size_t mesh_cache_chunk_size = 4 * 1024 * 1024;
+
+struct mesh_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertex_size;
+    uint64_t source_size;
+    uint64_t source_stamp; // hash of size and mtime.
+    uint64_t nb_shapes;
+    uint64_t nb_vertices;
+    uint64_t nb_indices;
+    uint64_t shapes_offset;
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    uint64_t file_size;
+};
+
+static uint64_t align_offset(uint64_t v)
+{
+    return (v + mesh_cache_alignment - 1) & ~(mesh_cache_alignment - 1);
+}
+
+static bool source_stamp(const std::string &source_path, uint64_t *size, uint64_t *stamp)
+{
+    uint64_t mtime = 0;
+    if (!utils::file_info(source_path, size, &mtime))
+        return false;
+
+    *stamp = utils::hash_bytes(&mtime, sizeof(mtime), utils::hash_bytes(size, sizeof(*size)));
+    return true;
+}
+
+std::string MeshCache::cache_path(const std::string &source_path)
+{
+    return source_path + ".meshcache";
+}
+
+// streams one section, shape after shape, through a chunk buffer.
+static void write_section(std::ofstream &ofs, const std::vector<MeshCache::shape_desc> &shapes,
+    bool vertices, size_t element_size, const MeshCache::fill_func &fill, std::vector<char> &chunk)
+{
+    const size_t elements_per_chunk = std::max<size_t>(chunk.size() / element_size, 1);
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        const size_t nb_elements = (size_t)(vertices ? shapes[s].nb_vertices : shapes[s].nb_indices);
+        for (size_t first = 0; first < nb_elements; first += elements_per_chunk)
+        {
+            size_t count = std::min(elements_per_chunk, nb_elements - first);
+            fill(s, chunk.data(), first, count);
+            ofs.write(chunk.data(), count * element_size);
+        }
+    }
+}
+
+bool MeshCache::write(const std::string &source_path, size_t vertex_size,
+    const std::vector<shape_desc> &shapes, const fill_func &fill_vertices, const fill_func &fill_indices)
+{
+    mesh_cache_header header = {};
+    memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+    header.version = mesh_cache_version;
+    header.vertex_size = (uint32_t)vertex_size;
+    if (!source_stamp(source_path, &header.source_size, &header.source_stamp))
+        return false;
+
+    // shape table with the final ranges.
+    std::vector<shape_desc> table = shapes;
+    for (auto &desc : table)
+    {
+        desc.name[sizeof(desc.name) - 1] = '\0';
+        desc.base_vertex = header.nb_vertices;
+        desc.first_index = header.nb_indices;
+        header.nb_vertices += desc.nb_vertices;
+        header.nb_indices += desc.nb_indices;
+    }
+    header.nb_shapes = table.size();
+    header.shapes_offset = align_offset(sizeof(header));
+    header.vertices_offset = align_offset(header.shapes_offset + table.size() * sizeof(shape_desc));
+    header.indices_offset = align_offset(header.vertices_offset + header.nb_vertices * vertex_size);
+    header.file_size = header.indices_offset + header.nb_indices * sizeof(uint32_t);
+
+    // written aside then renamed, so an interrupted write never looks like a valid cache.
+    const std::string path = cache_path(source_path);
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            printf("FAILED to write mesh cache: %s\n", tmp_path.c_str());
+            return false;
+        }
+
+        std::vector<char> chunk(mesh_cache_chunk_size);
+
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.seekp(header.shapes_offset);
+        ofs.write((const char*)table.data(), table.size() * sizeof(shape_desc));
+        ofs.seekp(header.vertices_offset);
+        write_section(ofs, table, true, vertex_size, fill_vertices, chunk);
+        ofs.seekp(header.indices_offset);
+        write_section(ofs, table, false, sizeof(uint32_t), fill_indices, chunk);
+
+        if (!ofs.good())
+        {
+            ofs.close();
+            remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    remove(path.c_str());
+    if (rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache::open(const std::string &source_path, size_t vertex_size)
+{
+    close();
+
+    uint64_t size = 0;
+    uint64_t stamp = 0;
+    if (!source_stamp(source_path, &size, &stamp))
+        return false;
+
+    if (!_file.open(cache_path(source_path)))
+        return false;
+
+    mesh_cache_header header;
+    if (_file.size() < sizeof(header))
+    {
+        close();
+        return false;
+    }
+    memcpy(&header, _file.data(), sizeof(header));
+
+    const bool valid = memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) == 0
+        && header.version == mesh_cache_version
+        && header.vertex_size == vertex_size
+        && header.source_size == size
+        && header.source_stamp == stamp
+        && header.file_size == _file.size()
+        && header.shapes_offset + header.nb_shapes * sizeof(shape_desc) <= header.vertices_offset
+        && header.vertices_offset + header.nb_vertices * vertex_size <= header.indices_offset
+        && header.indices_offset + header.nb_indices * sizeof(uint32_t) <= header.file_size;
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+
+    _vertex_size = vertex_size;
+    _nb_shapes = (size_t)header.nb_shapes;
+    _shapes = (const shape_desc*)(_file.data() + header.shapes_offset);
+    for (size_t i = 0; i < _nb_shapes; ++i)
+    {
+        const shape_desc &desc = _shapes[i];
+        if (desc.base_vertex + desc.nb_vertices > header.nb_vertices || desc.first_index + desc.nb_indices > header.nb_indices)
+        {
+            close();
+            return false;
+        }
+    }
+    _vertices = _file.data() + header.vertices_offset;
+    _indices = (const uint32_t*)(_file.data() + header.indices_offset);
+
+    return true;
+}
+
+void MeshCache::close()
+{
+    _file.close();
+    _nb_shapes = 0;
+    _shapes = nullptr;
+    _vertices = nullptr;
+    _indices = nullptr;
+}
@@ -0,0 +1,63 @@
+#ifndef _MESH_CACHE_2026_10_17_H_
+#define _MESH_CACHE_2026_10_17_H_
+
+#include "utils.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+//
+// Binary cache of a converted mesh file, written next to the source ("<source>.meshcache").
+//
+// Layout: header, shape table, interleaved vertices of all shapes, indices of all shapes
+// (unsigned int, local to each shape). It is read through a memory mapping, and the ranges
+// are uploaded as they are. The cache is stale when its version, vertex size, or the size
+// and mtime hash of the source do not match.
+//
+class MeshCache
+{
+public:
+
+    // on disk.
+    struct shape_desc
+    {
+        char name[64];
+        uint64_t base_vertex;
+        uint64_t nb_vertices;
+        uint64_t first_index;
+        uint64_t nb_indices;
+        float bbox_min[3];
+        float bbox_max[3];
+    };
+
+    static std::string cache_path(const std::string &source_path);
+
+    // fill(shape, ptr, first, count) writes the elements [first, first+count) of a shape at ptr.
+    using fill_func = std::function<void(size_t shape, void *ptr, size_t first, size_t count)>;
+
+    // Only name, nb_vertices, nb_indices and the bboxes of the shapes are read.
+    static bool write(const std::string &source_path, size_t vertex_size,
+        const std::vector<shape_desc> &shapes, const fill_func &fill_vertices, const fill_func &fill_indices);
+
+    // Maps the cache of source_path. False if missing or stale.
+    bool open(const std::string &source_path, size_t vertex_size);
+    void close();
+
+    size_t nb_shapes() const { return _nb_shapes; }
+    const shape_desc &shape(size_t i) const { return _shapes[i]; }
+    const void *vertices(size_t i) const { return _vertices + _shapes[i].base_vertex * _vertex_size; }
+    const uint32_t *indices(size_t i) const { return _indices + _shapes[i].first_index; }
+
+private:
+
+    utils::MappedFile _file;
+    size_t _vertex_size = 0;
+    size_t _nb_shapes = 0;
+    const shape_desc *_shapes = nullptr;
+    const char *_vertices = nullptr;
+    const uint32_t *_indices = nullptr;
+};
+
+#endif // _MESH_CACHE_2026_10_17_H_
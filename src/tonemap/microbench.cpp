@@ -0,0 +1,461 @@
+#include "microbench.h"
+
+#include "FilmicCurve/FilmicColorGrading.h"
+#include "procgen.h"
+#include "obj_mesh.h"
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <stdio.h>
+
+namespace
+{
+
+using bench_clock = std::chrono::steady_clock;
+
+double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+const char *isa_name(FilmicColorGrading::eBatchIsa isa)
+{
+    switch (isa)
+    {
+        case FilmicColorGrading::kBatchIsa_Scalar: return "scalar";
+        case FilmicColorGrading::kBatchIsa_Sse2: return "sse2";
+        case FilmicColorGrading::kBatchIsa_Avx2: return "avx2";
+        default: return "?";
+    }
+}
+
+//
+// BakedParams::EvalColor vs EvalColorBatch, on a 4K frame.
+//
+bool bench_grading()
+{
+    const size_t nb_pixels = 3840 * 2160;
+    const int nb_runs = 5;
+
+    // something a bit more interesting than the identity curve
+    FilmicColorGrading::UserParams user_params;
+    user_params.m_exposureBias = 0.5f;
+    user_params.m_saturation = 1.2f;
+    user_params.m_contrast = 1.1f;
+    user_params.m_filmicToeStrength = 0.5f;
+    user_params.m_filmicShoulderStrength = 2.0f;
+    user_params.m_filmicGamma = 1.0f / 2.2f;
+
+    FilmicColorGrading::RawParams raw_params;
+    FilmicColorGrading::EvalParams eval_params;
+    FilmicColorGrading::BakedParams baked_params;
+    FilmicColorGrading::RawFromUserParams(raw_params, user_params);
+    FilmicColorGrading::EvalFromRawParams(eval_params, raw_params);
+    FilmicColorGrading::BakeFromEvalParams(baked_params, eval_params, 1024, FilmicColorGrading::kTableSpacing_Quadratic);
+
+    // HDR-ish input, mostly low values with a long tail
+    std::mt19937 rng(1234);
+    std::exponential_distribution<float> distrib(1.0f);
+    std::vector<float> rgb_in(3 * nb_pixels);
+    for (auto &c : rgb_in)
+    {
+        c = distrib(rng);
+    }
+
+    std::vector<float> reference(3 * nb_pixels);
+    std::vector<float> rgb_out(3 * nb_pixels);
+    std::vector<float> soa_in(3 * nb_pixels);
+    std::vector<float> soa_out(3 * nb_pixels);
+    for (size_t i = 0; i < nb_pixels; ++i)
+    {
+        soa_in[0 * nb_pixels + i] = rgb_in[3 * i + 0];
+        soa_in[1 * nb_pixels + i] = rgb_in[3 * i + 1];
+        soa_in[2 * nb_pixels + i] = rgb_in[3 * i + 2];
+    }
+
+    printf("grading: %zd pixels, %d runs, best run reported\n", nb_pixels, nb_runs);
+
+    // scalar reference, one EvalColor per pixel
+    double best = 1e30;
+    for (int run = 0; run < nb_runs; ++run)
+    {
+        auto start = bench_clock::now();
+        for (size_t i = 0; i < nb_pixels; ++i)
+        {
+            Vec3 c = baked_params.EvalColor(Vec3(rgb_in[3 * i + 0], rgb_in[3 * i + 1], rgb_in[3 * i + 2]));
+            reference[3 * i + 0] = c.x;
+            reference[3 * i + 1] = c.y;
+            reference[3 * i + 2] = c.z;
+        }
+        best = std::min(best, seconds_since(start));
+    }
+    printf("  %-24s %8.1f Mpix/s\n", "EvalColor", nb_pixels / best / 1e6);
+
+    bool all_exact = true;
+    FilmicColorGrading::eBatchIsa cpu_isa = FilmicColorGrading::GetBatchIsa();
+    for (int i = 0; i <= (int)cpu_isa; ++i)
+    {
+        auto isa = (FilmicColorGrading::eBatchIsa)i;
+        FilmicColorGrading::SetMaxBatchIsa(isa);
+
+        double best_interleaved = 1e30;
+        double best_soa = 1e30;
+        for (int run = 0; run < nb_runs; ++run)
+        {
+            auto start = bench_clock::now();
+            baked_params.EvalColorBatch(rgb_in.data(), rgb_out.data(), nb_pixels);
+            best_interleaved = std::min(best_interleaved, seconds_since(start));
+
+            start = bench_clock::now();
+            baked_params.EvalColorBatchSoA(
+                &soa_in[0], &soa_in[nb_pixels], &soa_in[2 * nb_pixels],
+                &soa_out[0], &soa_out[nb_pixels], &soa_out[2 * nb_pixels],
+                nb_pixels);
+            best_soa = std::min(best_soa, seconds_since(start));
+        }
+
+        bool exact = (memcmp(rgb_out.data(), reference.data(), rgb_out.size() * sizeof(float)) == 0);
+        for (size_t p = 0; exact && p < nb_pixels; ++p)
+        {
+            exact = (memcmp(&soa_out[p], &reference[3 * p + 0], sizeof(float)) == 0)
+                 && (memcmp(&soa_out[nb_pixels + p], &reference[3 * p + 1], sizeof(float)) == 0)
+                 && (memcmp(&soa_out[2 * nb_pixels + p], &reference[3 * p + 2], sizeof(float)) == 0);
+        }
+        all_exact = all_exact && exact;
+
+        std::string name = std::string("EvalColorBatch ") + isa_name(isa);
+        printf("  %-24s %8.1f Mpix/s interleaved, %8.1f Mpix/s soa, %s\n",
+            name.c_str(), nb_pixels / best_interleaved / 1e6, nb_pixels / best_soa / 1e6,
+            exact ? "bit exact" : "MISMATCH");
+    }
+    FilmicColorGrading::SetMaxBatchIsa(FilmicColorGrading::kBatchIsa_Avx2);
+
+    return all_exact;
+}
+
+//
+// make_icosphere vs the previous std::map based subdivision, levels 0 to 9.
+//
+namespace legacy_icosphere
+{
+    using Lookup = std::map<std::pair<index_t, index_t>, index_t>;
+
+    index_t vertex_for_edge(Lookup& lookup, VertexList& vertices, index_t first, index_t second)
+    {
+        Lookup::key_type key(first, second);
+        if (key.first > key.second)
+            std::swap(key.first, key.second);
+
+        auto inserted = lookup.insert({key, (index_t)vertices.size()});
+        if (inserted.second)
+        {
+            vertex_t v = {};
+            v.p = glm::normalize(vertices[first].p + vertices[second].p);
+            v.n = v.p;
+            v.uv = {0.0f, 0.0f};
+            vertices.push_back(v);
+        }
+
+        return inserted.first->second;
+    }
+
+    TriangleList subdivide(VertexList& vertices, TriangleList triangles)
+    {
+        Lookup lookup;
+        TriangleList result;
+
+        for (auto&& each : triangles)
+        {
+            std::array<index_t, 3> mid;
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                mid[edge] = vertex_for_edge(lookup, vertices, each.vertex_index[edge], each.vertex_index[(edge + 1) % 3]);
+            }
+
+            result.push_back({each.vertex_index[0], mid[0], mid[2]});
+            result.push_back({each.vertex_index[1], mid[1], mid[0]});
+            result.push_back({each.vertex_index[2], mid[2], mid[1]});
+            result.push_back({mid[0], mid[1], mid[2]});
+        }
+
+        return result;
+    }
+
+    // same steps as make_icosphere, starting from the level 0 mesh.
+    IndexedMesh make(const IndexedMesh &level0, int subdivisions)
+    {
+        VertexList vertices = level0.vertices;
+        TriangleList triangles;
+        for (size_t i = 0; i < level0.indices.size(); i += 3)
+        {
+            triangles.push_back({level0.indices[i], level0.indices[i + 1], level0.indices[i + 2]});
+        }
+
+        for (int i = 0; i < subdivisions; ++i)
+        {
+            triangles = subdivide(vertices, triangles);
+        }
+
+        const float pi = 3.14159f;
+        for (auto & vertex : vertices)
+        {
+            glm::vec3 unit = glm::normalize(vertex.p);
+            float u = (std::atan2(unit.x, std::fabs(unit.z)) + pi) / pi * 0.5f;
+            float v = (std::acos(unit.y) + pi) / pi - 1.0f;
+            vertex.uv = { u, v };
+        }
+
+        IndexList indices;
+        for (auto t : triangles)
+        {
+            indices.push_back(t.vertex_index[0]);
+            indices.push_back(t.vertex_index[1]);
+            indices.push_back(t.vertex_index[2]);
+        }
+        return{vertices, indices};
+    }
+}
+
+bool same_mesh(const IndexedMesh &a, const IndexedMesh &b)
+{
+    return a.indices == b.indices
+        && a.vertices.size() == b.vertices.size()
+        && memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(vertex_t)) == 0;
+}
+
+bool bench_icosphere()
+{
+    const IndexedMesh level0 = make_icosphere(0, 1.0f);
+
+    printf("icosphere: best run reported\n");
+    printf("  %5s %10s %10s %12s %12s %8s\n", "level", "vertices", "triangles", "std::map ms", "flat ms", "speedup");
+
+    bool all_same = true;
+    for (int level = 0; level <= 9; ++level)
+    {
+        const int nb_runs = (level < 7) ? 5 : 1;
+
+        double best_legacy = 1e30;
+        double best_flat = 1e30;
+        IndexedMesh legacy_mesh;
+        IndexedMesh flat_mesh;
+        for (int run = 0; run < nb_runs; ++run)
+        {
+            auto start = bench_clock::now();
+            legacy_mesh = legacy_icosphere::make(level0, level);
+            best_legacy = std::min(best_legacy, seconds_since(start));
+
+            start = bench_clock::now();
+            flat_mesh = make_icosphere(level, 1.0f);
+            best_flat = std::min(best_flat, seconds_since(start));
+        }
+
+        bool same = same_mesh(legacy_mesh, flat_mesh);
+        all_same = all_same && same;
+
+        printf("  %5d %10zd %10zd %12.3f %12.3f %7.1fx %s\n",
+            level, flat_mesh.vertices.size(), flat_mesh.indices.size() / 3,
+            best_legacy * 1e3, best_flat * 1e3, best_legacy / best_flat,
+            same ? "" : "MISMATCH");
+    }
+
+    return all_same;
+}
+
+//
+// ObjMesh::load vs tinyobj::LoadObj, on a generated OBJ with texcoord seams.
+//
+bool write_test_obj(const std::string &path, int nb_shapes, int nb_lat, int nb_long)
+{
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+    {
+        return false;
+    }
+
+    const float pi = 3.14159f;
+    int base_v = 1;
+    int base_vt = 1;
+    for (int s = 0; s < nb_shapes; ++s)
+    {
+        ofs << "o sphere_" << s << "\n";
+
+        // the last column of texcoords is u = 1, on the same positions/normals as u = 0.
+        for (int i = 0; i <= nb_lat; ++i)
+        {
+            for (int j = 0; j < nb_long; ++j)
+            {
+                float theta = pi * i / nb_lat;
+                float phi = 2.0f * pi * j / nb_long;
+                float x = std::sin(theta) * std::cos(phi);
+                float y = std::cos(theta);
+                float z = std::sin(theta) * std::sin(phi);
+                ofs << "v " << x + 3.0f * s << " " << y << " " << z << "\n";
+                ofs << "vn " << x << " " << y << " " << z << "\n";
+            }
+            for (int j = 0; j <= nb_long; ++j)
+            {
+                ofs << "vt " << (float)j / nb_long << " " << (float)i / nb_lat << "\n";
+            }
+        }
+
+        for (int i = 0; i < nb_lat; ++i)
+        {
+            for (int j = 0; j < nb_long; ++j)
+            {
+                int v[4] = {
+                    base_v + i * nb_long + j, base_v + i * nb_long + (j + 1) % nb_long,
+                    base_v + (i + 1) * nb_long + (j + 1) % nb_long, base_v + (i + 1) * nb_long + j };
+                int vt[4] = {
+                    base_vt + i * (nb_long + 1) + j, base_vt + i * (nb_long + 1) + j + 1,
+                    base_vt + (i + 1) * (nb_long + 1) + j + 1, base_vt + (i + 1) * (nb_long + 1) + j };
+                ofs << "f " << v[0] << "/" << vt[0] << "/" << v[0] << " " << v[1] << "/" << vt[1] << "/" << v[1] << " " << v[2] << "/" << vt[2] << "/" << v[2] << "\n";
+                ofs << "f " << v[0] << "/" << vt[0] << "/" << v[0] << " " << v[2] << "/" << vt[2] << "/" << v[2] << " " << v[3] << "/" << vt[3] << "/" << v[3] << "\n";
+            }
+        }
+
+        base_v += (nb_lat + 1) * nb_long;
+        base_vt += (nb_lat + 1) * (nb_long + 1);
+    }
+
+    return ofs.good();
+}
+
+// same triangles, corner by corner.
+bool same_obj(const ObjMesh &mesh, const tinyobj::attrib_t &attribs, const std::vector<tinyobj::shape_t> &shapes)
+{
+    if (mesh.shapes().size() != shapes.size())
+    {
+        return false;
+    }
+
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        const auto &info = mesh.shapes()[s];
+        const auto &tiny_indices = shapes[s].mesh.indices;
+        if (info.name != shapes[s].name || info.nb_indices != tiny_indices.size())
+        {
+            return false;
+        }
+
+        std::vector<scene_vertex> vertices(info.nb_vertices);
+        std::vector<unsigned int> indices(info.nb_indices);
+        mesh.fill_vertices(s, vertices.data(), 0, vertices.size());
+        mesh.fill_indices(s, indices.data(), 0, indices.size());
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const scene_vertex &v = vertices[indices[i]];
+            const tinyobj::index_t &t = tiny_indices[i];
+            const float expected[8] = {
+                attribs.vertices[3 * t.vertex_index + 0], attribs.vertices[3 * t.vertex_index + 1], attribs.vertices[3 * t.vertex_index + 2],
+                attribs.normals[3 * t.normal_index + 0], attribs.normals[3 * t.normal_index + 1], attribs.normals[3 * t.normal_index + 2],
+                attribs.texcoords[2 * t.texcoord_index + 0], attribs.texcoords[2 * t.texcoord_index + 1] };
+            const float actual[8] = {
+                v.position.x, v.position.y, v.position.z,
+                v.normal.x, v.normal.y, v.normal.z,
+                v.texcoords.x, v.texcoords.y };
+            if (memcmp(expected, actual, sizeof(expected)) != 0)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool bench_obj()
+{
+    const std::string path = "microbench_obj.obj";
+    const int nb_shapes = 8;
+    const int nb_lat = 256;
+    const int nb_long = 512;
+    const int nb_runs = 3;
+
+    if (!write_test_obj(path, nb_shapes, nb_lat, nb_long))
+    {
+        printf("obj: FAILED to write %s\n", path.c_str());
+        return false;
+    }
+
+    printf("obj: %d shapes of %d triangles, best run reported\n", nb_shapes, 2 * nb_lat * nb_long);
+
+    double best_tiny = 1e30;
+    tinyobj::attrib_t attribs;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    for (int run = 0; run < nb_runs; ++run)
+    {
+        std::string warn;
+        std::string err;
+        auto start = bench_clock::now();
+        tinyobj::LoadObj(&attribs, &shapes, &materials, &warn, &err, path.c_str(), nullptr, true, true);
+        best_tiny = std::min(best_tiny, seconds_since(start));
+    }
+
+    size_t nb_positions = attribs.vertices.size() / 3;
+    printf("  %-24s %10.1f ms, %zd vertices (positions)\n", "tinyobj::LoadObj", best_tiny * 1e3, nb_positions);
+
+    bool all_same = true;
+    utils::ThreadPool two_threads(1);
+    utils::ThreadPool *pools[] = { &two_threads, &utils::thread_pool() };
+    for (auto *pool : pools)
+    {
+        double best = 1e30;
+        ObjMesh mesh;
+        bool loaded = true;
+        for (int run = 0; run < nb_runs; ++run)
+        {
+            auto start = bench_clock::now();
+            loaded = mesh.load(path, "", *pool) && loaded;
+            best = std::min(best, seconds_since(start));
+        }
+
+        size_t nb_vertices = 0;
+        for (const auto &shape : mesh.shapes())
+        {
+            nb_vertices += shape.nb_vertices;
+        }
+
+        bool same = loaded && same_obj(mesh, attribs, shapes);
+        all_same = all_same && same;
+
+        std::string name = "ObjMesh::load " + std::to_string(pool->size() + 1) + " threads";
+        printf("  %-24s %10.1f ms, %zd vertices (unique v/vt/vn), %5.1fx %s\n",
+            name.c_str(), best * 1e3, nb_vertices, best_tiny / best, same ? "" : "MISMATCH");
+    }
+
+    remove(path.c_str());
+    return all_same;
+}
+
+} // namespace
+
+bool run_microbench(const std::string &name)
+{
+    if (name == "grading")
+    {
+        return bench_grading();
+    }
+
+    if (name == "icosphere")
+    {
+        return bench_icosphere();
+    }
+
+    if (name == "obj")
+    {
+        return bench_obj();
+    }
+
+    printf("Unknown micro-benchmark \"%s\". Available: grading, icosphere, obj\n", name.c_str());
+    return false;
+}
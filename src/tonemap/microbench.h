@@ -0,0 +1,10 @@
+#ifndef _MICROBENCH_2026_10_17_H_
+#define _MICROBENCH_2026_10_17_H_
+
+#include <string>
+
+// CPU micro-benchmarks, no GL context needed. Ran from the command line with --microbench <name>.
+// Returns false if the benchmark does not exist or if a check failed.
+bool run_microbench(const std::string &name);
+
+#endif // _MICROBENCH_2026_10_17_H_
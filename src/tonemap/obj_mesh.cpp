@@ -0,0 +1,670 @@
+#include "obj_mesh.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// the file is parsed by chunks of about this size, cut after a line end.
+static const size_t obj_chunk_size = 1024 * 1024;
+
+// shapes with more corners than this are deduplicated on 2^obj_dedup_shard_bits shards in parallel.
+static const size_t obj_dedup_parallel_threshold = 64 * 1024;
+static const unsigned int obj_dedup_shard_bits = 6;
+static const size_t obj_dedup_block = 16 * 1024;
+
+static const uint32_t obj_empty_slot = 0xFFFFFFFFu;
+
+namespace
+{
+
+// What one chunk of the file declares. Corner indices are kept as written (1 based, 0 = absent),
+// except the negative ones: those are turned into 0 based indices relative to the chunk start,
+// and listed in `relative` so they can be rebased once the chunk offsets are known.
+struct obj_chunk
+{
+    std::vector<float> positions;
+    std::vector<float> colors;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<ObjMesh::corner> corners;
+
+    struct relative_corner
+    {
+        size_t corner;
+        unsigned int mask; // 1: v, 2: vt, 4: vn
+    };
+    std::vector<relative_corner> relative;
+
+    struct shape_start
+    {
+        std::string name;
+        size_t first_corner;
+    };
+    std::vector<shape_start> shape_starts;
+
+    std::vector<std::string> mtllibs;
+
+    std::string error; // offending line, if any.
+};
+
+bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && is_blank(*p))
+        ++p;
+    return p;
+}
+
+// the line is never read past its '\n' (or the final '\0'), strtof/strtol stop there.
+bool parse_float(const char *&p, const char *end, float *f)
+{
+    p = skip_blanks(p, end);
+    if (p == end)
+        return false;
+
+    char *next;
+    *f = strtof(p, &next);
+    if (next == p)
+        return false;
+
+    p = next;
+    return true;
+}
+
+// right at p: strtol would skip blanks, '\n' included, into the next line or past the mapping.
+bool parse_index(const char *&p, const char *end, int *index)
+{
+    if (p == end || is_blank(*p))
+        return false;
+
+    char *next;
+    *index = (int)strtol(p, &next, 10);
+    if (next == p)
+        return false;
+
+    p = next;
+    return true;
+}
+
+// v, v/vt, v//vn or v/vt/vn.
+bool parse_corner(const char *&p, const char *end, int index[3])
+{
+    index[0] = index[1] = index[2] = 0;
+    if (!parse_index(p, end, &index[0]) || index[0] == 0)
+        return false;
+
+    // a '/' is always followed by an index, or by the second '/' of v//vn.
+    if (p < end && *p == '/')
+    {
+        ++p;
+        if (p < end && *p == '/')
+        {
+            ++p;
+            if (!parse_index(p, end, &index[2]))
+                return false;
+        }
+        else
+        {
+            if (!parse_index(p, end, &index[1]))
+                return false;
+
+            if (p < end && *p == '/')
+            {
+                ++p;
+                if (!parse_index(p, end, &index[2]))
+                    return false;
+            }
+        }
+    }
+
+    return p == end || is_blank(*p);
+}
+
+std::string rest_of_line(const char *p, const char *end)
+{
+    p = skip_blanks(p, end);
+    while (end > p && is_blank(end[-1]))
+        --end;
+    return std::string(p, end);
+}
+
+void parse_chunk(const char *begin, const char *end, obj_chunk &chunk)
+{
+    std::vector<ObjMesh::corner> face;
+    std::vector<unsigned int> face_masks;
+
+    for (const char *line = begin; line < end; )
+    {
+        const char *line_end = (const char*)memchr(line, '\n', end - line);
+        if (!line_end)
+        {
+            line_end = end;
+        }
+
+        const char *p = skip_blanks(line, line_end);
+        const char *token = p;
+        while (p < line_end && !is_blank(*p))
+            ++p;
+        const size_t token_length = p - token;
+        auto is_token = [token, token_length](const char *name)
+        {
+            return token_length == strlen(name) && memcmp(token, name, token_length) == 0;
+        };
+
+        bool ok = true;
+        if (is_token("v"))
+        {
+            float x, y, z;
+            ok = parse_float(p, line_end, &x) && parse_float(p, line_end, &y) && parse_float(p, line_end, &z);
+            chunk.positions.insert(chunk.positions.end(), { x, y, z });
+
+            // extension: vertex colors, white when missing.
+            float r, g, b;
+            if (!(parse_float(p, line_end, &r) && parse_float(p, line_end, &g) && parse_float(p, line_end, &b)))
+            {
+                r = g = b = 1.0f;
+            }
+            chunk.colors.insert(chunk.colors.end(), { r, g, b });
+        }
+        else if (is_token("vn"))
+        {
+            float x, y, z;
+            ok = parse_float(p, line_end, &x) && parse_float(p, line_end, &y) && parse_float(p, line_end, &z);
+            chunk.normals.insert(chunk.normals.end(), { x, y, z });
+        }
+        else if (is_token("vt"))
+        {
+            float u = 0.0f, v = 0.0f;
+            ok = parse_float(p, line_end, &u);
+            parse_float(p, line_end, &v);
+            chunk.texcoords.insert(chunk.texcoords.end(), { u, v });
+        }
+        else if (is_token("f"))
+        {
+            const int counts[3] = {
+                (int)(chunk.positions.size() / 3),
+                (int)(chunk.texcoords.size() / 2),
+                (int)(chunk.normals.size() / 3) };
+
+            face.clear();
+            face_masks.clear();
+            for (p = skip_blanks(p, line_end); ok && p < line_end; p = skip_blanks(p, line_end))
+            {
+                int index[3];
+                ok = parse_corner(p, line_end, index);
+
+                unsigned int mask = 0;
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (index[k] < 0)
+                    {
+                        index[k] += counts[k];
+                        mask |= 1u << k;
+                    }
+                }
+                face.push_back({ index[0], index[1], index[2] });
+                face_masks.push_back(mask);
+            }
+            ok = ok && face.size() >= 3;
+
+            // fan triangulation.
+            for (size_t i = 2; ok && i < face.size(); ++i)
+            {
+                const size_t fan[3] = { 0, i - 1, i };
+                for (size_t k : fan)
+                {
+                    if (face_masks[k])
+                    {
+                        chunk.relative.push_back({ chunk.corners.size(), face_masks[k] });
+                    }
+                    chunk.corners.push_back(face[k]);
+                }
+            }
+        }
+        else if (is_token("o") || is_token("g"))
+        {
+            chunk.shape_starts.push_back({ rest_of_line(p, line_end), chunk.corners.size() });
+        }
+        else if (is_token("mtllib"))
+        {
+            for (p = skip_blanks(p, line_end); p < line_end; p = skip_blanks(p, line_end))
+            {
+                const char *name = p;
+                while (p < line_end && !is_blank(*p))
+                    ++p;
+                chunk.mtllibs.push_back(std::string(name, p));
+            }
+        }
+        // everything else (comments, usemtl, s, l, p...) is not used.
+
+        if (!ok)
+        {
+            chunk.error = std::string(line, line_end);
+            return;
+        }
+
+        line = line_end + 1;
+    }
+}
+
+uint64_t hash_corner(const ObjMesh::corner &c)
+{
+    uint64_t h = (uint64_t)(uint32_t)c.v * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(uint32_t)c.vt * 0xC2B2AE3D27D4EB4Full;
+    h ^= (uint64_t)(uint32_t)c.vn * 0x165667B19E3779F9ull;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+bool same_corner(const ObjMesh::corner &a, const ObjMesh::corner &b)
+{
+    return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+}
+
+// chunk encoded index to 0 based file index, -1 if absent or out of range.
+bool resolve_index(int index, bool relative, size_t base, size_t count, bool required, int *resolved)
+{
+    int64_t i = relative ? (int64_t)base + index : (int64_t)index - 1;
+    if (!relative && index == 0)
+    {
+        *resolved = -1;
+        return !required;
+    }
+
+    *resolved = (int)i;
+    return i >= 0 && i < (int64_t)count;
+}
+
+} // namespace
+
+bool ObjMesh::load(const std::string &filename, const std::string &materials_path, utils::ThreadPool &pool)
+{
+    _positions.clear();
+    _colors.clear();
+    _normals.clear();
+    _texcoords.clear();
+    _materials.clear();
+    _shapes.clear();
+    _vertices.clear();
+
+    utils::MappedFile file;
+    if (!file.open(filename))
+    {
+        printf("FAILED to open file: %s\n", filename.c_str());
+        return false;
+    }
+
+    //
+    // line-aligned chunks, parsed in parallel.
+    //
+    const char *data = file.data();
+    const char *data_end = data + file.size();
+    std::vector<const char*> bounds(1, data);
+    while (bounds.back() < data_end)
+    {
+        const char *cut = bounds.back() + std::min(obj_chunk_size, (size_t)(data_end - bounds.back()));
+        const char *line_end = (cut < data_end) ? (const char*)memchr(cut, '\n', data_end - cut) : nullptr;
+        bounds.push_back(line_end ? line_end + 1 : data_end);
+    }
+
+    std::vector<obj_chunk> chunks(bounds.size() - 1);
+    pool.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            // the mapping is not 0 terminated: the last line, if it has no '\n', is parsed from a copy.
+            if (i + 1 == chunks.size() && data_end[-1] != '\n')
+            {
+                std::string tail(bounds[i], bounds[i + 1]);
+                parse_chunk(tail.c_str(), tail.c_str() + tail.size(), chunks[i]);
+            }
+            else
+            {
+                parse_chunk(bounds[i], bounds[i + 1], chunks[i]);
+            }
+        }
+    });
+
+    for (const auto &chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            printf("ERR: bad line \"%s\"\n", chunk.error.c_str());
+            printf("FAILED to parse: %s\n", filename.c_str());
+            return false;
+        }
+    }
+
+    //
+    // concatenate the chunks, rebase the relative indices.
+    //
+    struct chunk_offsets
+    {
+        size_t v, vt, vn, corner;
+    };
+    std::vector<chunk_offsets> offsets(chunks.size() + 1);
+    offsets[0] = {};
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        offsets[i + 1].v = offsets[i].v + chunks[i].positions.size() / 3;
+        offsets[i + 1].vt = offsets[i].vt + chunks[i].texcoords.size() / 2;
+        offsets[i + 1].vn = offsets[i].vn + chunks[i].normals.size() / 3;
+        offsets[i + 1].corner = offsets[i].corner + chunks[i].corners.size();
+    }
+    const chunk_offsets &totals = offsets.back();
+
+    _positions.resize(3 * totals.v);
+    _colors.resize(3 * totals.v);
+    _texcoords.resize(2 * totals.vt);
+    _normals.resize(3 * totals.vn);
+    std::vector<corner> corners(totals.corner);
+
+    std::atomic<bool> bad_index(false);
+    pool.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const obj_chunk &chunk = chunks[i];
+            const chunk_offsets &base = offsets[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), _positions.begin() + 3 * base.v);
+            std::copy(chunk.colors.begin(), chunk.colors.end(), _colors.begin() + 3 * base.v);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), _texcoords.begin() + 2 * base.vt);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), _normals.begin() + 3 * base.vn);
+
+            size_t next_relative = 0;
+            bool ok = true;
+            for (size_t c = 0; c < chunk.corners.size(); ++c)
+            {
+                unsigned int mask = 0;
+                if (next_relative < chunk.relative.size() && chunk.relative[next_relative].corner == c)
+                {
+                    mask = chunk.relative[next_relative++].mask;
+                }
+
+                const corner &in = chunk.corners[c];
+                corner &out = corners[base.corner + c];
+                ok = ok
+                    && resolve_index(in.v, (mask & 1) != 0, base.v, totals.v, true, &out.v)
+                    && resolve_index(in.vt, (mask & 2) != 0, base.vt, totals.vt, false, &out.vt)
+                    && resolve_index(in.vn, (mask & 4) != 0, base.vn, totals.vn, false, &out.vn);
+            }
+            if (!ok)
+            {
+                bad_index = true;
+            }
+        }
+    });
+
+    if (bad_index)
+    {
+        printf("ERR: face index out of range\n");
+        printf("FAILED to parse: %s\n", filename.c_str());
+        return false;
+    }
+
+    //
+    // one shape per o/g, faces before the first one go to an unnamed shape. Empty ones are dropped.
+    //
+    struct shape_range
+    {
+        std::string name;
+        size_t first;
+        size_t last;
+    };
+    std::vector<shape_range> ranges(1, shape_range{ std::string(), 0, 0 });
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        for (const auto &start : chunks[i].shape_starts)
+        {
+            const size_t first = offsets[i].corner + start.first_corner;
+            ranges.back().last = first;
+            ranges.push_back({ start.name, first, 0 });
+        }
+    }
+    ranges.back().last = totals.corner;
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const shape_range &r) { return r.first == r.last; }), ranges.end());
+
+    _shapes.resize(ranges.size());
+    _vertices.resize(ranges.size());
+    pool.parallel_for(ranges.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t s = begin; s < end; ++s)
+        {
+            _shapes[s].name = ranges[s].name;
+            build_shape(&corners[ranges[s].first], ranges[s].last - ranges[s].first, _shapes[s], _vertices[s], pool);
+        }
+    });
+
+    for (const auto &chunk : chunks)
+    {
+        for (const auto &mtllib : chunk.mtllibs)
+        {
+            std::map<std::string, int> material_map;
+            std::string warn;
+            std::string err;
+            tinyobj::MaterialFileReader mtl_reader(materials_path);
+            mtl_reader(mtllib, &_materials, &material_map, &warn, &err);
+            if (!warn.empty())
+            {
+                printf("WARN: %s\n", warn.c_str());
+            }
+            if (!err.empty())
+            {
+                printf("ERR: %s\n", err.c_str());
+            }
+        }
+    }
+
+    return true;
+}
+
+// Unified index buffer of one shape: each distinct (v, vt, vn) is one vertex, numbered in order
+// of first use. The corners are bucketed by hash into shards, each shard has its own flat table
+// (no locking), then the first occurrences are numbered with a prefix sum.
+void ObjMesh::build_shape(const corner *corners, size_t nb_corners, shape_info &info, shape_vertices &sv, utils::ThreadPool &pool) const
+{
+    const unsigned int shard_bits = (nb_corners >= obj_dedup_parallel_threshold) ? obj_dedup_shard_bits : 0;
+    const size_t nb_shards = (size_t)1 << shard_bits;
+    const size_t nb_blocks = (nb_corners + obj_dedup_block - 1) / obj_dedup_block;
+    auto shard_of = [shard_bits](uint64_t h) { return shard_bits ? (size_t)(h >> (64 - shard_bits)) : 0; };
+
+    auto for_each_block = [&](const std::function<void(size_t block, size_t begin, size_t end)> &f)
+    {
+        pool.parallel_for(nb_blocks, 1, [&](size_t b0, size_t b1)
+        {
+            for (size_t b = b0; b < b1; ++b)
+            {
+                f(b, b * obj_dedup_block, std::min((b + 1) * obj_dedup_block, nb_corners));
+            }
+        });
+    };
+
+    // corners bucketed by shard, in file order inside each shard.
+    std::vector<uint32_t> order(nb_corners);
+    std::vector<size_t> shard_begin(nb_shards + 1);
+    std::vector<size_t> cursors(nb_blocks * nb_shards, 0); // [block][shard]
+    for_each_block([&](size_t b, size_t begin, size_t end)
+    {
+        size_t *count = &cursors[b * nb_shards];
+        for (size_t c = begin; c < end; ++c)
+        {
+            ++count[shard_of(hash_corner(corners[c]))];
+        }
+    });
+
+    size_t running = 0;
+    for (size_t s = 0; s < nb_shards; ++s)
+    {
+        shard_begin[s] = running;
+        for (size_t b = 0; b < nb_blocks; ++b)
+        {
+            size_t count = cursors[b * nb_shards + s];
+            cursors[b * nb_shards + s] = running;
+            running += count;
+        }
+    }
+    shard_begin[nb_shards] = running;
+
+    for_each_block([&](size_t b, size_t begin, size_t end)
+    {
+        size_t *cursor = &cursors[b * nb_shards];
+        for (size_t c = begin; c < end; ++c)
+        {
+            order[cursor[shard_of(hash_corner(corners[c]))]++] = (uint32_t)c;
+        }
+    });
+
+    // rep[c] = first corner with the same triple.
+    std::vector<uint32_t> rep(nb_corners);
+    pool.parallel_for(nb_shards, 1, [&](size_t s0, size_t s1)
+    {
+        std::vector<uint32_t> table;
+        for (size_t s = s0; s < s1; ++s)
+        {
+            size_t table_size = 16;
+            while (table_size < 2 * (shard_begin[s + 1] - shard_begin[s]))
+                table_size *= 2;
+            const size_t mask = table_size - 1;
+            table.assign(table_size, obj_empty_slot);
+
+            for (size_t k = shard_begin[s]; k < shard_begin[s + 1]; ++k)
+            {
+                const uint32_t c = order[k];
+                for (size_t slot = (size_t)hash_corner(corners[c]) & mask; ; slot = (slot + 1) & mask)
+                {
+                    if (table[slot] == obj_empty_slot)
+                    {
+                        table[slot] = c;
+                        rep[c] = c;
+                        break;
+                    }
+                    if (same_corner(corners[table[slot]], corners[c]))
+                    {
+                        rep[c] = table[slot];
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    // number the first occurrences, in corner order. `order` is reused for the numbers.
+    std::vector<uint32_t> &number = order;
+    std::vector<size_t> block_first(nb_blocks + 1, 0);
+    for_each_block([&](size_t b, size_t begin, size_t end)
+    {
+        size_t count = 0;
+        for (size_t c = begin; c < end; ++c)
+        {
+            count += (rep[c] == c);
+        }
+        block_first[b + 1] = count;
+    });
+    for (size_t b = 0; b < nb_blocks; ++b)
+    {
+        block_first[b + 1] += block_first[b];
+    }
+
+    sv.vertices.resize(block_first[nb_blocks]);
+    sv.indices.resize(nb_corners);
+
+    std::vector<glm::vec3> block_min(nb_blocks, glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX));
+    std::vector<glm::vec3> block_max(nb_blocks, glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+    for_each_block([&](size_t b, size_t begin, size_t end)
+    {
+        uint32_t next = (uint32_t)block_first[b];
+        for (size_t c = begin; c < end; ++c)
+        {
+            if (rep[c] == c)
+            {
+                number[c] = next;
+                sv.vertices[next++] = corners[c];
+
+                const int vi = corners[c].v;
+                glm::vec3 position(_positions[3 * vi + 0], _positions[3 * vi + 1], _positions[3 * vi + 2]);
+                block_min[b] = glm::min(block_min[b], position);
+                block_max[b] = glm::max(block_max[b], position);
+            }
+        }
+    });
+
+    for_each_block([&](size_t, size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; ++c)
+        {
+            sv.indices[c] = number[rep[c]];
+        }
+    });
+
+    info.bbox_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    info.bbox_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t b = 0; b < nb_blocks; ++b)
+    {
+        info.bbox_min = glm::min(info.bbox_min, block_min[b]);
+        info.bbox_max = glm::max(info.bbox_max, block_max[b]);
+    }
+    info.nb_vertices = sv.vertices.size();
+    info.nb_indices = sv.indices.size();
+}
+
+void ObjMesh::print_stats() const
+{
+    printf("# of vertices         = %zd\n", _positions.size() / 3);
+    printf("# of normals          = %zd\n", _normals.size() / 3);
+    printf("# of texcoords        = %zd\n", _texcoords.size() / 2);
+    printf("# of shapes           = %zd\n", _shapes.size());
+    for (size_t s = 0; s < _shapes.size(); ++s)
+    {
+        printf("   [%zd] # of vertices = %zd, # of indices = %zd\n", s, _shapes[s].nb_vertices, _shapes[s].nb_indices);
+    }
+    printf("# of materials        = %zd\n", _materials.size());
+}
+
+void ObjMesh::fill_vertices(size_t shape, scene_vertex *dst, size_t first, size_t count) const
+{
+    const shape_vertices &sv = _vertices[shape];
+    for (size_t j = 0; j < count; ++j)
+    {
+        const corner &c = sv.vertices[first + j];
+        scene_vertex &v = dst[j];
+
+        v.position = glm::vec3(_positions[3 * c.v + 0], _positions[3 * c.v + 1], _positions[3 * c.v + 2]);
+        v.diffuse_color = glm::vec3(_colors[3 * c.v + 0], _colors[3 * c.v + 1], _colors[3 * c.v + 2]);
+
+        if (c.vn != -1)
+        {
+            v.normal = glm::vec3(_normals[3 * c.vn + 0], _normals[3 * c.vn + 1], _normals[3 * c.vn + 2]);
+        }
+        else
+        {
+            v.normal = glm::vec3(0.0f, 1.0f, 0.0f); // default normal = UP
+        }
+
+        if (c.vt != -1)
+        {
+            v.texcoords = glm::vec2(_texcoords[2 * c.vt + 0], _texcoords[2 * c.vt + 1]);
+        }
+        else
+        {
+            v.texcoords = glm::vec2(0.0f, 0.0f); // default TC = 0,0
+        }
+    }
+}
+
+void ObjMesh::fill_indices(size_t shape, unsigned int *dst, size_t first, size_t count) const
+{
+    std::copy(_vertices[shape].indices.begin() + first, _vertices[shape].indices.begin() + first + count, dst);
+}
@@ -0,0 +1,71 @@
+#ifndef _OBJ_MESH_2026_10_17_H_
+#define _OBJ_MESH_2026_10_17_H_
+
+#include "scene_vertex.h"
+#include "tiny_obj_loader.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+
+//
+// OBJ file converted to one indexed mesh per shape, in the scene_vertex format.
+//
+// The file is cut in line-aligned chunks parsed in parallel. Each distinct (v, vt, vn)
+// triple of a shape becomes one vertex, numbered in order of first use, so seams keep
+// their own normals and texcoords. Only the materials go through tinyobj.
+//
+// The vertices and indices are not stored: fill_vertices/fill_indices write them on
+// demand, by ranges, so they can go straight into the upload ring or the mesh cache.
+//
+class ObjMesh
+{
+public:
+
+    struct shape_info
+    {
+        std::string name;
+        size_t nb_vertices = 0;
+        size_t nb_indices = 0;
+        glm::vec3 bbox_min;
+        glm::vec3 bbox_max;
+    };
+
+    bool load(const std::string &filename, const std::string &materials_path, utils::ThreadPool &pool = utils::thread_pool());
+    void print_stats() const;
+
+    const std::vector<shape_info> &shapes() const { return _shapes; }
+
+    void fill_vertices(size_t shape, scene_vertex *dst, size_t first, size_t count) const;
+    void fill_indices(size_t shape, unsigned int *dst, size_t first, size_t count) const;
+
+    // attribute indices of a vertex, 0 based, -1 if absent.
+    struct corner
+    {
+        int v;
+        int vt;
+        int vn;
+    };
+
+private:
+
+    struct shape_vertices
+    {
+        std::vector<corner> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    void build_shape(const corner *corners, size_t nb_corners, shape_info &info, shape_vertices &sv, utils::ThreadPool &pool) const;
+
+    // flat attribute arrays, 3 floats per position/color/normal, 2 per texcoord.
+    std::vector<float> _positions;
+    std::vector<float> _colors;
+    std::vector<float> _normals;
+    std::vector<float> _texcoords;
+
+    std::vector<tinyobj::material_t> _materials;
+    std::vector<shape_info> _shapes;
+    std::vector<shape_vertices> _vertices;
+};
+
+#endif // _OBJ_MESH_2026_10_17_H_
@@ -0,0 +1,73 @@
+#ifndef _REGRADE_PIPELINE_2026_10_17_H_
+#define _REGRADE_PIPELINE_2026_10_17_H_
+
+#include "FilmicCurve/FilmicColorGrading.h"
+
+//
+// User params -> baked params, recomputing only the stages the edited params feed.
+//
+// Edits are only recorded (set_user_params compares against the last flushed params),
+// and flush() runs the dirty stages once. Calling flush() once per frame coalesces
+// every edit of the frame, e.g. all the mouse-drag events of a slider.
+//
+class RegradePipeline
+{
+public:
+
+    enum stage_bits : unsigned int
+    {
+        stage_params         = 1 << 0, // user -> raw -> eval (cheap)
+        stage_baked_scalars  = 1 << 1, // color filter/exposure, saturation
+        stage_baked_tables   = 1 << 2, // contrast, filmic curve, lift/gamma/gain (curve_size entries)
+        stage_filmic_preview = 1 << 3, // gui plot of the baked curve
+        stage_aces_preview   = 1 << 4, // gui plot of ACES
+        stage_lut            = 1 << 5, // 3D LUT
+
+        stage_all            = (1 << 6) - 1
+    };
+
+    explicit RegradePipeline(int curve_size = 1024, FilmicColorGrading::eTableSpacing spacing = FilmicColorGrading::kTableSpacing_Quadratic);
+
+    // only records the params, nothing is computed until flush().
+    void set_user_params(const FilmicColorGrading::UserParams &params);
+    void set_aces_gamma(float gamma);
+
+    // for stages with inputs outside of the params, e.g. a new LUT size.
+    void invalidate(unsigned int stages) { _invalid |= stages; }
+
+    // stages fed by the params that differ from the last flushed ones, plus the invalidated ones.
+    unsigned int dirty() const;
+
+    // Recomputes the dirty param stages. Returns every stage that was dirty, the caller
+    // runs the ones it owns (previews, LUT).
+    unsigned int flush();
+
+    const FilmicColorGrading::UserParams &user_params() const { return _user; }
+    const FilmicColorGrading::EvalParams &eval_params() const { return _eval; }
+    const FilmicColorGrading::BakedParams &baked_params() const { return _baked; }
+    float aces_gamma() const { return _aces_gamma; }
+
+    // stages run by the last flushes, for the gui.
+    unsigned int nb_table_bakes() const { return _nb_table_bakes; }
+    unsigned int nb_scalar_bakes() const { return _nb_scalar_bakes; }
+
+private:
+
+    FilmicColorGrading::UserParams _user;
+    FilmicColorGrading::UserParams _pending;
+    float _aces_gamma = 1.0f;
+    float _pending_aces_gamma = 1.0f;
+
+    FilmicColorGrading::RawParams _raw;
+    FilmicColorGrading::EvalParams _eval;
+    FilmicColorGrading::BakedParams _baked;
+
+    int _curve_size;
+    FilmicColorGrading::eTableSpacing _spacing;
+
+    unsigned int _invalid = stage_all;
+    unsigned int _nb_table_bakes = 0;
+    unsigned int _nb_scalar_bakes = 0;
+};
+
+#endif // _REGRADE_PIPELINE_2026_10_17_H_
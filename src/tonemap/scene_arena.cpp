@@ -0,0 +1,133 @@
+#include "scene_arena.h"
+
+#include <algorithm>
+
+// Arena storage: filled by gpu copies, plus the direct (non persistent) mappings of the generators.
+static const GLbitfield arena_storage_flags = GL_MAP_WRITE_BIT;
+
+SceneArena::~SceneArena()
+{
+    shutdown();
+}
+
+bool SceneArena::init(size_t vertex_size, GLuint binding_index, size_t vertex_capacity, size_t index_capacity)
+{
+    shutdown();
+
+    _vertex_size = vertex_size;
+    _binding_index = binding_index;
+    _vertex_capacity = vertex_capacity;
+    _index_capacity = index_capacity;
+    _nb_vertices = 0;
+    _nb_indices = 0;
+    _commands.clear();
+    _commands_dirty = false;
+
+    glCreateVertexArrays(1, &_vao);
+    glCreateBuffers(1, &_vertex_buffer);
+    glCreateBuffers(1, &_index_buffer);
+    glCreateBuffers(1, &_indirect_buffer);
+    glNamedBufferStorage(_vertex_buffer, _vertex_capacity * _vertex_size, nullptr, arena_storage_flags);
+    glNamedBufferStorage(_index_buffer, _index_capacity * sizeof(GLuint), nullptr, arena_storage_flags);
+
+    glVertexArrayVertexBuffer(_vao, _binding_index, _vertex_buffer, 0, (GLsizei)_vertex_size);
+    glVertexArrayElementBuffer(_vao, _index_buffer);
+
+    return true;
+}
+
+void SceneArena::shutdown()
+{
+    if (!_vao)
+    {
+        return;
+    }
+
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_vertex_buffer);
+    glDeleteBuffers(1, &_index_buffer);
+    glDeleteBuffers(1, &_indirect_buffer);
+    _vao = _vertex_buffer = _index_buffer = _indirect_buffer = 0;
+    _commands.clear();
+}
+
+// Immutable storage cannot be resized: copy into a bigger one. The copy is ordered
+// after the uploads already issued into the old buffer.
+void SceneArena::grow(GLuint &buffer, size_t old_size, size_t new_size)
+{
+    GLuint new_buffer = 0;
+    glCreateBuffers(1, &new_buffer);
+    glNamedBufferStorage(new_buffer, new_size, nullptr, arena_storage_flags);
+    glCopyNamedBufferSubData(buffer, new_buffer, 0, 0, old_size);
+    glDeleteBuffers(1, &buffer);
+    buffer = new_buffer;
+}
+
+SceneArena::range SceneArena::allocate(size_t nb_vertices, size_t nb_indices, bool visible)
+{
+    if (_nb_vertices + nb_vertices > _vertex_capacity)
+    {
+        size_t new_capacity = std::max(2 * _vertex_capacity, _nb_vertices + nb_vertices);
+        grow(_vertex_buffer, _nb_vertices * _vertex_size, new_capacity * _vertex_size);
+        _vertex_capacity = new_capacity;
+        glVertexArrayVertexBuffer(_vao, _binding_index, _vertex_buffer, 0, (GLsizei)_vertex_size);
+    }
+
+    if (_nb_indices + nb_indices > _index_capacity)
+    {
+        size_t new_capacity = std::max(2 * _index_capacity, _nb_indices + nb_indices);
+        grow(_index_buffer, _nb_indices * sizeof(GLuint), new_capacity * sizeof(GLuint));
+        _index_capacity = new_capacity;
+        glVertexArrayElementBuffer(_vao, _index_buffer);
+    }
+
+    range r;
+    r.base_vertex = _nb_vertices;
+    r.first_index = _nb_indices;
+    r.nb_indices = nb_indices;
+    r.draw_id = _commands.size();
+
+    DrawElementsIndirectCommand cmd;
+    cmd.count = (GLuint)nb_indices;
+    cmd.instance_count = visible ? 1 : 0;
+    cmd.first_index = (GLuint)r.first_index;
+    cmd.base_vertex = (GLint)r.base_vertex;
+    cmd.base_instance = 0;
+    _commands.push_back(cmd);
+    _commands_dirty = true;
+
+    _nb_vertices += nb_vertices;
+    _nb_indices += nb_indices;
+
+    return r;
+}
+
+void SceneArena::set_visible(const range &r, bool visible)
+{
+    GLuint instance_count = visible ? 1 : 0;
+    if (_commands[r.draw_id].instance_count != instance_count)
+    {
+        _commands[r.draw_id].instance_count = instance_count;
+        _commands_dirty = true;
+    }
+}
+
+void SceneArena::draw()
+{
+    if (_commands.empty())
+    {
+        return;
+    }
+
+    if (_commands_dirty)
+    {
+        glNamedBufferData(_indirect_buffer, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data(), GL_STATIC_DRAW);
+        _commands_dirty = false;
+    }
+
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)_commands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,92 @@
+#ifndef _SCENE_ARENA_2026_10_17_H_
+#define _SCENE_ARENA_2026_10_17_H_
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <stddef.h>
+
+//
+// One vertex buffer, one index buffer and one VAO for the whole scene.
+//
+// Every mesh is sub-allocated in the arena: its indices stay local to the mesh, and
+// base_vertex moves them to its vertices. The draws are recorded as
+// DrawElementsIndirectCommand, so the whole scene goes with one glMultiDrawElementsIndirect.
+// The buffers grow by gpu copies if needed; the vao is kept pointing to the new ones.
+//
+class SceneArena
+{
+public:
+
+    // layout imposed by glMultiDrawElementsIndirect.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    struct range
+    {
+        size_t base_vertex = 0;
+        size_t first_index = 0;
+        size_t nb_indices = 0;
+        size_t draw_id = 0;
+    };
+
+    SceneArena() = default;
+    ~SceneArena();
+
+    SceneArena(const SceneArena &) = delete;
+    SceneArena &operator=(const SceneArena &) = delete;
+
+    // The vertex format of the vao is left to the caller, on binding_index.
+    bool init(size_t vertex_size, GLuint binding_index, size_t vertex_capacity = 256 * 1024, size_t index_capacity = 1024 * 1024);
+    void shutdown();
+
+    // Reserves the space of a mesh (unsigned int indices) and records its draw.
+    range allocate(size_t nb_vertices, size_t nb_indices, bool visible = true);
+
+    // A hidden draw keeps its place with an instance count of 0, e.g. while it is uploaded.
+    void set_visible(const range &r, bool visible);
+
+    // Byte offsets of a range, for the uploads.
+    size_t vertex_offset(const range &r) const { return r.base_vertex * _vertex_size; }
+    size_t index_offset(const range &r) const { return r.first_index * sizeof(GLuint); }
+
+    // Draws everything that was allocated, with one call.
+    void draw();
+
+    GLuint vao() const { return _vao; }
+    GLuint vertex_buffer() const { return _vertex_buffer; }
+    GLuint index_buffer() const { return _index_buffer; }
+
+    size_t nb_draws() const { return _commands.size(); }
+    size_t nb_vertices() const { return _nb_vertices; }
+    size_t nb_indices() const { return _nb_indices; }
+    size_t gpu_memory() const { return _vertex_capacity * _vertex_size + _index_capacity * sizeof(GLuint); }
+
+private:
+
+    static void grow(GLuint &buffer, size_t old_size, size_t new_size);
+
+    size_t _vertex_size = 0;
+    GLuint _binding_index = 0;
+
+    GLuint _vao = 0;
+    GLuint _vertex_buffer = 0;
+    GLuint _index_buffer = 0;
+    GLuint _indirect_buffer = 0;
+
+    size_t _vertex_capacity = 0;
+    size_t _index_capacity = 0;
+    size_t _nb_vertices = 0;
+    size_t _nb_indices = 0;
+
+    std::vector<DrawElementsIndirectCommand> _commands;
+    bool _commands_dirty = false;
+};
+
+#endif // _SCENE_ARENA_2026_10_17_H_
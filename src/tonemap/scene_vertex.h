@@ -0,0 +1,21 @@
+#ifndef _SCENE_VERTEX_2026_10_17_H_
+#define _SCENE_VERTEX_2026_10_17_H_
+
+#include "glm_usage.h"
+
+// attribute locations of the scene shaders.
+#define POSITION_SHADER_ATTRIB_INDEX 0
+#define NORMAL_SHADER_ATTRIB_INDEX 1
+#define COLOR_SHADER_ATTRIB_INDEX 2
+#define TEXCOORD_SHADER_ATTRIB_INDEX 3
+
+// Interleaved vertex of the scene objects.
+struct scene_vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 diffuse_color;
+    glm::vec2 texcoords;
+};
+
+#endif // _SCENE_VERTEX_2026_10_17_H_
@@ -0,0 +1,62 @@
+#include "tonemap_operators.h"
+
+#include <algorithm>
+
+namespace tonemap
+{
+
+// Linear_sRGB => XYZ => D65_2_D60 => AP1 => RRT_SAT
+static const glm::mat3 ACESInputMat =
+{
+    { 0.59719, 0.35458, 0.04823 },
+    { 0.07600, 0.90834, 0.01566 },
+    { 0.02840, 0.13383, 0.83777 }
+};
+
+// ODT_SAT => XYZ => D60_2_D65 => sRGB
+static const glm::mat3 ACESOutputMat =
+{
+    { 1.60475, -0.53108, -0.07367 },
+    { -0.10208,  1.10813, -0.00605 },
+    { -0.00327, -0.07276,  1.07602 }
+};
+
+static glm::vec3 RRTAndODTFit(glm::vec3 v)
+{
+    glm::vec3 a = v * (v + 0.0245786f) - 0.000090537f;
+    glm::vec3 b = v * (0.983729f * v + 0.4329510f) + 0.238081f;
+    return a / b;
+}
+
+glm::vec3 aces_fitted(glm::vec3 color)
+{
+    color = glm::transpose(ACESInputMat) * color; // transpose because HLSL matrix
+
+    // Apply RRT and ODT
+    color = RRTAndODTFit(color);
+
+    color = glm::transpose(ACESOutputMat) * color;
+
+    // Clamp to [0, 1]
+    color = glm::clamp(color, glm::vec3(0), glm::vec3(1));
+
+    return color;
+}
+
+float filmic_uc2(float linear_hdr)
+{
+    float x = std::max(0.0f, linear_hdr - 0.004f);
+    return (x*(6.2f*x + 0.5f)) / (x*(6.2f*x + 1.7f) + 0.06f);
+}
+
+glm::vec3 filmic_uc2(glm::vec3 linear_hdr)
+{
+    return glm::vec3(filmic_uc2(linear_hdr.x), filmic_uc2(linear_hdr.y), filmic_uc2(linear_hdr.z));
+}
+
+glm::vec3 linear_to_gamma(glm::vec3 linear_color, float gamma)
+{
+    return glm::pow(linear_color, glm::vec3(1.0f / gamma));
+}
+
+} // namespace tonemap
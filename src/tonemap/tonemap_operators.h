@@ -0,0 +1,21 @@
+#ifndef _TONEMAP_OPERATORS_2026_10_17_H_
+#define _TONEMAP_OPERATORS_2026_10_17_H_
+
+#include "glm_usage.h"
+
+// CPU versions of the operators in tonemap.frag, shared by the app (curves, LUT)
+// and the headless hdrtonemap tool.
+namespace tonemap
+{
+    // https://github.com/TheRealMJP/BakingLab/blob/master/BakingLab/ACES.hlsl
+    // original by Stephen Hill. Output is linear, clamped to [0, 1].
+    glm::vec3 aces_fitted(glm::vec3 color);
+
+    // Jim Hejl & Richard Burgess-Dawson fit, pow(1/2.2) included ("Filmic_1" in the shader).
+    float filmic_uc2(float linear_hdr);
+    glm::vec3 filmic_uc2(glm::vec3 linear_hdr);
+
+    glm::vec3 linear_to_gamma(glm::vec3 linear_color, float gamma);
+}
+
+#endif // _TONEMAP_OPERATORS_2026_10_17_H_